@@ -0,0 +1,497 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osg/BVHGroup>
+#include <osg/Transform>
+#include <osg/Drawable>
+#include <osg/CullStack>
+
+#include <algorithm>
+
+using namespace osg;
+
+namespace
+{
+    // proportional to the surface area of the box, used as the cost of a branch of the tree.
+    inline float boxArea(const BoundingBox& bb)
+    {
+        float dx = bb.xMax()-bb.xMin();
+        float dy = bb.yMax()-bb.yMin();
+        float dz = bb.zMax()-bb.zMin();
+        return dx*dy + dy*dz + dz*dx;
+    }
+
+    inline BoundingBox boxUnion(const BoundingBox& lhs, const BoundingBox& rhs)
+    {
+        BoundingBox bb(lhs);
+        bb.expandBy(rhs);
+        return bb;
+    }
+
+    struct CullTest
+    {
+        CullTest(CullStack& cullStack): _cullStack(cullStack) {}
+
+        inline bool operator() (const BoundingBox& bb) { return !_cullStack.isCulled(bb); }
+
+        CullStack& _cullStack;
+    };
+}
+
+BVHGroup::BVHGroup():
+    _margin(0.1f),
+    _root(-1),
+    _freeList(-1)
+{
+}
+
+BVHGroup::BVHGroup(const BVHGroup& group,const CopyOp& copyop):
+    Group(group,copyop),
+    _margin(group._margin),
+    _root(-1),
+    _freeList(-1)
+{
+    // the children were added by Group's copy constructor, before childInserted() dispatched to this class.
+    for(unsigned int i=0; i<_children.size(); ++i)
+    {
+        childInserted(i);
+    }
+}
+
+BVHGroup::~BVHGroup()
+{
+}
+
+void BVHGroup::traverse(NodeVisitor& nv)
+{
+    // children with culling disabled must be visited whatever the boxes of the tree, so only cull using the tree when there are none.
+    if (nv.getVisitorType()==NodeVisitor::CULL_VISITOR && getNumChildrenWithCullingDisabled()==0)
+    {
+        CullStack* cullStack = nv.asCullStack();
+        if (cullStack)
+        {
+            CullTest test(*cullStack);
+            traverse(nv, test);
+            return;
+        }
+    }
+
+    Group::traverse(nv);
+}
+
+bool BVHGroup::setChild( unsigned int i, Node* node )
+{
+    if (i<_children.size() && node)
+    {
+        childRemoved(i, 1);
+        Group::setChild(i, node);
+        childInserted(i);
+        return true;
+    }
+    else return false;
+}
+
+void BVHGroup::childInserted(unsigned int pos)
+{
+    Node* child = _children[pos].get();
+
+    // new children are kept outside the tree until the next computeBound() finds their box.
+    _childLeaves.insert(ChildLeafMap::value_type(child, -1));
+    _unboundedChildren.push_back(child);
+    _pendingChildren.push_back(child);
+}
+
+void BVHGroup::childRemoved(unsigned int pos, unsigned int numChildrenToRemove)
+{
+    for(unsigned int i=pos; i<pos+numChildrenToRemove && i<_children.size(); ++i)
+    {
+        const Node* child = _children[i].get();
+
+        ChildLeafMap::iterator itr = _childLeaves.find(child);
+        if (itr==_childLeaves.end()) continue;
+
+        int leaf = itr->second;
+        if (leaf>=0)
+        {
+            removeLeaf(leaf);
+            freeTreeNode(leaf);
+        }
+        else
+        {
+            std::vector<Node*>::iterator uitr = std::find(_unboundedChildren.begin(), _unboundedChildren.end(), child);
+            if (uitr!=_unboundedChildren.end()) _unboundedChildren.erase(uitr);
+        }
+
+        _childLeaves.erase(itr);
+
+        // a child may appear more than once in the group, so is only forgotten once its last occurrence is removed.
+        if (_childLeaves.find(child)==_childLeaves.end())
+        {
+            _pendingChildren.erase(std::remove(_pendingChildren.begin(), _pendingChildren.end(), child), _pendingChildren.end());
+        }
+    }
+}
+
+void BVHGroup::dirtyChildBound(const Node* child)
+{
+    _pendingChildren.push_back(child);
+
+    Group::dirtyChildBound(child);
+}
+
+BoundingSphere BVHGroup::computeBound() const
+{
+    updateTree();
+
+    BoundingSphere bsphere;
+    if (_root<0) return bsphere;
+
+    // the root box includes the margins of the children's boxes, so the bound is a little looser than Group's.
+    const BoundingBox& bb = _treeNodes[_root].box;
+    bsphere._center = bb.center();
+    bsphere._radius = bb.radius();
+    return bsphere;
+}
+
+bool BVHGroup::computeChildBox(const Node* child, BoundingBox& box) const
+{
+    // bring the child's bound up to date so that any later change to it is passed on to dirtyChildBound().
+    const BoundingSphere& bs = child->getBound();
+
+    const Transform* transform = child->asTransform();
+    if (transform && transform->getReferenceFrame()!=Transform::RELATIVE_RF) return false;
+
+    box.init();
+
+    const Drawable* drawable = child->asDrawable();
+    if (drawable) box.expandBy(drawable->getBoundingBox());
+    else box.expandBy(bs);
+
+    return box.valid();
+}
+
+void BVHGroup::updateTree() const
+{
+    if (_pendingChildren.empty()) return;
+
+    std::sort(_pendingChildren.begin(), _pendingChildren.end());
+    _pendingChildren.erase(std::unique(_pendingChildren.begin(), _pendingChildren.end()), _pendingChildren.end());
+
+    for(std::vector<const Node*>::const_iterator pitr = _pendingChildren.begin();
+        pitr != _pendingChildren.end();
+        ++pitr)
+    {
+        const Node* child = *pitr;
+
+        std::pair<ChildLeafMap::iterator, ChildLeafMap::iterator> range = _childLeaves.equal_range(child);
+        if (range.first==range.second) continue;
+
+        BoundingBox box;
+        bool bounded = computeChildBox(child, box);
+
+        BoundingBox fatBox;
+        if (bounded)
+        {
+            float margin = _margin*box.radius();
+            fatBox.set(box._min-Vec3(margin,margin,margin), box._max+Vec3(margin,margin,margin));
+        }
+
+        for(ChildLeafMap::iterator itr = range.first; itr != range.second; ++itr)
+        {
+            int& leaf = itr->second;
+            if (leaf>=0)
+            {
+                if (!bounded)
+                {
+                    _unboundedChildren.push_back(_treeNodes[leaf].child);
+                    removeLeaf(leaf);
+                    freeTreeNode(leaf);
+                    leaf = -1;
+                }
+                else
+                {
+                    // children moving within their enlarged box leave the tree untouched.
+                    const BoundingBox& leafBox = _treeNodes[leaf].box;
+                    if (!leafBox.contains(box._min) || !leafBox.contains(box._max))
+                    {
+                        removeLeaf(leaf);
+                        _treeNodes[leaf].box = fatBox;
+                        insertLeaf(leaf);
+                    }
+                }
+            }
+            else if (bounded)
+            {
+                std::vector<Node*>::iterator uitr = std::find(_unboundedChildren.begin(), _unboundedChildren.end(), child);
+                if (uitr!=_unboundedChildren.end()) _unboundedChildren.erase(uitr);
+
+                leaf = allocateTreeNode();
+                _treeNodes[leaf].child = const_cast<Node*>(child);
+                _treeNodes[leaf].box = fatBox;
+                insertLeaf(leaf);
+            }
+        }
+    }
+
+    _pendingChildren.clear();
+}
+
+int BVHGroup::allocateTreeNode() const
+{
+    if (_freeList<0)
+    {
+        _treeNodes.push_back(TreeNode());
+        return static_cast<int>(_treeNodes.size())-1;
+    }
+
+    // free nodes are chained through their parent index.
+    int index = _freeList;
+    _freeList = _treeNodes[index].parent;
+    _treeNodes[index] = TreeNode();
+    return index;
+}
+
+void BVHGroup::freeTreeNode(int index) const
+{
+    TreeNode& node = _treeNodes[index];
+    node = TreeNode();
+    node.parent = _freeList;
+    node.height = -1;
+    _freeList = index;
+}
+
+void BVHGroup::insertLeaf(int leaf) const
+{
+    if (_root<0)
+    {
+        _root = leaf;
+        _treeNodes[leaf].parent = -1;
+        return;
+    }
+
+    // descend to the sibling whose pairing with the leaf adds the least surface area to the tree.
+    BoundingBox leafBox = _treeNodes[leaf].box;
+    int index = _root;
+    while(!_treeNodes[index].isLeaf())
+    {
+        const TreeNode& node = _treeNodes[index];
+
+        float area = boxArea(node.box);
+        float combinedArea = boxArea(boxUnion(node.box, leafBox));
+
+        // cost of pairing the leaf with this node, and the minimum cost added to the branches by pushing it further down.
+        float cost = 2.0f*combinedArea;
+        float inheritanceCost = 2.0f*(combinedArea-area);
+
+        const TreeNode& left = _treeNodes[node.left];
+        float costLeft = boxArea(boxUnion(left.box, leafBox)) + inheritanceCost;
+        if (!left.isLeaf()) costLeft -= boxArea(left.box);
+
+        const TreeNode& right = _treeNodes[node.right];
+        float costRight = boxArea(boxUnion(right.box, leafBox)) + inheritanceCost;
+        if (!right.isLeaf()) costRight -= boxArea(right.box);
+
+        if (cost<costLeft && cost<costRight) break;
+
+        index = costLeft<costRight ? node.left : node.right;
+    }
+
+    int sibling = index;
+
+    // note, allocating may reallocate the node list so no references to it are held across the call.
+    int newParent = allocateTreeNode();
+    int oldParent = _treeNodes[sibling].parent;
+
+    TreeNode& parentNode = _treeNodes[newParent];
+    parentNode.parent = oldParent;
+    parentNode.box = boxUnion(leafBox, _treeNodes[sibling].box);
+    parentNode.height = _treeNodes[sibling].height+1;
+    parentNode.left = sibling;
+    parentNode.right = leaf;
+
+    if (oldParent>=0)
+    {
+        if (_treeNodes[oldParent].left==sibling) _treeNodes[oldParent].left = newParent;
+        else _treeNodes[oldParent].right = newParent;
+    }
+    else
+    {
+        _root = newParent;
+    }
+
+    _treeNodes[sibling].parent = newParent;
+    _treeNodes[leaf].parent = newParent;
+
+    // walk back up the tree refitting and rebalancing the ancestors.
+    index = _treeNodes[leaf].parent;
+    while(index>=0)
+    {
+        index = balance(index);
+        refit(index);
+        index = _treeNodes[index].parent;
+    }
+}
+
+void BVHGroup::removeLeaf(int leaf) const
+{
+    if (leaf==_root)
+    {
+        _root = -1;
+        return;
+    }
+
+    int parent = _treeNodes[leaf].parent;
+    int grandParent = _treeNodes[parent].parent;
+    int sibling = _treeNodes[parent].left==leaf ? _treeNodes[parent].right : _treeNodes[parent].left;
+
+    _treeNodes[leaf].parent = -1;
+
+    if (grandParent>=0)
+    {
+        // replace the parent with the sibling.
+        if (_treeNodes[grandParent].left==parent) _treeNodes[grandParent].left = sibling;
+        else _treeNodes[grandParent].right = sibling;
+        _treeNodes[sibling].parent = grandParent;
+        freeTreeNode(parent);
+
+        int index = grandParent;
+        while(index>=0)
+        {
+            index = balance(index);
+            refit(index);
+            index = _treeNodes[index].parent;
+        }
+    }
+    else
+    {
+        _root = sibling;
+        _treeNodes[sibling].parent = -1;
+        freeTreeNode(parent);
+    }
+}
+
+int BVHGroup::balance(int iA) const
+{
+    TreeNode& A = _treeNodes[iA];
+    if (A.isLeaf() || A.height<2) return iA;
+
+    int iB = A.left;
+    int iC = A.right;
+    TreeNode& B = _treeNodes[iB];
+    TreeNode& C = _treeNodes[iC];
+
+    int difference = C.height-B.height;
+
+    if (difference>1)
+    {
+        // rotate C up.
+        int iF = C.left;
+        int iG = C.right;
+        TreeNode& F = _treeNodes[iF];
+        TreeNode& G = _treeNodes[iG];
+
+        C.left = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        if (C.parent>=0)
+        {
+            if (_treeNodes[C.parent].left==iA) _treeNodes[C.parent].left = iC;
+            else _treeNodes[C.parent].right = iC;
+        }
+        else
+        {
+            _root = iC;
+        }
+
+        if (F.height>G.height)
+        {
+            C.right = iF;
+            A.right = iG;
+            G.parent = iA;
+            A.box = boxUnion(B.box, G.box);
+            C.box = boxUnion(A.box, F.box);
+            A.height = 1+osg::maximum(B.height, G.height);
+            C.height = 1+osg::maximum(A.height, F.height);
+        }
+        else
+        {
+            C.right = iG;
+            A.right = iF;
+            F.parent = iA;
+            A.box = boxUnion(B.box, F.box);
+            C.box = boxUnion(A.box, G.box);
+            A.height = 1+osg::maximum(B.height, F.height);
+            C.height = 1+osg::maximum(A.height, G.height);
+        }
+
+        return iC;
+    }
+
+    if (difference<-1)
+    {
+        // rotate B up.
+        int iD = B.left;
+        int iE = B.right;
+        TreeNode& D = _treeNodes[iD];
+        TreeNode& E = _treeNodes[iE];
+
+        B.left = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        if (B.parent>=0)
+        {
+            if (_treeNodes[B.parent].left==iA) _treeNodes[B.parent].left = iB;
+            else _treeNodes[B.parent].right = iB;
+        }
+        else
+        {
+            _root = iB;
+        }
+
+        if (D.height>E.height)
+        {
+            B.right = iD;
+            A.left = iE;
+            E.parent = iA;
+            A.box = boxUnion(C.box, E.box);
+            B.box = boxUnion(A.box, D.box);
+            A.height = 1+osg::maximum(C.height, E.height);
+            B.height = 1+osg::maximum(A.height, D.height);
+        }
+        else
+        {
+            B.right = iE;
+            A.left = iD;
+            D.parent = iA;
+            A.box = boxUnion(C.box, D.box);
+            B.box = boxUnion(A.box, E.box);
+            A.height = 1+osg::maximum(C.height, D.height);
+            B.height = 1+osg::maximum(A.height, E.height);
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
+
+void BVHGroup::refit(int index) const
+{
+    TreeNode& node = _treeNodes[index];
+    const TreeNode& left = _treeNodes[node.left];
+    const TreeNode& right = _treeNodes[node.right];
+    node.height = 1+osg::maximum(left.height, right.height);
+    node.box = boxUnion(left.box, right.box);
+}
@@ -55,6 +55,7 @@ CullStack::~CullStack()
 
 void CullStack::reset()
 {
+    clearFrustumCullHint();
 
     //
     // first unref all referenced objects and then empty the containers.
@@ -104,6 +104,8 @@ void DisplaySettings::setDisplaySettings(const DisplaySettings& vs)
 
     _numDatabaseThreadsHint = vs._numDatabaseThreadsHint;
     _numHttpDatabaseThreadsHint = vs._numHttpDatabaseThreadsHint;
+    _numArchiveDatabaseThreadsHint = vs._numArchiveDatabaseThreadsHint;
+    _numCullThreadsHint = vs._numCullThreadsHint;
 
     _application = vs._application;
 
@@ -151,6 +153,8 @@ void DisplaySettings::merge(const DisplaySettings& vs)
 
     if (vs._numDatabaseThreadsHint>_numDatabaseThreadsHint) _numDatabaseThreadsHint = vs._numDatabaseThreadsHint;
     if (vs._numHttpDatabaseThreadsHint>_numHttpDatabaseThreadsHint) _numHttpDatabaseThreadsHint = vs._numHttpDatabaseThreadsHint;
+    if (vs._numArchiveDatabaseThreadsHint>_numArchiveDatabaseThreadsHint) _numArchiveDatabaseThreadsHint = vs._numArchiveDatabaseThreadsHint;
+    if (vs._numCullThreadsHint>_numCullThreadsHint) _numCullThreadsHint = vs._numCullThreadsHint;
 
     if (_application.empty()) _application = vs._application;
 
@@ -234,6 +238,8 @@ void DisplaySettings::setDefaults()
 
     _numDatabaseThreadsHint = 2;
     _numHttpDatabaseThreadsHint = 1;
+    _numArchiveDatabaseThreadsHint = 0;
+    _numCullThreadsHint = 0;
 
     _maxTexturePoolSize = 0;
     _maxBufferObjectPoolSize = 0;
@@ -342,10 +348,16 @@ static ApplicationUsageProxy DisplaySetting_e15(ApplicationUsage::ENVIRONMENTAL_
         "OFF | ON Disable/enable the hint to use osgUtil::SceneView to implement stereo when required..");
 static ApplicationUsageProxy DisplaySetting_e16(ApplicationUsage::ENVIRONMENTAL_VARIABLE,
         "OSG_NUM_DATABASE_THREADS <int>",
-        "Set the hint for the total number of threads to set up in the DatabasePager.");
+        "Set the hint for the total number of threads to set up in the DatabasePager, 0 to scale with the number of processors.");
 static ApplicationUsageProxy DisplaySetting_e17(ApplicationUsage::ENVIRONMENTAL_VARIABLE,
         "OSG_NUM_HTTP_DATABASE_THREADS <int>",
         "Set the hint for the total number of threads dedicated to http requests to set up in the DatabasePager.");
+static ApplicationUsageProxy DisplaySetting_e17a(ApplicationUsage::ENVIRONMENTAL_VARIABLE,
+        "OSG_NUM_ARCHIVE_DATABASE_THREADS <int>",
+        "Set the hint for the number of threads dedicated to reading from archives to set up in the DatabasePager.");
+static ApplicationUsageProxy DisplaySetting_e17b(ApplicationUsage::ENVIRONMENTAL_VARIABLE,
+        "OSG_NUM_CULL_THREADS <int>",
+        "Set the hint for the number of threads used to cull the subgraph of a single camera, 0 or 1 for a serial cull.");
 static ApplicationUsageProxy DisplaySetting_e18(ApplicationUsage::ENVIRONMENTAL_VARIABLE,
         "OSG_MULTI_SAMPLES <int>",
         "Set the hint for the number of samples to use when multi-sampling.");
@@ -577,6 +589,10 @@ void DisplaySettings::readEnvironmentalVariables()
 
     getEnvVar("OSG_NUM_HTTP_DATABASE_THREADS", _numHttpDatabaseThreadsHint);
 
+    getEnvVar("OSG_NUM_ARCHIVE_DATABASE_THREADS", _numArchiveDatabaseThreadsHint);
+
+    getEnvVar("OSG_NUM_CULL_THREADS", _numCullThreadsHint);
+
     getEnvVar("OSG_MULTI_SAMPLES", _numMultiSamples);
 
     getEnvVar("OSG_TEXTURE_POOL_SIZE", _maxTexturePoolSize);
@@ -858,6 +874,7 @@ void DisplaySettings::readCommandLine(ArgumentParser& arguments)
         arguments.getApplicationUsage()->addCommandLineOption("--keystone-off","Set the keystone hint to false.");
         arguments.getApplicationUsage()->addCommandLineOption("--menubar-behavior <behavior>","Set the menubar behavior (AUTO_HIDE | FORCE_HIDE | FORCE_SHOW)");
         arguments.getApplicationUsage()->addCommandLineOption("--sync","Enable sync of swap buffers");
+        arguments.getApplicationUsage()->addCommandLineOption("--num-cull-threads <num>","Set the hint for the number of threads used to cull a single camera's subgraph.");
     }
 
     std::string str;
@@ -953,6 +970,8 @@ void DisplaySettings::readCommandLine(ArgumentParser& arguments)
 
     while(arguments.read("--num-db-threads",_numDatabaseThreadsHint)) {}
     while(arguments.read("--num-http-threads",_numHttpDatabaseThreadsHint)) {}
+    while(arguments.read("--num-archive-threads",_numArchiveDatabaseThreadsHint)) {}
+    while(arguments.read("--num-cull-threads",_numCullThreadsHint)) {}
 
     while(arguments.read("--texture-pool-size",_maxTexturePoolSize)) {}
     while(arguments.read("--buffer-object-pool-size",_maxBufferObjectPoolSize)) {}
@@ -1080,6 +1080,16 @@ void Geometry::accept(ConstAttributeFunctor& af) const
     }
 }
 
+static Vec3Array* convertToVec3Array(const Vec3sArray& shorts)
+{
+    Vec3Array* floats = new Vec3Array(shorts.size());
+    for(unsigned int i=0; i<shorts.size(); ++i)
+    {
+        (*floats)[i].set(shorts[i].x(), shorts[i].y(), shorts[i].z());
+    }
+    return floats;
+}
+
 void Geometry::accept(PrimitiveFunctor& functor) const
 {
     const osg::Array* vertices = _vertexArray.get();
@@ -1098,6 +1108,9 @@ void Geometry::accept(PrimitiveFunctor& functor) const
         return;
     }
 
+    // quantized short vertices are passed on to the functor as floats.
+    ref_ptr<Vec3Array> shortVertices;
+
     switch(vertices->getType())
     {
     case(Array::Vec2ArrayType):
@@ -1118,6 +1131,10 @@ void Geometry::accept(PrimitiveFunctor& functor) const
     case(Array::Vec4dArrayType):
         functor.setVertexArray(vertices->getNumElements(),static_cast<const Vec4d*>(vertices->getDataPointer()));
         break;
+    case(Array::Vec3sArrayType):
+        shortVertices = convertToVec3Array(*static_cast<const Vec3sArray*>(vertices));
+        functor.setVertexArray(shortVertices->getNumElements(),static_cast<const Vec3*>(shortVertices->getDataPointer()));
+        break;
     default:
         OSG_WARN<<"Warning: Geometry::accept(PrimitiveFunctor&) cannot handle Vertex Array type"<<vertices->getType()<<std::endl;
         return;
@@ -1149,6 +1166,9 @@ void Geometry::accept(PrimitiveIndexFunctor& functor) const
         return;
     }
 
+    // quantized short vertices are passed on to the functor as floats.
+    ref_ptr<Vec3Array> shortVertices;
+
     switch(vertices->getType())
     {
     case(Array::Vec2ArrayType):
@@ -1169,6 +1189,10 @@ void Geometry::accept(PrimitiveIndexFunctor& functor) const
     case(Array::Vec4dArrayType):
         functor.setVertexArray(vertices->getNumElements(),static_cast<const Vec4d*>(vertices->getDataPointer()));
         break;
+    case(Array::Vec3sArrayType):
+        shortVertices = convertToVec3Array(*static_cast<const Vec3sArray*>(vertices));
+        functor.setVertexArray(shortVertices->getNumElements(),static_cast<const Vec3*>(shortVertices->getDataPointer()));
+        break;
     default:
         OSG_WARN<<"Warning: Geometry::accept(PrimitiveIndexFunctor&) cannot handle Vertex Array type"<<vertices->getType()<<std::endl;
         return;
@@ -101,6 +101,21 @@ bool Group::insertChild( unsigned int index, Node *child )
     // register as parent of child.
     child->addParent(this);
 
+    // children appended to a group using bound blocks only dirty the last block, any other insertion shifts the blocks.
+    if (!_boundBlocks.empty() && index+1==_children.size())
+    {
+        unsigned int numBlocks = (static_cast<unsigned int>(_children.size())+BOUND_BLOCK_SIZE-1)/BOUND_BLOCK_SIZE;
+        if (_boundBlocks.size()<numBlocks) _boundBlocks.push_back(BoundBlock());
+        else _boundBlocks.back().dirty = true;
+
+        ChildIndexList::value_type entry(child, index);
+        _boundBlockChildIndices.insert(std::lower_bound(_boundBlockChildIndices.begin(), _boundBlockChildIndices.end(), entry), entry);
+    }
+    else
+    {
+        dirtyBoundBlocks();
+    }
+
     // tell any subclasses that a child has been inserted so that they can update themselves.
     childInserted(index);
 
@@ -198,6 +213,8 @@ bool Group::removeChildren(unsigned int pos,unsigned int numChildrenToRemove)
 
         _children.erase(_children.begin()+pos,_children.begin()+endOfRemoveRange);
 
+        dirtyBoundBlocks();
+
         if (updateCallbackRemoved)
         {
             setNumChildrenRequiringUpdateTraversal(getNumChildrenRequiringUpdateTraversal()-updateCallbackRemoved);
@@ -256,6 +273,8 @@ bool Group::setChild( unsigned  int i, Node* newNode )
         // register as parent of child.
         newNode->addParent(this);
 
+        dirtyBoundBlocks();
+
         dirtyBound();
 
 
@@ -357,6 +376,11 @@ BoundingSphere Group::computeBound() const
         return bsphere;
     }
 
+    if (useBoundBlocks())
+    {
+        return computeBoundFromBlocks();
+    }
+
     // note, special handling of the case when a child is an Transform,
     // such that only Transforms which are relative to their parents coordinates frame (i.e this group)
     // are handled, Transform relative to and absolute reference frame are ignored.
@@ -408,6 +432,119 @@ BoundingSphere Group::computeBound() const
     return bsphere;
 }
 
+BoundingSphere Group::computeBoundFromBlocks() const
+{
+    unsigned int numChildren = static_cast<unsigned int>(_children.size());
+    unsigned int numBlocks = (numChildren+BOUND_BLOCK_SIZE-1)/BOUND_BLOCK_SIZE;
+    if (_boundBlocks.size()!=numBlocks)
+    {
+        _boundBlocks.clear();
+        _boundBlocks.resize(numBlocks);
+
+        _boundBlockChildIndices.clear();
+        _boundBlockChildIndices.reserve(numChildren);
+        for(unsigned int i=0; i<numChildren; ++i)
+        {
+            _boundBlockChildIndices.push_back(ChildIndexList::value_type(_children[i].get(), i));
+        }
+        std::sort(_boundBlockChildIndices.begin(), _boundBlockChildIndices.end());
+    }
+
+    BoundingBox bb;
+    for(unsigned int i=0; i<numBlocks; ++i)
+    {
+        BoundBlock& block = _boundBlocks[i];
+        if (block.dirty)
+        {
+            computeBoundBlock(block, i*BOUND_BLOCK_SIZE, osg::minimum(numChildren, (i+1)*BOUND_BLOCK_SIZE));
+            block.dirty = false;
+        }
+        bb.expandBy(block.box);
+    }
+
+    BoundingSphere bsphere;
+    if (!bb.valid())
+    {
+        return bsphere;
+    }
+
+    bsphere._center = bb.center();
+    bsphere._radius = 0.0f;
+    for(BoundBlockList::const_iterator itr = _boundBlocks.begin();
+        itr != _boundBlocks.end();
+        ++itr)
+    {
+        if (itr->sphere.valid()) bsphere.expandRadiusBy(itr->sphere);
+    }
+
+    return bsphere;
+}
+
+void Group::computeBoundBlock(BoundBlock& block, unsigned int begin, unsigned int end) const
+{
+    block.box.init();
+    block.sphere.init();
+
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        osg::Node* child = _children[i].get();
+
+        // bring the bounds of all the children up to date, including those not contributing to the block, so that
+        // any later change to them is passed on to dirtyChildBound().
+        child->getBound();
+
+        const osg::Transform* transform = child->asTransform();
+        if (!transform || transform->getReferenceFrame()==osg::Transform::RELATIVE_RF)
+        {
+            osg::Drawable* drawable = child->asDrawable();
+            if (drawable)
+            {
+                block.box.expandBy(drawable->getBoundingBox());
+            }
+            else
+            {
+                block.box.expandBy(child->getBound());
+            }
+        }
+    }
+
+    if (!block.box.valid()) return;
+
+    block.sphere._center = block.box.center();
+    block.sphere._radius = 0.0f;
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        osg::Node* child = _children[i].get();
+        const osg::Transform* transform = child->asTransform();
+        if (!transform || transform->getReferenceFrame()==osg::Transform::RELATIVE_RF)
+        {
+            block.sphere.expandRadiusBy(child->getBound());
+        }
+    }
+}
+
+void Group::dirtyChildBound(const Node* child)
+{
+    if (!_boundBlocks.empty())
+    {
+        ChildIndexList::iterator itr = std::lower_bound(_boundBlockChildIndices.begin(), _boundBlockChildIndices.end(), ChildIndexList::value_type(child, 0));
+        if (itr!=_boundBlockChildIndices.end() && itr->first==child)
+        {
+            // a child may appear more than once in the group.
+            for(; itr!=_boundBlockChildIndices.end() && itr->first==child; ++itr)
+            {
+                _boundBlocks[itr->second/BOUND_BLOCK_SIZE].dirty = true;
+            }
+        }
+        else
+        {
+            dirtyBoundBlocks();
+        }
+    }
+
+    dirtyBound();
+}
+
 void Group::setThreadSafeRefUnref(bool threadSafe)
 {
     Node::setThreadSafeRefUnref(threadSafe);
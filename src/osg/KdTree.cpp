@@ -19,6 +19,12 @@
 
 #include <osg/io_utils>
 
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+
+#include <algorithm>
+#include <float.h>
+
 using namespace osg;
 
 //#define VERBOSE_OUTPUT
@@ -31,16 +37,23 @@ using namespace osg;
 struct BuildKdTree
 {
     BuildKdTree(KdTree& kdTree):
-        _kdTree(kdTree) {}
+        _kdTree(kdTree),
+        _collectPrimitiveBounds(false) {}
 
     typedef std::vector< osg::Vec3 >            CenterList;
+    typedef std::vector< osg::BoundingBox >     BoundsList;
     typedef std::vector< unsigned int >           Indices;
     typedef std::vector< unsigned int >         AxisStack;
 
+    // number of buckets the centres of a node's primitives are sorted into along each axis when looking for the cheapest split.
+    enum { NUM_SAH_BINS = 16 };
+
     bool build(KdTree::BuildOptions& options, osg::Geometry* geometry);
 
     void computeDivisions(KdTree::BuildOptions& options);
 
+    bool computeSAHSplit(int istart, int iend, int& splitAxis, float& splitValue);
+
     int divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int nodeIndex, unsigned int level);
 
     KdTree&             _kdTree;
@@ -50,6 +63,10 @@ struct BuildKdTree
     Indices             _primitiveIndices;
     CenterList          _centers;
 
+    // bounds of the primitives, only collected when needed by the surface area heuristic.
+    bool                _collectPrimitiveBounds;
+    BoundsList          _primitiveBounds;
+
 protected:
 
     BuildKdTree& operator = (const BuildKdTree&) { return *this; }
@@ -74,6 +91,7 @@ struct PrimitiveIndicesCollector
 
         _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
         _buildKdTree->_centers.push_back(bb.center());
+        if (_buildKdTree->_collectPrimitiveBounds) _buildKdTree->_primitiveBounds.push_back(bb);
     }
 
     inline void operator () (unsigned int p0, unsigned int p1)
@@ -98,6 +116,7 @@ struct PrimitiveIndicesCollector
 
         _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
         _buildKdTree->_centers.push_back(bb.center());
+        if (_buildKdTree->_collectPrimitiveBounds) _buildKdTree->_primitiveBounds.push_back(bb);
     }
 
     inline void operator () (unsigned int p0, unsigned int p1, unsigned int p2)
@@ -125,6 +144,7 @@ struct PrimitiveIndicesCollector
 
         _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
         _buildKdTree->_centers.push_back(bb.center());
+        if (_buildKdTree->_collectPrimitiveBounds) _buildKdTree->_primitiveBounds.push_back(bb);
     }
 
     inline void operator () (unsigned int p0, unsigned int p1, unsigned int p2, unsigned int p3)
@@ -154,6 +174,7 @@ struct PrimitiveIndicesCollector
 
         _buildKdTree->_primitiveIndices.push_back(_buildKdTree->_centers.size());
         _buildKdTree->_centers.push_back(bb.center());
+        if (_buildKdTree->_collectPrimitiveBounds) _buildKdTree->_primitiveBounds.push_back(bb);
     }
 
     BuildKdTree* _buildKdTree;
@@ -196,6 +217,9 @@ bool BuildKdTree::build(KdTree::BuildOptions& options, osg::Geometry* geometry)
     _primitiveIndices.reserve(estimatedNumTriangles);
     _centers.reserve(estimatedNumTriangles);
 
+    _collectPrimitiveBounds = (options._splitMethod==KdTree::BuildOptions::SAH_SPLIT);
+    if (_collectPrimitiveBounds) _primitiveBounds.reserve(estimatedNumTriangles);
+
     osg::TemplatePrimitiveIndexFunctor<PrimitiveIndicesCollector> collectIndices;
     collectIndices._buildKdTree = this;
     geometry->accept(collectIndices);
@@ -271,6 +295,91 @@ void BuildKdTree::computeDivisions(KdTree::BuildOptions& options)
 #endif
 }
 
+static inline float surfaceArea(const osg::BoundingBox& bb)
+{
+    if (!bb.valid()) return 0.0f;
+
+    float dx = bb.xMax()-bb.xMin();
+    float dy = bb.yMax()-bb.yMin();
+    float dz = bb.zMax()-bb.zMin();
+    return dx*dy + dy*dz + dz*dx;
+}
+
+bool BuildKdTree::computeSAHSplit(int istart, int iend, int& splitAxis, float& splitValue)
+{
+    // the primitives are partitioned on their centres, so the candidate splits are spread across the bounds of the centres.
+    osg::BoundingBox centerBounds;
+    for(int i=istart; i<=iend; ++i)
+    {
+        centerBounds.expandBy(_centers[_primitiveIndices[i]]);
+    }
+
+    struct Bin
+    {
+        Bin(): count(0) {}
+
+        unsigned int        count;
+        osg::BoundingBox    bb;
+    };
+
+    float bestCost = FLT_MAX;
+    bool found = false;
+
+    for(int axis=0; axis<3; ++axis)
+    {
+        float minCenter = centerBounds._min[axis];
+        float extent = centerBounds._max[axis]-minCenter;
+        if (extent<=0.0f) continue;
+
+        Bin bins[NUM_SAH_BINS];
+        float scale = float(NUM_SAH_BINS)/extent;
+        for(int i=istart; i<=iend; ++i)
+        {
+            unsigned int primitive = _primitiveIndices[i];
+            int b = static_cast<int>((_centers[primitive][axis]-minCenter)*scale);
+            if (b>=NUM_SAH_BINS) b = NUM_SAH_BINS-1;
+            else if (b<0) b = 0;
+
+            ++bins[b].count;
+            bins[b].bb.expandBy(_primitiveBounds[primitive]);
+        }
+
+        // sweep from the right accumulating the cost of the primitives to the right of each split.
+        float rightCost[NUM_SAH_BINS];
+        unsigned int rightCount[NUM_SAH_BINS];
+        osg::BoundingBox bb;
+        unsigned int count = 0;
+        for(int b=NUM_SAH_BINS-1; b>0; --b)
+        {
+            bb.expandBy(bins[b].bb);
+            count += bins[b].count;
+            rightCost[b] = surfaceArea(bb)*float(count);
+            rightCount[b] = count;
+        }
+
+        // then from the left, the parent's area being common to all the splits so left out of the cost.
+        bb.init();
+        count = 0;
+        for(int b=0; b<NUM_SAH_BINS-1; ++b)
+        {
+            bb.expandBy(bins[b].bb);
+            count += bins[b].count;
+            if (count==0 || rightCount[b+1]==0) continue;
+
+            float cost = surfaceArea(bb)*float(count) + rightCost[b+1];
+            if (cost<bestCost)
+            {
+                bestCost = cost;
+                splitAxis = axis;
+                splitValue = minCenter + float(b+1)/scale;
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
 int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int nodeIndex, unsigned int level)
 {
     KdTree::KdNode& node = _kdTree.getNode(nodeIndex);
@@ -345,10 +454,13 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 
         //OSG_NOTICE<<"  divide leaf"<<std::endl;
 
-        float original_min = bb._min[axis];
-        float original_max = bb._max[axis];
-
-        float mid = (original_min+original_max)*0.5f;
+        float mid = 0.0f;
+        if (options._splitMethod!=KdTree::BuildOptions::SAH_SPLIT || !computeSAHSplit(istart, iend, axis, mid))
+        {
+            // when the centres all coincide the midpoint split is left to divide the node in situ until the level limit is reached.
+            axis = _axisStack[level];
+            mid = (bb._min[axis]+bb._max[axis])*0.5f;
+        }
 
         int originalLeftChildIndex = 0;
         int originalRightChildIndex = 0;
@@ -476,7 +588,8 @@ int BuildKdTree::divide(KdTree::BuildOptions& options, osg::BoundingBox& bb, int
 KdTree::BuildOptions::BuildOptions():
         _numVerticesProcessed(0),
         _targetNumTrianglesPerLeaf(4),
-        _maxNumLevels(32)
+        _maxNumLevels(32),
+        _splitMethod(MIDPOINT_SPLIT)
 {
 }
 
@@ -508,7 +621,9 @@ bool KdTree::build(BuildOptions& options, osg::Geometry* geometry)
 //
 // KdTreeBuilder
 KdTreeBuilder::KdTreeBuilder():
-    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN)
+    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+    _numThreads(1),
+    _traversalDepth(0)
 {
     _kdTreePrototype = new osg::KdTree;
 }
@@ -517,8 +632,19 @@ KdTreeBuilder::KdTreeBuilder(const KdTreeBuilder& rhs):
     osg::Object(rhs),
     osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
     _buildOptions(rhs._buildOptions),
-    _kdTreePrototype(rhs._kdTreePrototype)
+    _kdTreePrototype(rhs._kdTreePrototype),
+    _numThreads(rhs._numThreads),
+    _traversalDepth(0)
+{
+}
+
+void KdTreeBuilder::apply(osg::Node& node)
 {
+    ++_traversalDepth;
+    traverse(node);
+    --_traversalDepth;
+
+    if (_traversalDepth==0 && !_geometries.empty()) buildKdTrees();
 }
 
 void KdTreeBuilder::apply(osg::Geometry& geometry)
@@ -526,6 +652,14 @@ void KdTreeBuilder::apply(osg::Geometry& geometry)
     osg::KdTree* previous = dynamic_cast<osg::KdTree*>(geometry.getShape());
     if (previous) return;
 
+    if (_numThreads>1 && _traversalDepth>0)
+    {
+        // compute the bounding box now, as the build threads only read it.
+        geometry.getBoundingBox();
+        _geometries.push_back(&geometry);
+        return;
+    }
+
     osg::ref_ptr<osg::KdTree> kdTree = osg::clone(_kdTreePrototype.get());
 
     if (kdTree->build(_buildOptions, &geometry))
@@ -533,3 +667,119 @@ void KdTreeBuilder::apply(osg::Geometry& geometry)
         geometry.setShape(kdTree.get());
     }
 }
+
+namespace
+{
+
+/** KdTrees being built by a group of threads, each thread taking the next unbuilt tree until none are left.*/
+struct KdTreeBatch
+{
+    typedef std::vector< osg::ref_ptr<osg::Geometry> > GeometryList;
+    typedef std::vector< osg::ref_ptr<osg::KdTree> > KdTreeList;
+    typedef std::vector< KdTree::BuildOptions > BuildOptionsList;
+
+    KdTreeBatch(const GeometryList& geometries, const KdTree::BuildOptions& options, unsigned int numThreads):
+        _geometries(geometries),
+        _built(geometries.size(), 0),
+        _options(numThreads, options) {}
+
+    void build(unsigned int threadIndex)
+    {
+        KdTree::BuildOptions& options = _options[threadIndex];
+        for(;;)
+        {
+            unsigned int i = (++_next)-1;
+            if (i>=_geometries.size()) break;
+
+            _built[i] = _kdTrees[i]->build(options, _geometries[i].get()) ? 1 : 0;
+        }
+    }
+
+    const GeometryList&         _geometries;
+    KdTreeList                  _kdTrees;
+    std::vector<unsigned char>  _built;
+
+    // each thread accumulates its own count of vertices processed.
+    BuildOptionsList            _options;
+
+    OpenThreads::Atomic         _next;
+};
+
+class KdTreeBuildThread : public osg::Referenced, public OpenThreads::Thread
+{
+public:
+
+    KdTreeBuildThread(KdTreeBatch& batch, unsigned int threadIndex):
+        _batch(batch),
+        _threadIndex(threadIndex) {}
+
+    virtual void run()
+    {
+        _batch.build(_threadIndex);
+    }
+
+protected:
+
+    KdTreeBatch&    _batch;
+    unsigned int    _threadIndex;
+};
+
+}
+
+void KdTreeBuilder::buildKdTrees()
+{
+    if (_geometries.empty()) return;
+
+    // geometries shared between several parents are only built once.
+    std::sort(_geometries.begin(), _geometries.end());
+    _geometries.erase(std::unique(_geometries.begin(), _geometries.end()), _geometries.end());
+
+    osg::Timer_t startTick = osg::Timer::instance()->tick();
+
+    unsigned int numThreads = osg::maximum(1u, osg::minimum(_numThreads, static_cast<unsigned int>(_geometries.size())));
+
+    KdTreeBatch batch(_geometries, _buildOptions, numThreads);
+    for(unsigned int i=0; i<_geometries.size(); ++i)
+    {
+        batch._kdTrees.push_back(osg::clone(_kdTreePrototype.get()));
+    }
+
+    // the calling thread builds alongside the others.
+    typedef std::vector< osg::ref_ptr<KdTreeBuildThread> > BuildThreads;
+    BuildThreads threads;
+    for(unsigned int i=1; i<numThreads; ++i)
+    {
+        osg::ref_ptr<KdTreeBuildThread> thread = new KdTreeBuildThread(batch, i);
+        thread->startThread();
+        threads.push_back(thread);
+    }
+
+    batch.build(0);
+
+    for(BuildThreads::iterator itr = threads.begin(); itr != threads.end(); ++itr)
+    {
+        (*itr)->join();
+    }
+
+    unsigned int numBuilt = 0;
+    for(unsigned int i=0; i<_geometries.size(); ++i)
+    {
+        if (batch._built[i])
+        {
+            _geometries[i]->setShape(batch._kdTrees[i].get());
+            ++numBuilt;
+        }
+    }
+
+    unsigned int numVerticesProcessed = _buildOptions._numVerticesProcessed;
+    for(unsigned int i=0; i<numThreads; ++i)
+    {
+        numVerticesProcessed += batch._options[i]._numVerticesProcessed - _buildOptions._numVerticesProcessed;
+    }
+    _buildOptions._numVerticesProcessed = numVerticesProcessed;
+
+    OSG_INFO<<"KdTreeBuilder::buildKdTrees() built "<<numBuilt<<" of "<<_geometries.size()<<" KdTrees using "<<numThreads<<" threads in "
+            <<osg::Timer::instance()->delta_m(startTick, osg::Timer::instance()->tick())<<"ms"<<std::endl;
+
+    _geometries.clear();
+}
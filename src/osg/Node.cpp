@@ -19,6 +19,8 @@
 #include <osg/Transform>
 #include <osg/UserDataContainer>
 
+#include <OpenThreads/Atomic>
+
 #include <algorithm>
 
 using namespace osg;
@@ -537,17 +539,35 @@ void Node::dirtyBound()
     {
         _boundingSphereComputed = false;
 
-        // dirty parent bounding sphere's to ensure that all are valid.
+        // dirty parent bounding sphere's to ensure that all are valid, passing on
+        // which child changed so that wide groups only recompute the part of their bound containing it.
         for(ParentList::iterator itr=_parents.begin();
             itr!=_parents.end();
             ++itr)
         {
-            (*itr)->dirtyBound();
+            (*itr)->dirtyChildBound(this);
         }
 
     }
 }
 
+static OpenThreads::Atomic s_numBoundsComputed;
+
+unsigned int Node::getNumBoundsComputed()
+{
+    return s_numBoundsComputed;
+}
+
+unsigned int Node::resetNumBoundsComputed()
+{
+    return s_numBoundsComputed.exchange(0);
+}
+
+void Node::countBoundComputed()
+{
+    ++s_numBoundsComputed;
+}
+
 void Node::setThreadSafeRefUnref(bool threadSafe)
 {
     Object::setThreadSafeRefUnref(threadSafe);
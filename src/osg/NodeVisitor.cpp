@@ -13,6 +13,7 @@
 #include <osg/NodeVisitor>
 
 #include <osg/Billboard>
+#include <osg/BVHGroup>
 #include <osg/ClearNode>
 #include <osg/ClipNode>
 #include <osg/CoordinateSystemNode>
@@ -112,6 +113,11 @@ void NodeVisitor::apply(ProxyNode& node)
     apply(static_cast<Group&>(node));
 }
 
+void NodeVisitor::apply(BVHGroup& node)
+{
+    apply(static_cast<Group&>(node));
+}
+
 void NodeVisitor::apply(Projection& node)
 {
     apply(static_cast<Group&>(node));
@@ -194,7 +194,9 @@ bool StateSet::Callback::run(osg::Object* object, osg::Object* data)
 
 StateSet::StateSet():
     Object(true),
-    _nestRenderBins(true)
+    _nestRenderBins(true),
+    _hash(0),
+    _hashComputed(false)
 {
     _renderingHint = DEFAULT_BIN;
 
@@ -205,7 +207,9 @@ StateSet::StateSet():
 }
 
 StateSet::StateSet(const StateSet& rhs,const CopyOp& copyop):Object(rhs,copyop),
-    _nestRenderBins(rhs._nestRenderBins)
+    _nestRenderBins(rhs._nestRenderBins),
+    _hash(0),
+    _hashComputed(false)
 {
     _modeList = rhs._modeList;
 
@@ -603,6 +607,89 @@ int StateSet::compare(const StateSet& rhs,bool compareAttributeContents) const
     return 0;
 }
 
+static uint64_t hashString(uint64_t seed, const std::string& str)
+{
+    // FNV-1a
+    uint64_t hash = (static_cast<uint64_t>(0xcbf29ce4u)<<32) | 0x84222325u;
+    const uint64_t prime = (static_cast<uint64_t>(0x00000100u)<<32) | 0x000001b3u;
+    for(std::string::const_iterator itr = str.begin(); itr != str.end(); ++itr)
+    {
+        hash ^= static_cast<unsigned char>(*itr);
+        hash *= prime;
+    }
+    return hashCombine(seed, hash);
+}
+
+static uint64_t hashModeList(uint64_t hash, const StateSet::ModeList& modeList)
+{
+    hash = hashCombine(hash, modeList.size());
+    for(StateSet::ModeList::const_iterator itr = modeList.begin(); itr != modeList.end(); ++itr)
+    {
+        hash = hashCombine(hash, itr->first);
+        hash = hashCombine(hash, itr->second);
+    }
+    return hash;
+}
+
+static uint64_t hashAttributeList(uint64_t hash, const StateSet::AttributeList& attributeList)
+{
+    // the attributes themselves are left out so the hash holds for both modes of compare(..).
+    hash = hashCombine(hash, attributeList.size());
+    for(StateSet::AttributeList::const_iterator itr = attributeList.begin(); itr != attributeList.end(); ++itr)
+    {
+        hash = hashCombine(hash, itr->first.first);
+        hash = hashCombine(hash, itr->first.second);
+        hash = hashCombine(hash, itr->second.second);
+    }
+    return hash;
+}
+
+uint64_t StateSet::getHash() const
+{
+    if (_hashComputed) return _hash;
+
+    uint64_t hash = hashCombine(0, _binMode);
+    if (_binMode != INHERIT_RENDERBIN_DETAILS)
+    {
+        hash = hashCombine(hash, static_cast<unsigned int>(_binNum));
+        hash = hashString(hash, _binName);
+    }
+
+    hash = hashModeList(hash, _modeList);
+    hash = hashAttributeList(hash, _attributeList);
+
+    hash = hashCombine(hash, _textureModeList.size());
+    for(TextureModeList::const_iterator itr = _textureModeList.begin(); itr != _textureModeList.end(); ++itr)
+    {
+        hash = hashModeList(hash, *itr);
+    }
+
+    hash = hashCombine(hash, _textureAttributeList.size());
+    for(TextureAttributeList::const_iterator itr = _textureAttributeList.begin(); itr != _textureAttributeList.end(); ++itr)
+    {
+        hash = hashAttributeList(hash, *itr);
+    }
+
+    hash = hashCombine(hash, _uniformList.size());
+    for(UniformList::const_iterator itr = _uniformList.begin(); itr != _uniformList.end(); ++itr)
+    {
+        hash = hashString(hash, itr->first);
+        hash = hashCombine(hash, itr->second.second);
+    }
+
+    hash = hashCombine(hash, _defineList.size());
+    for(DefineList::const_iterator itr = _defineList.begin(); itr != _defineList.end(); ++itr)
+    {
+        hash = hashString(hash, itr->first);
+        hash = hashString(hash, itr->second.first);
+        hash = hashCombine(hash, itr->second.second);
+    }
+
+    _hash = hash;
+    _hashComputed = true;
+    return _hash;
+}
+
 int StateSet::compareModes(const ModeList& lhs,const ModeList& rhs)
 {
     ModeList::const_iterator lhs_mode_itr = lhs.begin();
@@ -800,6 +887,8 @@ void StateSet::setGlobalDefaults()
 
 void StateSet::clear()
 {
+    dirtyHash();
+
     _renderingHint = DEFAULT_BIN;
 
     setRenderBinToInherit();
@@ -846,6 +935,8 @@ void StateSet::clear()
 
 void StateSet::merge(const StateSet& rhs)
 {
+    dirtyHash();
+
     // merge the modes of rhs into this,
     // this overrides rhs if OVERRIDE defined in this.
     for(ModeList::const_iterator rhs_mitr = rhs._modeList.begin();
@@ -1169,6 +1260,8 @@ void StateSet::setAttributeAndModes(StateAttribute *attribute, StateAttribute::G
 
 void StateSet::removeAttribute(StateAttribute::Type type, unsigned int member)
 {
+    dirtyHash();
+
     AttributeList::iterator itr = _attributeList.find(StateAttribute::TypeMemberPair(type,member));
     if (itr!=_attributeList.end())
     {
@@ -1190,6 +1283,8 @@ void StateSet::removeAttribute(StateAttribute::Type type, unsigned int member)
 
 void StateSet::removeAttribute(StateAttribute* attribute)
 {
+    dirtyHash();
+
     if (!attribute) return;
 
     AttributeList::iterator itr = _attributeList.find(attribute->getTypeMemberPair());
@@ -1226,6 +1321,8 @@ const StateAttribute* StateSet::getAttribute(StateAttribute::Type type, unsigned
 
 StateSet::RefAttributePair* StateSet::getAttributePair(StateAttribute::Type type, unsigned int member)
 {
+    dirtyHash();
+
     return getAttributePair(_attributeList,type,member);
 }
 
@@ -1236,6 +1333,8 @@ const StateSet::RefAttributePair* StateSet::getAttributePair(StateAttribute::Typ
 
 void StateSet::addUniform(UniformBase* uniform, StateAttribute::OverrideValue value)
 {
+    dirtyHash();
+
     if (uniform)
     {
         int delta_update = 0;
@@ -1298,6 +1397,8 @@ void StateSet::addUniform(UniformBase* uniform, StateAttribute::OverrideValue va
 
 void StateSet::removeUniform(const std::string& name)
 {
+    dirtyHash();
+
     UniformList::iterator itr = _uniformList.find(name);
     if (itr!=_uniformList.end())
     {
@@ -1319,6 +1420,8 @@ void StateSet::removeUniform(const std::string& name)
 
 void StateSet::removeUniform(UniformBase* uniform)
 {
+    dirtyHash();
+
     if (!uniform) return;
 
     UniformList::iterator itr = _uniformList.find(uniform->getName());
@@ -1350,6 +1453,8 @@ UniformBase* StateSet::getUniformBase(const std::string& name)
 
 Uniform* StateSet::getOrCreateUniform(const std::string& name, Uniform::Type type, unsigned int numElements)
 {
+    dirtyHash();
+
     // for look for an appropriate uniform.
     UniformList::iterator itr = _uniformList.find(name);
     if (itr!=_uniformList.end())
@@ -1383,6 +1488,8 @@ const StateSet::RefUniformPair* StateSet::getUniformPair(const std::string& name
 
 void StateSet::setDefine(const std::string& defineName, StateAttribute::OverrideValue value)
 {
+    dirtyHash();
+
     DefinePair& dp = _defineList[defineName];
     dp.first = "";
     dp.second = value;
@@ -1390,6 +1497,8 @@ void StateSet::setDefine(const std::string& defineName, StateAttribute::Override
 
 void StateSet::setDefine(const std::string& defineName, const std::string& defineValue, StateAttribute::OverrideValue value)
 {
+    dirtyHash();
+
     DefinePair& dp = _defineList[defineName];
     dp.first = defineValue;
     dp.second = value;
@@ -1397,6 +1506,8 @@ void StateSet::setDefine(const std::string& defineName, const std::string& defin
 
 void StateSet::removeDefine(const std::string& defineName)
 {
+    dirtyHash();
+
     DefineList::iterator itr = _defineList.find(defineName);
     if (itr != _defineList.end()) _defineList.erase(itr);
 }
@@ -1508,6 +1619,8 @@ void StateSet::setTextureAttributeAndModes(unsigned int unit,StateAttribute *att
 
 void StateSet::removeTextureAttribute(unsigned int unit, StateAttribute::Type type)
 {
+    dirtyHash();
+
     if (unit>=_textureAttributeList.size()) return;
     AttributeList& attributeList = _textureAttributeList[unit];
     AttributeList::iterator itr = attributeList.find(StateAttribute::TypeMemberPair(type,0));
@@ -1536,6 +1649,8 @@ void StateSet::removeTextureAttribute(unsigned int unit, StateAttribute::Type ty
 
 void StateSet::removeTextureAttribute(unsigned int unit, StateAttribute* attribute)
 {
+    dirtyHash();
+
     if (!attribute) return;
     if (unit>=_textureAttributeList.size()) return;
 
@@ -1578,6 +1693,8 @@ const StateAttribute* StateSet::getTextureAttribute(unsigned int unit,StateAttri
 
 StateSet::RefAttributePair* StateSet::getTextureAttributePair(unsigned int unit, StateAttribute::Type type)
 {
+    dirtyHash();
+
     if (unit>=_textureAttributeList.size()) return 0;
     return getAttributePair(_textureAttributeList[unit],type);
 }
@@ -1712,6 +1829,8 @@ void StateSet::releaseGLObjects(State* state) const
 
 void StateSet::setRenderingHint(int hint)
 {
+    dirtyHash();
+
     _renderingHint = hint;
     // temporary hack to get new render bins working.
     switch(_renderingHint)
@@ -1740,6 +1859,8 @@ void StateSet::setRenderingHint(int hint)
 
 void StateSet::setRenderBinDetails(int binNum,const std::string& binName,RenderBinMode mode)
 {
+    dirtyHash();
+
     _binMode = mode;
     _binNum = binNum;
     _binName = binName;
@@ -1747,6 +1868,8 @@ void StateSet::setRenderBinDetails(int binNum,const std::string& binName,RenderB
 
 void StateSet::setRenderBinToInherit()
 {
+    dirtyHash();
+
     _binMode = INHERIT_RENDERBIN_DETAILS;
     _binNum = 0;
     _binName = "";
@@ -1754,12 +1877,16 @@ void StateSet::setRenderBinToInherit()
 
 void StateSet::setMode(ModeList& modeList,StateAttribute::GLMode mode, StateAttribute::GLModeValue value)
 {
+    dirtyHash();
+
     if ((value&StateAttribute::INHERIT)) setModeToInherit(modeList,mode);
     else modeList[mode] = value;
 }
 
 void StateSet::setModeToInherit(ModeList& modeList, StateAttribute::GLMode mode)
 {
+    dirtyHash();
+
     ModeList::iterator itr = modeList.find(mode);
     if (itr!=modeList.end())
     {
@@ -1856,6 +1983,8 @@ void StateSet::removeAssociatedTextureModes(unsigned int unit, const StateAttrib
 
 void StateSet::setAttribute(AttributeList& attributeList,StateAttribute *attribute, StateAttribute::OverrideValue value)
 {
+    dirtyHash();
+
     if (attribute)
     {
         int delta_update = 0;
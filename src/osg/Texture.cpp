@@ -1419,6 +1419,25 @@ int Texture::compareTexture(const Texture& rhs) const
     return 0;
 }
 
+uint64_t Texture::computeHash() const
+{
+    // only include parameters that compareTexture() always compares, floating point parameters are left out
+    // as values comparing equal, such as 0.0 and -0.0, can differ in their bit patterns.
+    uint64_t hash = StateAttribute::computeHash();
+    hash = hashCombine(hash, _wrap_s);
+    hash = hashCombine(hash, _wrap_t);
+    hash = hashCombine(hash, _wrap_r);
+    hash = hashCombine(hash, _min_filter);
+    hash = hashCombine(hash, _mag_filter);
+    hash = hashCombine(hash, _useHardwareMipMapGeneration ? 1 : 0);
+    hash = hashCombine(hash, _internalFormatMode);
+    hash = hashCombine(hash, _sourceFormat);
+    hash = hashCombine(hash, _sourceType);
+    hash = hashCombine(hash, _use_shadow_comparison ? 1 : 0);
+    hash = hashCombine(hash, _internalFormatType);
+    return hash;
+}
+
 int Texture::compareTextureObjects(const Texture& rhs) const
 {
     if (_textureObjectBuffer.size()<rhs._textureObjectBuffer.size()) return -1;
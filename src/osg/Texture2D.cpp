@@ -51,6 +51,21 @@ Texture2D::~Texture2D()
     setImage(NULL);
 }
 
+uint64_t Texture2D::computeHash() const
+{
+    uint64_t hash = Texture::computeHash();
+    if (_image.valid())
+    {
+        // Image::compare(..) compares the dimensions and formats of images before their data or file names.
+        hash = hashCombine(hash, _image->s());
+        hash = hashCombine(hash, _image->t());
+        hash = hashCombine(hash, _image->getInternalTextureFormat());
+        hash = hashCombine(hash, _image->getPixelFormat());
+        hash = hashCombine(hash, _image->getDataType());
+    }
+    return hash;
+}
+
 int Texture2D::compare(const StateAttribute& sa) const
 {
     // check the types are equal and then create the rhs variable
@@ -17,6 +17,8 @@
 #include <osgDB/Registry>
 #include <osgDB/ObjectWrapper>
 #include <sstream>
+#include <vector>
+#include <string.h>
 
 using namespace osgDB;
 
@@ -48,6 +50,261 @@ public:
 
 REGISTER_COMPRESSOR( "null", NullCompressor )
 
+// LZ77 compressor using an LZ4 style byte aligned block format, trading compression ratio for very fast decompression.
+// Data is split into independent blocks so both directions can be streamed, each block is stored raw if it doesn't compress.
+// The level selects how hard the compressor searches for matches: 1 is a single hash probe per position with acceleration
+// over incompressible data, higher levels follow hash chains of up to 2^(level-1) candidates.
+class LZCompressor : public BaseCompressor
+{
+public:
+    LZCompressor( int level=1 ) : _level(level) {}
+
+    void setLevel( int level ) { _level = level; }
+    int getLevel() const { return _level; }
+
+    enum
+    {
+        BLOCK_SIZE = 256*1024,
+        HASH_LOG = 16,
+        MIN_MATCH = 4,
+        MAX_OFFSET = 65535
+    };
+
+    virtual bool compress( std::ostream& fout, const std::string& src )
+    {
+        unsigned int blockSize = BLOCK_SIZE;
+        fout.write( (char*)&blockSize, INT_SIZE );
+
+        // match finder tables are local so a registered compressor can be used by several threads at once
+        std::vector<int> head, chain;
+        std::vector<unsigned char> packed;
+        const unsigned char* data = reinterpret_cast<const unsigned char*>( src.data() );
+        for ( size_t offset=0; offset<src.size(); offset+=blockSize )
+        {
+            unsigned int rawSize = static_cast<unsigned int>( osg::minimum(src.size()-offset, static_cast<size_t>(blockSize)) );
+            compressBlock( data+offset, rawSize, packed, head, chain );
+
+            // store blocks that don't compress as is, signalled by the packed size equalling the raw size
+            bool stored = packed.size()>=rawSize;
+            unsigned int packedSize = stored ? rawSize : static_cast<unsigned int>(packed.size());
+            fout.write( (char*)&rawSize, INT_SIZE );
+            fout.write( (char*)&packedSize, INT_SIZE );
+            if ( stored ) fout.write( (const char*)(data+offset), rawSize );
+            else fout.write( (const char*)&packed.front(), packedSize );
+
+            if ( fout.fail() ) return false;
+        }
+
+        unsigned int endMarker = 0;
+        fout.write( (char*)&endMarker, INT_SIZE );
+        return !fout.fail();
+    }
+
+    virtual bool decompress( std::istream& fin, std::string& target )
+    {
+        unsigned int blockSize = 0;
+        fin.read( (char*)&blockSize, INT_SIZE );
+        if ( fin.fail() || blockSize==0 ) return false;
+
+        std::vector<unsigned char> packed;
+        while ( true )
+        {
+            unsigned int rawSize = 0, packedSize = 0;
+            fin.read( (char*)&rawSize, INT_SIZE );
+            if ( fin.fail() ) return false;
+            if ( rawSize==0 ) break;
+
+            fin.read( (char*)&packedSize, INT_SIZE );
+            if ( fin.fail() || rawSize>blockSize || packedSize>rawSize || packedSize==0 ) return false;
+
+            size_t position = target.size();
+            target.resize( position+rawSize );
+            unsigned char* output = reinterpret_cast<unsigned char*>( &target[position] );
+            if ( packedSize==rawSize )
+            {
+                fin.read( (char*)output, rawSize );
+                if ( fin.fail() ) return false;
+            }
+            else
+            {
+                packed.resize( packedSize );
+                fin.read( (char*)&packed.front(), packedSize );
+                if ( fin.fail() || !decompressBlock(&packed.front(), packedSize, output, rawSize) ) return false;
+            }
+        }
+        return true;
+    }
+
+protected:
+
+    static unsigned int read32( const unsigned char* ptr )
+    {
+        unsigned int value; memcpy( &value, ptr, 4 ); return value;
+    }
+
+    static unsigned int hash( unsigned int value )
+    {
+        return (value * 2654435761u) >> (32-HASH_LOG);
+    }
+
+    static void writeLength( std::vector<unsigned char>& dst, size_t length )
+    {
+        while ( length>=255 ) { dst.push_back( 255 ); length -= 255; }
+        dst.push_back( static_cast<unsigned char>(length) );
+    }
+
+    static void writeSequence( std::vector<unsigned char>& dst, const unsigned char* literals, size_t numLiterals, size_t offset, size_t matchLength )
+    {
+        size_t extraMatchLength = matchLength>0 ? matchLength-MIN_MATCH : 0;
+        unsigned char token = static_cast<unsigned char>( (osg::minimum(numLiterals, static_cast<size_t>(15))<<4) | osg::minimum(extraMatchLength, static_cast<size_t>(15)) );
+        dst.push_back( token );
+        if ( numLiterals>=15 ) writeLength( dst, numLiterals-15 );
+        dst.insert( dst.end(), literals, literals+numLiterals );
+
+        // the final sequence of a block has only literals
+        if ( matchLength==0 ) return;
+
+        dst.push_back( static_cast<unsigned char>(offset & 0xff) );
+        dst.push_back( static_cast<unsigned char>(offset >> 8) );
+        if ( extraMatchLength>=15 ) writeLength( dst, extraMatchLength-15 );
+    }
+
+    void compressBlock( const unsigned char* src, size_t size, std::vector<unsigned char>& dst, std::vector<int>& head, std::vector<int>& chain ) const
+    {
+        dst.clear();
+        dst.reserve( size + size/255 + 16 );
+
+        const unsigned int maxAttempts = _level>1 ? (1u << osg::minimum(_level-1, 12)) : 1u;
+        head.assign( 1<<HASH_LOG, -1 );
+        if ( _level>1 ) chain.resize( size );
+
+        size_t anchor = 0, position = 0;
+        while ( position+MIN_MATCH<=size )
+        {
+            unsigned int sequence = read32( src+position );
+            unsigned int h = hash( sequence );
+
+            size_t bestLength = 0, bestOffset = 0;
+            int candidate = head[h];
+            for ( unsigned int attempt=0; candidate>=0 && attempt<maxAttempts && position-candidate<=MAX_OFFSET; ++attempt )
+            {
+                if ( read32(src+candidate)==sequence )
+                {
+                    size_t length = MIN_MATCH;
+                    while ( position+length<size && src[candidate+length]==src[position+length] ) ++length;
+                    if ( length>bestLength ) { bestLength = length; bestOffset = position-candidate; }
+                }
+                if ( _level<=1 ) break;
+                candidate = chain[candidate];
+            }
+
+            if ( _level>1 ) chain[position] = head[h];
+            head[h] = static_cast<int>(position);
+
+            if ( bestLength>=MIN_MATCH )
+            {
+                writeSequence( dst, src+anchor, position-anchor, bestOffset, bestLength );
+
+                // index the positions covered by the match so later matches can refer into it
+                size_t end = position+bestLength;
+                for ( ++position; position<end; ++position )
+                {
+                    if ( _level<=1 && position+1<end ) continue;
+                    if ( position+MIN_MATCH>size ) break;
+                    unsigned int hp = hash( read32(src+position) );
+                    if ( _level>1 ) chain[position] = head[hp];
+                    head[hp] = static_cast<int>(position);
+                }
+                position = end;
+                anchor = end;
+            }
+            else
+            {
+                // skip faster through data that isn't matching
+                position += (_level<=1) ? 1 + ((position-anchor)>>6) : 1;
+            }
+        }
+
+        writeSequence( dst, src+anchor, size-anchor, 0, 0 );
+    }
+
+    static bool readLength( const unsigned char*& ip, const unsigned char* end, size_t& length )
+    {
+        unsigned char value;
+        do
+        {
+            if ( ip>=end ) return false;
+            value = *ip++;
+            length += value;
+        } while ( value==255 );
+        return true;
+    }
+
+    static bool decompressBlock( const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize )
+    {
+        const unsigned char* ip = src;
+        const unsigned char* ipEnd = src+srcSize;
+        unsigned char* op = dst;
+        unsigned char* opEnd = dst+dstSize;
+
+        while ( ip<ipEnd )
+        {
+            unsigned char token = *ip++;
+
+            size_t numLiterals = token>>4;
+            if ( numLiterals==15 && !readLength(ip, ipEnd, numLiterals) ) return false;
+            if ( numLiterals>static_cast<size_t>(ipEnd-ip) || numLiterals>static_cast<size_t>(opEnd-op) ) return false;
+            memcpy( op, ip, numLiterals );
+            ip += numLiterals; op += numLiterals;
+
+            if ( ip==ipEnd ) break;
+
+            if ( ipEnd-ip<2 ) return false;
+            size_t offset = ip[0] | (ip[1]<<8);
+            ip += 2;
+            if ( offset==0 || offset>static_cast<size_t>(op-dst) ) return false;
+
+            size_t matchLength = token & 15;
+            if ( matchLength==15 && !readLength(ip, ipEnd, matchLength) ) return false;
+            matchLength += MIN_MATCH;
+            if ( matchLength>static_cast<size_t>(opEnd-op) ) return false;
+
+            const unsigned char* match = op-offset;
+            if ( offset>=matchLength )
+            {
+                memcpy( op, match, matchLength );
+                op += matchLength;
+            }
+            else
+            {
+                // overlapping copy repeats the last offset bytes
+                for ( size_t i=0; i<matchLength; ++i ) *op++ = *match++;
+            }
+        }
+        return op==opEnd;
+    }
+
+    int _level;
+};
+
+// Fast LZ compression, the default choice for paged databases where load time matters most
+class LZFastCompressor : public LZCompressor
+{
+public:
+    LZFastCompressor() : LZCompressor(1) {}
+};
+
+REGISTER_COMPRESSOR( "lz", LZFastCompressor )
+
+// Slower LZ compression giving smaller files that decompress just as quickly
+class LZHighCompressor : public LZCompressor
+{
+public:
+    LZHighCompressor() : LZCompressor(9) {}
+};
+
+REGISTER_COMPRESSOR( "lzhc", LZHighCompressor )
+
 #ifdef USE_ZLIB
 
 #include <zlib.h>
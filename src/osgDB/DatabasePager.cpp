@@ -22,6 +22,7 @@
 #include <osg/Texture>
 #include <osg/Notify>
 #include <osg/ProxyNode>
+#include <osg/Camera>
 #include <osg/ApplicationUsage>
 
 #include <OpenThreads/ScopedLock>
@@ -30,6 +31,7 @@
 #include <functional>
 #include <set>
 #include <iterator>
+#include <sstream>
 
 #include <stdlib.h>
 #include <string.h>
@@ -48,6 +50,8 @@ static osg::ApplicationUsageProxy DatabasePager_e3(osg::ApplicationUsage::ENVIRO
 static osg::ApplicationUsageProxy DatabasePager_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_DATABASE_PAGER_PRIORITY <mode>", "Set the thread priority to DEFAULT, MIN, LOW, NOMINAL, HIGH or MAX.");
 static osg::ApplicationUsageProxy DatabasePager_e11(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAX_PAGEDLOD <num>","Set the target maximum number of PagedLOD to maintain.");
 static osg::ApplicationUsageProxy DatabasePager_e12(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_ASSIGN_PBO_TO_IMAGES <ON/OFF>","Set whether PixelBufferObjects should be assigned to Images to aid download to the GPU.");
+static osg::ApplicationUsageProxy DatabasePager_e13(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_MAX_PAGEDLOD_EXPIRY_VISITS <num>","Set the maximum number of PagedLOD visited by the expiry pass each frame, 0 for no limit.");
+static osg::ApplicationUsageProxy DatabasePager_e14(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_PAGEDLOD_EXPIRY_TIME_BUDGET <microseconds>","Set the time the expiry pass may spend visiting PagedLOD each frame, 0 for no limit.");
 
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -141,29 +145,56 @@ public:
     typedef std::set< osg::observer_ptr<osg::PagedLOD> > PagedLODs;
     PagedLODs _pagedLODs;
 
+    // where the inactive [0] and active [1] expiry passes resume from.
+    PagedLODs::iterator _cursor[2];
+
+    SetBasedPagedLODList()
+    {
+        _cursor[0] = _cursor[1] = _pagedLODs.end();
+    }
 
     virtual PagedLODList* clone() { return new SetBasedPagedLODList(); }
-    virtual void clear() { _pagedLODs.clear(); }
+    virtual void clear() { _pagedLODs.clear(); _cursor[0] = _cursor[1] = _pagedLODs.end(); }
     virtual unsigned int size() { return _pagedLODs.size(); }
 
     virtual void removeExpiredChildren(
         int numberChildrenToRemove, double expiryTime, unsigned int expiryFrame,
         DatabasePager::ObjectList& childrenRemoved, bool visitActive)
     {
+        DatabasePager::ExpiryPass expiryPass;
+        removeExpiredChildren(numberChildrenToRemove, expiryTime, expiryFrame, childrenRemoved, visitActive, expiryPass);
+    }
+
+    virtual void removeExpiredChildren(
+        int numberChildrenToRemove, double expiryTime, unsigned int expiryFrame,
+        DatabasePager::ObjectList& childrenRemoved, bool visitActive, DatabasePager::ExpiryPass& expiryPass)
+    {
+        PagedLODs::iterator& cursor = _cursor[visitActive ? 1 : 0];
+
+        // without a budget every PagedLOD is visited each frame, so start from the beginning as a pass isn't resumed.
+        if (expiryPass.unlimited()) cursor = _pagedLODs.begin();
+
         int leftToRemove = numberChildrenToRemove;
-        for(PagedLODs::iterator itr = _pagedLODs.begin();
-            itr!=_pagedLODs.end() && leftToRemove > 0;
-            )
+        unsigned int leftToVisit = _pagedLODs.size();
+        PagedLODs::iterator itr = cursor;
+        while(leftToVisit>0 && leftToRemove>0 && !expiryPass.budgetExhausted())
         {
+            // wrap around so that successive passes cycle through the whole list.
+            if (itr==_pagedLODs.end()) itr = _pagedLODs.begin();
+
+            --leftToVisit;
+            ++expiryPass._numVisited;
+
             osg::ref_ptr<osg::PagedLOD> plod;
             if (itr->lock(plod))
             {
                 bool plodActive = expiryFrame < plod->getFrameNumberOfLastTraversal();
+                bool expired = false;
                 if (visitActive==plodActive) // true if (visitActive && plodActive) OR (!visitActive &&!plodActive)
                 {
                     DatabasePager::ExpirePagedLODsVisitor expirePagedLODsVisitor;
                     osg::NodeList expiredChildren; // expired PagedLODs
-                    expirePagedLODsVisitor.removeExpiredChildrenAndFindPagedLODs(
+                    expired = expirePagedLODsVisitor.removeExpiredChildrenAndFindPagedLODs(
                         plod.get(), expiryTime, expiryFrame, expiredChildren);
                     // Clear any expired PagedLODs out of the set
                     for (DatabasePager::ExpirePagedLODsVisitor::PagedLODset::iterator
@@ -177,24 +208,48 @@ public:
                         // PagedLOD pointed to by itr because it must be
                         // in itr's subgraph. Therefore erasing it doesn't
                         // invalidate itr.
-                        if (_pagedLODs.erase(clod) > 0)
+                        PagedLODs::iterator clod_itr = _pagedLODs.find(clod);
+                        if (clod_itr != _pagedLODs.end())
+                        {
+                            erase(clod_itr);
                             leftToRemove--;
+                        }
                     }
                     std::copy(expiredChildren.begin(), expiredChildren.end(), std::back_inserter(childrenRemoved));
                 }
 
+                if (expired) ++expiryPass._numExpired;
+                else ++expiryPass._numSkipped;
+
                 // advance the iterator to the next element
                 ++itr;
             }
             else
             {
-                _pagedLODs.erase(itr++);
+                PagedLODs::iterator next_itr = itr;
+                ++next_itr;
+                erase(itr);
+                itr = next_itr;
+                ++expiryPass._numInvalid;
                 // numberChildrenToRemove includes possibly expired
                 // observer pointers.
                 leftToRemove--;
                 OSG_INFO<<"DatabasePager::removeExpiredSubgraphs() _inactivePagedLOD has been invalidated, but ignored"<<std::endl;
             }
+
+            // removing child PagedLODs can shrink the list below the number left to visit.
+            if (leftToVisit>_pagedLODs.size()) leftToVisit = _pagedLODs.size();
         }
+
+        cursor = itr;
+    }
+
+    // erase an entry, moving on any cursor that refers to it.
+    void erase(PagedLODs::iterator itr)
+    {
+        if (_cursor[0]==itr) ++_cursor[0];
+        if (_cursor[1]==itr) ++_cursor[1];
+        _pagedLODs.erase(itr);
     }
 
     virtual void removeNodes(osg::NodeList& nodesToRemove)
@@ -209,7 +264,7 @@ public:
             if (plod_itr != _pagedLODs.end())
             {
                 OSG_INFO<<"Removing node from PagedLOD list"<<std::endl;
-                _pagedLODs.erase(plod_itr);
+                erase(plod_itr);
             }
         }
     }
@@ -350,12 +405,20 @@ protected:
 //
 struct DatabasePager::SortFileRequestFunctor
 {
-    bool operator() (const osg::ref_ptr<DatabasePager::DatabaseRequest>& lhs,const osg::ref_ptr<DatabasePager::DatabaseRequest>& rhs) const
+    // requests made in the most recent frame come first, then the most recent time stamp, then the highest priority.
+    bool operator() (const DatabasePager::DatabaseRequest* lhs, const DatabasePager::DatabaseRequest* rhs) const
     {
-        if (lhs->_timestampLastRequest>rhs->_timestampLastRequest) return true;
+        if (lhs->_frameNumberLastRequest>rhs->_frameNumberLastRequest) return true;
+        else if (lhs->_frameNumberLastRequest<rhs->_frameNumberLastRequest) return false;
+        else if (lhs->_timestampLastRequest>rhs->_timestampLastRequest) return true;
         else if (lhs->_timestampLastRequest<rhs->_timestampLastRequest) return false;
         else return (lhs->_priorityLastRequest>rhs->_priorityLastRequest);
     }
+
+    bool operator() (const osg::ref_ptr<DatabasePager::DatabaseRequest>& lhs,const osg::ref_ptr<DatabasePager::DatabaseRequest>& rhs) const
+    {
+        return (*this)(lhs.get(), rhs.get());
+    }
 };
 
 
@@ -390,6 +453,7 @@ DatabasePager::RequestQueue::~RequestQueue()
         itr != _requestList.end();
         ++itr)
     {
+        (*itr)->_requestQueue = 0;
         invalidate(itr->get());
     }
 }
@@ -408,6 +472,104 @@ void DatabasePager::RequestQueue::invalidate(DatabaseRequest* dr)
     dr->invalidate();
 }
 
+void DatabasePager::RequestQueue::placeNoLock(DatabaseRequest* databaseRequest, unsigned int index)
+{
+    databaseRequest->_requestQueue = this;
+    databaseRequest->_requestQueueIndex = index;
+}
+
+unsigned int DatabasePager::RequestQueue::siftUpNoLock(unsigned int index)
+{
+    DatabasePager::SortFileRequestFunctor highPriority;
+    while(index>0)
+    {
+        unsigned int parent = (index-1)/2;
+        if (!highPriority(_requestList[index], _requestList[parent])) break;
+
+        _requestList[index].swap(_requestList[parent]);
+        placeNoLock(_requestList[index].get(), index);
+        placeNoLock(_requestList[parent].get(), parent);
+        index = parent;
+    }
+    return index;
+}
+
+void DatabasePager::RequestQueue::siftDownNoLock(unsigned int index)
+{
+    DatabasePager::SortFileRequestFunctor highPriority;
+    unsigned int size = _requestList.size();
+    for(;;)
+    {
+        unsigned int selected = index;
+        unsigned int left = index*2+1;
+        unsigned int right = left+1;
+        if (left<size && highPriority(_requestList[left], _requestList[selected])) selected = left;
+        if (right<size && highPriority(_requestList[right], _requestList[selected])) selected = right;
+        if (selected==index) break;
+
+        _requestList[index].swap(_requestList[selected]);
+        placeNoLock(_requestList[index].get(), index);
+        placeNoLock(_requestList[selected].get(), selected);
+        index = selected;
+    }
+}
+
+void DatabasePager::RequestQueue::rebuildHeapNoLock()
+{
+    for(unsigned int i=0; i<_requestList.size(); ++i)
+    {
+        placeNoLock(_requestList[i].get(), i);
+    }
+
+    for(unsigned int i=_requestList.size()/2; i>0; --i)
+    {
+        siftDownNoLock(i-1);
+    }
+}
+
+void DatabasePager::RequestQueue::eraseNoLock(unsigned int index)
+{
+    _requestList[index]->_requestQueue = 0;
+
+    unsigned int last = _requestList.size()-1;
+    if (index!=last)
+    {
+        _requestList[index].swap(_requestList[last]);
+        placeNoLock(_requestList[index].get(), index);
+    }
+    _requestList.pop_back();
+
+    if (index<_requestList.size() && siftUpNoLock(index)==index)
+    {
+        siftDownNoLock(index);
+    }
+}
+
+void DatabasePager::RequestQueue::pruneOldRequestsNoLock(unsigned int frameNumber)
+{
+    unsigned int numCurrent = 0;
+    for(unsigned int i=0; i<_requestList.size(); ++i)
+    {
+        if (_requestList[i]->isRequestCurrent(frameNumber))
+        {
+            if (i!=numCurrent) _requestList[numCurrent].swap(_requestList[i]);
+            ++numCurrent;
+        }
+        else
+        {
+            _requestList[i]->_requestQueue = 0;
+            invalidate(_requestList[i].get());
+
+            OSG_INFO<<"DatabasePager::RequestQueue::pruneOldRequestsNoLock(): Pruning "<<_requestList[i].get()<<std::endl;
+        }
+    }
+
+    _requestList.resize(numCurrent);
+
+    rebuildHeapNoLock();
+
+    _frameNumberLastPruned = frameNumber;
+}
 
 bool DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty()
 {
@@ -416,26 +578,11 @@ bool DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty()
     unsigned int frameNumber = _pager->_frameNumber;
     if (_frameNumberLastPruned != frameNumber)
     {
-        for(RequestQueue::RequestList::iterator citr = _requestList.begin();
-            citr != _requestList.end();
-            )
         {
             OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-            if ((*citr)->isRequestCurrent(frameNumber))
-            {
-                ++citr;
-            }
-            else
-            {
-                invalidate(citr->get());
-
-                OSG_INFO<<"DatabasePager::RequestQueue::pruneOldRequestsAndCheckIfEmpty(): Pruning "<<(*citr)<<std::endl;
-                citr = _requestList.erase(citr);
-            }
+            pruneOldRequestsNoLock(frameNumber);
         }
 
-        _frameNumberLastPruned = frameNumber;
-
         updateBlock();
     }
 
@@ -458,12 +605,15 @@ void DatabasePager::RequestQueue::clear()
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
 
-    for(RequestList::iterator citr = _requestList.begin();
-        citr != _requestList.end();
-        ++citr)
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-        invalidate(citr->get());
+        for(RequestList::iterator citr = _requestList.begin();
+            citr != _requestList.end();
+            ++citr)
+        {
+            (*citr)->_requestQueue = 0;
+            invalidate(citr->get());
+        }
     }
 
     _requestList.clear();
@@ -485,30 +635,56 @@ void DatabasePager::RequestQueue::remove(DatabasePager::DatabaseRequest* databas
 {
     // OSG_NOTICE<<"DatabasePager::RequestQueue::remove(DatabaseRequest* databaseRequest)"<<std::endl;
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
-    for(RequestList::iterator citr = _requestList.begin();
-        citr != _requestList.end();
-        ++citr)
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+    if (databaseRequest->_requestQueue==this)
     {
-        if (citr->get()==databaseRequest)
-        {
-            // OSG_NOTICE<<"  done remove(DatabaseRequest* databaseRequest)"<<std::endl;
-            _requestList.erase(citr);
-            return;
-        }
+        // OSG_NOTICE<<"  done remove(DatabaseRequest* databaseRequest)"<<std::endl;
+        eraseNoLock(databaseRequest->_requestQueueIndex);
     }
 }
 
 
 void DatabasePager::RequestQueue::addNoLock(DatabasePager::DatabaseRequest* databaseRequest)
 {
-    _requestList.push_back(databaseRequest);
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+        _requestList.push_back(databaseRequest);
+        placeNoLock(databaseRequest, _requestList.size()-1);
+        siftUpNoLock(_requestList.size()-1);
+    }
     updateBlock();
 }
 
+bool DatabasePager::RequestQueue::updateLastRequest(DatabasePager::DatabaseRequest* databaseRequest, unsigned int frameNumber, double timestamp, float priority)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+    if (databaseRequest->_requestQueue!=this) return false;
+
+    databaseRequest->_frameNumberLastRequest = frameNumber;
+    databaseRequest->_timestampLastRequest = timestamp;
+    databaseRequest->_priorityLastRequest = priority;
+
+    unsigned int index = databaseRequest->_requestQueueIndex;
+    if (siftUpNoLock(index)==index) siftDownNoLock(index);
+
+    return true;
+}
+
 void DatabasePager::RequestQueue::swap(RequestList& requestList)
 {
     OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_requestMutex);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
     _requestList.swap(requestList);
+
+    for(RequestList::iterator itr = requestList.begin();
+        itr != requestList.end();
+        ++itr)
+    {
+        (*itr)->_requestQueue = 0;
+    }
+
+    rebuildHeapNoLock();
 }
 
 void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& databaseRequest)
@@ -517,47 +693,36 @@ void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& datab
 
     if (!_requestList.empty())
     {
-        DatabasePager::SortFileRequestFunctor highPriority;
-
-        RequestQueue::RequestList::iterator selected_itr = _requestList.end();
-
         int frameNumber = _pager->_frameNumber;
 
-        for(RequestQueue::RequestList::iterator citr = _requestList.begin();
-            citr != _requestList.end();
-            )
         {
             OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
-            if ((*citr)->isRequestCurrent(frameNumber))
-            {
-                if (selected_itr==_requestList.end() || highPriority(*citr, *selected_itr))
-                {
-                    selected_itr = citr;
-                }
 
-                ++citr;
-            }
-            else
+            // a full sweep of stale requests is only needed once per frame, between sweeps
+            // stale requests sort behind all current ones so only the front of the heap needs checking.
+            if (_frameNumberLastPruned != static_cast<unsigned int>(frameNumber))
             {
-                invalidate(citr->get());
-
-                OSG_INFO<<"DatabasePager::RequestQueue::takeFirst(): Pruning "<<(*citr)<<std::endl;
-                citr = _requestList.erase(citr);
+                pruneOldRequestsNoLock(frameNumber);
             }
 
-        }
+            while(!_requestList.empty() && !_requestList.front()->isRequestCurrent(frameNumber))
+            {
+                invalidate(_requestList.front().get());
 
-        _frameNumberLastPruned = frameNumber;
+                OSG_INFO<<"DatabasePager::RequestQueue::takeFirst(): Pruning "<<_requestList.front().get()<<std::endl;
+                eraseNoLock(0);
+            }
 
-        if (selected_itr != _requestList.end())
-        {
-            databaseRequest = *selected_itr;
-            _requestList.erase(selected_itr);
-            OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() Found DatabaseRequest size()="<<_requestList.size()<<std::endl;
-        }
-        else
-        {
-            OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() No suitable DatabaseRequest found size()="<<_requestList.size()<<std::endl;
+            if (!_requestList.empty())
+            {
+                databaseRequest = _requestList.front();
+                eraseNoLock(0);
+                OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() Found DatabaseRequest size()="<<_requestList.size()<<std::endl;
+            }
+            else
+            {
+                OSG_INFO<<" DatabasePager::RequestQueue::takeFirst() No suitable DatabaseRequest found size()="<<_requestList.size()<<std::endl;
+            }
         }
 
         updateBlock();
@@ -570,15 +735,40 @@ void DatabasePager::RequestQueue::takeFirst(osg::ref_ptr<DatabaseRequest>& datab
 //
 DatabasePager::ReadQueue::ReadQueue(DatabasePager* pager, const std::string& name):
     RequestQueue(pager),
-    _name(name)
+    _name(name),
+    _hasWork(false)
 {
     _block = new osg::RefBlock;
 }
 
+void DatabasePager::ReadQueue::shareBlock(ReadQueue* lane)
+{
+    lane->_block = _block;
+    _sharedLanes.push_back(lane);
+    lane->_sharedLanes.push_back(this);
+}
+
 void DatabasePager::ReadQueue::updateBlock()
 {
-    _block->set((!_requestList.empty() || !_childrenToDeleteList.empty()) &&
-                !_pager->_databasePagerThreadPaused);
+    bool hasWork = !_requestList.empty() || !_childrenToDeleteList.empty();
+
+    if (_sharedLanes.empty())
+    {
+        _block->set(hasWork && !_pager->_databasePagerThreadPaused);
+        return;
+    }
+
+    // the block is shared so it must remain released while any of the lanes still has work.
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_pager->_laneMutex);
+    _hasWork = hasWork;
+    for(std::vector<ReadQueue*>::iterator itr = _sharedLanes.begin();
+        itr != _sharedLanes.end();
+        ++itr)
+    {
+        if ((*itr)->_hasWork) hasWork = true;
+    }
+
+    _block->set(hasWork && !_pager->_databasePagerThreadPaused);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -590,7 +780,10 @@ DatabasePager::DatabaseThread::DatabaseThread(DatabasePager* pager, Mode mode, c
     _active(false),
     _pager(pager),
     _mode(mode),
-    _name(name)
+    _name(name),
+    _utilisationStartTick(osg::Timer::instance()->tick()),
+    _activeStartTick(_utilisationStartTick),
+    _activeTime(0.0)
 {
 }
 
@@ -599,7 +792,10 @@ DatabasePager::DatabaseThread::DatabaseThread(const DatabaseThread& dt, Database
     _active(false),
     _pager(pager),
     _mode(dt._mode),
-    _name(dt._name)
+    _name(dt._name),
+    _utilisationStartTick(osg::Timer::instance()->tick()),
+    _activeStartTick(_utilisationStartTick),
+    _activeTime(0.0)
 {
 }
 
@@ -627,6 +823,9 @@ int DatabasePager::DatabaseThread::cancel()
             case(HANDLE_ONLY_HTTP):
                 _pager->_httpRequestQueue->release();
                 break;
+            case(HANDLE_ONLY_ARCHIVE):
+                _pager->_archiveRequestQueue->release();
+                break;
         }
 
         join();
@@ -639,6 +838,45 @@ int DatabasePager::DatabaseThread::cancel()
 
 }
 
+void DatabasePager::DatabaseThread::startActivePeriod()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_utilisationMutex);
+    _activeStartTick = osg::Timer::instance()->tick();
+    _active = true;
+}
+
+void DatabasePager::DatabaseThread::endActivePeriod()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_utilisationMutex);
+    if (_active)
+    {
+        _activeTime += osg::Timer::instance()->delta_s(_activeStartTick, osg::Timer::instance()->tick());
+    }
+    _active = false;
+}
+
+double DatabasePager::DatabaseThread::getUtilisationAndReset()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_utilisationMutex);
+
+    osg::Timer_t currentTick = osg::Timer::instance()->tick();
+
+    // account for a request that is still being read so long reads don't report as idle.
+    if (_active)
+    {
+        _activeTime += osg::Timer::instance()->delta_s(_activeStartTick, currentTick);
+        _activeStartTick = currentTick;
+    }
+
+    double period = osg::Timer::instance()->delta_s(_utilisationStartTick, currentTick);
+    double utilisation = period>0.0 ? _activeTime/period : 0.0;
+
+    _utilisationStartTick = currentTick;
+    _activeTime = 0.0;
+
+    return utilisation;
+}
+
 void DatabasePager::DatabaseThread::run()
 {
     OSG_INFO<<_name<<": DatabasePager::DatabaseThread::run"<<std::endl;
@@ -647,26 +885,35 @@ void DatabasePager::DatabaseThread::run()
     bool firstTime = true;
 
     osg::ref_ptr<DatabasePager::ReadQueue> read_queue;
-    osg::ref_ptr<DatabasePager::ReadQueue> out_queue;
+    osg::ref_ptr<DatabasePager::ReadQueue> steal_queue;
+    osg::ref_ptr<DatabasePager::ReadQueue> delete_queue;
+    osg::ref_ptr<DatabasePager::ReadQueue> out_queue = _pager->_httpRequestQueue;
 
+    // local file and archive threads share a block and steal from each other's lane when their own is empty,
+    // http threads only service the http lane as they would otherwise stall local reads behind network latency.
     switch(_mode)
     {
         case(HANDLE_ALL_REQUESTS):
-            read_queue = _pager->_fileRequestQueue;
-            break;
         case(HANDLE_NON_HTTP):
             read_queue = _pager->_fileRequestQueue;
-            out_queue = _pager->_httpRequestQueue;
+            steal_queue = _pager->_archiveRequestQueue;
+            delete_queue = _pager->_fileRequestQueue;
             break;
         case(HANDLE_ONLY_HTTP):
             read_queue = _pager->_httpRequestQueue;
+            delete_queue = _pager->_httpRequestQueue;
+            break;
+        case(HANDLE_ONLY_ARCHIVE):
+            read_queue = _pager->_archiveRequestQueue;
+            steal_queue = _pager->_fileRequestQueue;
+            delete_queue = _pager->_fileRequestQueue;
             break;
     }
 
 
     do
     {
-        _active = false;
+        endActivePeriod();
 
         read_queue->block();
 
@@ -675,9 +922,9 @@ void DatabasePager::DatabaseThread::run()
             break;
         }
 
-        _active = true;
+        startActivePeriod();
 
-        OSG_INFO<<_name<<": _pager->size()= "<<read_queue->size()<<" to delete = "<<read_queue->_childrenToDeleteList.size()<<std::endl;
+        OSG_INFO<<_name<<": _pager->size()= "<<read_queue->size()<<" to delete = "<<delete_queue->_childrenToDeleteList.size()<<std::endl;
 
 
 
@@ -689,11 +936,11 @@ void DatabasePager::DatabaseThread::run()
             ObjectList deleteList;
             {
                 // Don't hold lock during destruction of deleteList
-                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(read_queue->_requestMutex);
-                if (!read_queue->_childrenToDeleteList.empty())
+                OpenThreads::ScopedLock<OpenThreads::Mutex> lock(delete_queue->_requestMutex);
+                if (!delete_queue->_childrenToDeleteList.empty())
                 {
-                    deleteList.swap(read_queue->_childrenToDeleteList);
-                    read_queue->updateBlock();
+                    deleteList.swap(delete_queue->_childrenToDeleteList);
+                    delete_queue->updateBlock();
                 }
             }
         }
@@ -704,6 +951,25 @@ void DatabasePager::DatabaseThread::run()
         osg::ref_ptr<DatabaseRequest> databaseRequest;
         read_queue->takeFirst(databaseRequest);
 
+        DatabasePager::ReadQueue* source_queue = read_queue.get();
+        if (!databaseRequest.valid() && steal_queue.valid())
+        {
+            steal_queue->takeFirst(databaseRequest);
+            source_queue = steal_queue.get();
+        }
+
+        // requests from the archive lane have already been routed, local file requests taken by an archive
+        // thread still need the http routing that the local file threads would have applied.
+        Mode requestMode = _mode;
+        if (source_queue==_pager->_archiveRequestQueue.get())
+        {
+            requestMode = HANDLE_ALL_REQUESTS;
+        }
+        else if (_mode==HANDLE_ONLY_ARCHIVE)
+        {
+            requestMode = _pager->_numHttpThreads>0 ? HANDLE_NON_HTTP : HANDLE_ALL_REQUESTS;
+        }
+
         bool readFromFileCache = false;
 
         osg::ref_ptr<FileCache> fileCache = osgDB::Registry::instance()->getFileCache();
@@ -788,9 +1054,10 @@ void DatabasePager::DatabaseThread::run()
             {
 
                 // now check to see if this request is appropriate for this thread
-                switch(_mode)
+                switch(requestMode)
                 {
                     case(HANDLE_ALL_REQUESTS):
+                    case(HANDLE_ONLY_ARCHIVE):
                     {
                         // do nothing as this thread can handle the load
                         if (fileCache.valid() && fileCache->isFileAppropriateForFileCache(fileName))
@@ -977,6 +1244,9 @@ DatabasePager::DatabasePager()
     _numFramesActive = 0;
     _frameNumber.exchange(0);
 
+    _numArchiveThreads = 0;
+    _numHttpThreads = 0;
+
 
 #if __APPLE__
     // OSX really doesn't like compiling display lists, and performs poorly when they are used,
@@ -1039,6 +1309,18 @@ DatabasePager::DatabasePager()
         OSG_NOTICE<<"_targetMaximumNumberOfPageLOD = "<<_targetMaximumNumberOfPageLOD<<std::endl;
     }
 
+    _maximumNumberOfPagedLODsToVisitPerFrame = 0;
+    if( (str = getenv("OSG_MAX_PAGEDLOD_EXPIRY_VISITS")) != 0)
+    {
+        _maximumNumberOfPagedLODsToVisitPerFrame = atoi(str);
+    }
+
+    _expiryTimeBudgetPerFrame = 0.0;
+    if( (str = getenv("OSG_PAGEDLOD_EXPIRY_TIME_BUDGET")) != 0)
+    {
+        _expiryTimeBudgetPerFrame = osg::asciiToDouble(str);
+    }
+
 
     _doPreCompile = true;
     if( (str = getenv("OSG_DO_PRE_COMPILE")) != 0)
@@ -1051,7 +1333,9 @@ DatabasePager::DatabasePager()
     resetStats();
 
     _fileRequestQueue = new ReadQueue(this,"fileRequestQueue");
+    _archiveRequestQueue = new ReadQueue(this,"archiveRequestQueue");
     _httpRequestQueue = new ReadQueue(this,"httpRequestQueue");
+    _fileRequestQueue->shareBlock(_archiveRequestQueue.get());
 
     _dataToCompileList = new RequestQueue(this);
     _dataToMergeList = new RequestQueue(this);
@@ -1119,11 +1403,15 @@ DatabasePager::DatabasePager(const DatabasePager& rhs)
     _deleteRemovedSubgraphsInDatabaseThread = rhs._deleteRemovedSubgraphsInDatabaseThread;
 
     _targetMaximumNumberOfPageLOD = rhs._targetMaximumNumberOfPageLOD;
+    _maximumNumberOfPagedLODsToVisitPerFrame = rhs._maximumNumberOfPagedLODsToVisitPerFrame;
+    _expiryTimeBudgetPerFrame = rhs._expiryTimeBudgetPerFrame;
 
     _doPreCompile = rhs._doPreCompile;
 
     _fileRequestQueue = new ReadQueue(this,"fileRequestQueue");
+    _archiveRequestQueue = new ReadQueue(this,"archiveRequestQueue");
     _httpRequestQueue = new ReadQueue(this,"httpRequestQueue");
+    _fileRequestQueue->shareBlock(_archiveRequestQueue.get());
 
     _dataToCompileList = new RequestQueue(this);
     _dataToMergeList = new RequestQueue(this);
@@ -1135,6 +1423,9 @@ DatabasePager::DatabasePager(const DatabasePager& rhs)
         _databaseThreads.push_back(new DatabaseThread(**dt_itr,this));
     }
 
+    _numArchiveThreads = rhs._numArchiveThreads;
+    _numHttpThreads = rhs._numHttpThreads;
+
     setProcessorAffinity(rhs.getProcessorAffinity());
 
     _activePagedLODList = rhs._activePagedLODList->clone();
@@ -1168,6 +1459,7 @@ DatabasePager::~DatabasePager()
 
     // destruct all the queues
     _fileRequestQueue = 0;
+    _archiveRequestQueue = 0;
     _httpRequestQueue = 0;
     _dataToCompileList = 0;
     _dataToMergeList = 0;
@@ -1207,13 +1499,30 @@ void DatabasePager::setProcessorAffinity(const OpenThreads::Affinity& affinity)
 }
 
 void DatabasePager::setUpThreads(unsigned int totalNumThreads, unsigned int numHttpThreads)
+{
+    setUpThreads(totalNumThreads, numHttpThreads, 0);
+}
+
+void DatabasePager::setUpThreads(unsigned int totalNumThreads, unsigned int numHttpThreads, unsigned int numArchiveThreads)
 {
     _databaseThreads.clear();
+    _numArchiveThreads = 0;
+    _numHttpThreads = 0;
+
+    if (totalNumThreads==0)
+    {
+        int numProcessors = OpenThreads::GetNumberOfProcessors();
+        totalNumThreads = numProcessors>2 ? static_cast<unsigned int>(numProcessors) : 2;
+    }
 
     unsigned int numGeneralThreads = numHttpThreads < totalNumThreads ?
         totalNumThreads - numHttpThreads :
         1;
 
+    // always leave at least one thread dedicated to local files.
+    if (numArchiveThreads>=numGeneralThreads) numArchiveThreads = numGeneralThreads-1;
+    numGeneralThreads -= numArchiveThreads;
+
     if (numHttpThreads==0)
     {
         for(unsigned int i=0; i<numGeneralThreads; ++i)
@@ -1233,6 +1542,11 @@ void DatabasePager::setUpThreads(unsigned int totalNumThreads, unsigned int numH
             addDatabaseThread(DatabaseThread::HANDLE_ONLY_HTTP, "HANDLE_ONLY_HTTP");
         }
     }
+
+    for(unsigned int i=0; i<numArchiveThreads; ++i)
+    {
+        addDatabaseThread(DatabaseThread::HANDLE_ONLY_ARCHIVE, "HANDLE_ONLY_ARCHIVE");
+    }
 }
 
 unsigned int DatabasePager::addDatabaseThread(DatabaseThread::Mode mode, const std::string& name)
@@ -1247,6 +1561,9 @@ unsigned int DatabasePager::addDatabaseThread(DatabaseThread::Mode mode, const s
 
     _databaseThreads.push_back(thread);
 
+    if (mode==DatabaseThread::HANDLE_ONLY_ARCHIVE) ++_numArchiveThreads;
+    else if (mode==DatabaseThread::HANDLE_ONLY_HTTP) ++_numHttpThreads;
+
     if (_startThreadCalled)
     {
         OSG_INFO<<"DatabasePager::startThread()"<<std::endl;
@@ -1293,6 +1610,7 @@ int DatabasePager::cancel()
 
     // release the queue blocks in case they are holding up thread cancellation.
     _fileRequestQueue->release();
+    _archiveRequestQueue->release();
     _httpRequestQueue->release();
 
     for(DatabaseThreadList::iterator dt_itr = _databaseThreads.begin();
@@ -1311,6 +1629,7 @@ int DatabasePager::cancel()
 void DatabasePager::clear()
 {
     _fileRequestQueue->clear();
+    _archiveRequestQueue->clear();
     _httpRequestQueue->clear();
 
     _dataToCompileList->clear();
@@ -1332,6 +1651,39 @@ void DatabasePager::resetStats()
     _numTilesMerges = 0;
 }
 
+void DatabasePager::reportStats(unsigned int frameNumber, osg::Stats& stats, const std::string& prefix)
+{
+    stats.setAttribute(frameNumber, prefix+"DatabasePager file requests", static_cast<double>(_fileRequestQueue->size()));
+    stats.setAttribute(frameNumber, prefix+"DatabasePager archive requests", static_cast<double>(_archiveRequestQueue->size()));
+    stats.setAttribute(frameNumber, prefix+"DatabasePager http requests", static_cast<double>(_httpRequestQueue->size()));
+
+    for(unsigned int i=0; i<_databaseThreads.size(); ++i)
+    {
+        std::ostringstream attributeName;
+        attributeName<<prefix<<"DatabasePager thread "<<i<<" utilisation";
+        stats.setAttribute(frameNumber, attributeName.str(), _databaseThreads[i]->getUtilisationAndReset());
+    }
+
+    stats.setAttribute(frameNumber, prefix+"DatabasePager PagedLOD visited", static_cast<double>(_lastExpiryPass._numVisited));
+    stats.setAttribute(frameNumber, prefix+"DatabasePager PagedLOD expired", static_cast<double>(_lastExpiryPass._numExpired));
+    stats.setAttribute(frameNumber, prefix+"DatabasePager PagedLOD skipped", static_cast<double>(_lastExpiryPass._numSkipped));
+    stats.setAttribute(frameNumber, prefix+"DatabasePager PagedLOD invalid", static_cast<double>(_lastExpiryPass._numInvalid));
+
+    // the FileCache is shared by all pagers so is reported without the prefix.
+    FileCache* fileCache = Registry::instance()->getFileCache();
+    if (fileCache) fileCache->reportStats(frameNumber, stats);
+}
+
+DatabasePager::ReadQueue* DatabasePager::getReadQueueForFile(const std::string& fileName)
+{
+    if (_numArchiveThreads==0 || containsServerAddress(fileName)) return _fileRequestQueue.get();
+
+    // match the archive detection used by Registry::read() so only reads that will open an archive are routed to the archive lane.
+    if (Registry::instance()->containsArchivePath(fileName)) return _archiveRequestQueue.get();
+
+    return _fileRequestQueue.get();
+}
+
 bool DatabasePager::getRequestsInProgress() const
 {
     if (getFileRequestListSize()>0) return true;
@@ -1415,6 +1767,7 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
     {
         DatabaseRequest* databaseRequest = dynamic_cast<DatabaseRequest*>(databaseRequestRef.get());
         bool requeue = false;
+        RequestQueue* requestQueue = 0;
         if (databaseRequest)
         {
             OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_dr_mutex);
@@ -1429,13 +1782,20 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
 
 
                 databaseRequest->_valid = true;
-                databaseRequest->_frameNumberLastRequest = frameNumber;
-                databaseRequest->_timestampLastRequest = timestamp;
-                databaseRequest->_priorityLastRequest = priority;
                 ++(databaseRequest->_numOfRequests);
 
                 foundEntry = true;
 
+                // the frame number and priority order the heap of the queue holding the request,
+                // so they may only be changed along with repositioning it under that queue's _requestMutex.
+                requestQueue = databaseRequest->_requestQueue;
+                if (!requestQueue)
+                {
+                    databaseRequest->_frameNumberLastRequest = frameNumber;
+                    databaseRequest->_timestampLastRequest = timestamp;
+                    databaseRequest->_priorityLastRequest = priority;
+                }
+
                 if (databaseRequestRef->referenceCount()==1)
                 {
                     OSG_INFO<<"DatabasePager::requestNodeFile("<<fileName<<") orphaned, resubmitting."<<std::endl;
@@ -1453,14 +1813,33 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
             }
         }
         if (requeue)
-            _fileRequestQueue->add(databaseRequest);
+        {
+            getReadQueueForFile(fileName)->add(databaseRequest);
+        }
+        else
+        {
+            // the request may have been taken from, or moved between, queues since requestQueue was read.
+            while(requestQueue && !requestQueue->updateLastRequest(databaseRequest, frameNumber, timestamp, priority))
+            {
+                OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_dr_mutex);
+                requestQueue = databaseRequest->_requestQueue;
+                if (!requestQueue)
+                {
+                    databaseRequest->_frameNumberLastRequest = frameNumber;
+                    databaseRequest->_timestampLastRequest = timestamp;
+                    databaseRequest->_priorityLastRequest = priority;
+                }
+            }
+        }
     }
 
     if (!foundEntry)
     {
         OSG_INFO<<"In DatabasePager::requestNodeFile("<<fileName<<")"<<std::endl;
 
-        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileRequestQueue->_requestMutex);
+        ReadQueue* requestQueue = getReadQueueForFile(fileName);
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(requestQueue->_requestMutex);
 
         if (!databaseRequestRef.valid() || databaseRequestRef->referenceCount()==1)
         {
@@ -1481,7 +1860,7 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
             databaseRequest->_loadOptions = loadOptions;
             databaseRequest->_objectCache = 0;
 
-            _fileRequestQueue->addNoLock(databaseRequest.get());
+            requestQueue->addNoLock(databaseRequest.get());
         }
     }
 
@@ -1497,7 +1876,8 @@ void DatabasePager::requestNodeFile(const std::string& fileName, osg::NodePath&
             {
                 setUpThreads(
                     osg::DisplaySettings::instance()->getNumOfDatabaseThreadsHint(),
-                    osg::DisplaySettings::instance()->getNumOfHttpDatabaseThreadsHint());
+                    osg::DisplaySettings::instance()->getNumOfHttpDatabaseThreadsHint(),
+                    osg::DisplaySettings::instance()->getNumOfArchiveDatabaseThreadsHint());
             }
 
             _startThreadCalled = true;
@@ -1549,6 +1929,10 @@ void DatabasePager::setDatabasePagerThreadPause(bool pause)
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_fileRequestQueue->_requestMutex);
         _fileRequestQueue->updateBlock();
     }
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_archiveRequestQueue->_requestMutex);
+        _archiveRequestQueue->updateBlock();
+    }
     {
         OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_httpRequestQueue->_requestMutex);
         _httpRequestQueue->updateBlock();
@@ -1746,12 +2130,22 @@ void DatabasePager::removeExpiredSubgraphs(const osg::FrameStamp& frameStamp)
     if (s_total_max_stage_a<time_a) s_total_max_stage_a = time_a;
 
 
+    _lastExpiryPass = ExpiryPass();
+
     if (numPagedLODs <= _targetMaximumNumberOfPageLOD)
     {
         // nothing to do
         return;
     }
 
+    // limit the work done each frame, the list resumes from where this pass stops on the next frame.
+    osg::Timer_t expiryEndTick = 0;
+    if (_expiryTimeBudgetPerFrame>0.0)
+    {
+        expiryEndTick = startTick + static_cast<osg::Timer_t>(_expiryTimeBudgetPerFrame*1e-6/osg::Timer::instance()->getSecondsPerTick());
+    }
+    ExpiryPass expiryPass(_maximumNumberOfPagedLODsToVisitPerFrame, expiryEndTick);
+
     int numToPrune = numPagedLODs - _targetMaximumNumberOfPageLOD;
 
     ObjectList childrenRemoved;
@@ -1765,11 +2159,13 @@ void DatabasePager::removeExpiredSubgraphs(const osg::FrameStamp& frameStamp)
     //OSG_NOTICE<<"numToPrune "<<numToPrune;
     if (numToPrune>0)
         _activePagedLODList->removeExpiredChildren(
-            numToPrune, expiryTime, expiryFrame, childrenRemoved, false);
+            numToPrune, expiryTime, expiryFrame, childrenRemoved, false, expiryPass);
     numToPrune = _activePagedLODList->size() - _targetMaximumNumberOfPageLOD;
     if (numToPrune>0)
         _activePagedLODList->removeExpiredChildren(
-            numToPrune, expiryTime, expiryFrame, childrenRemoved, true);
+            numToPrune, expiryTime, expiryFrame, childrenRemoved, true, expiryPass);
+
+    _lastExpiryPass = expiryPass;
 
     osg::Timer_t end_b_Tick = osg::Timer::instance()->tick();
     double time_b = osg::Timer::instance()->delta_m(end_a_Tick,end_b_Tick);
@@ -1848,3 +2244,213 @@ void DatabasePager::registerPagedLODs(osg::Node* subgraph, unsigned int frameNum
     FindPagedLODsVisitor fplv(*_activePagedLODList, frameNumber);
     subgraph->accept(fplv);
 }
+
+class DatabasePager::PrefetchVisitor : public osg::NodeVisitor
+{
+public:
+
+    struct EyeSample
+    {
+        EyeSample(const osg::Vec3d& eyePoint, float weight):
+            _eyePoint(eyePoint),
+            _weight(weight) {}
+
+        osg::Vec3d  _eyePoint;
+        float       _weight;
+    };
+
+    typedef std::vector<EyeSample> EyeSamples;
+
+    PrefetchVisitor(DatabasePager* pager, const osg::FrameStamp* framestamp, const EyeSamples& eyeSamples):
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        _pager(pager),
+        _framestamp(framestamp),
+        _frameNumber(framestamp ? framestamp->getFrameNumber() : static_cast<unsigned int>(pager->_frameNumber)),
+        _worldEyeSamples(eyeSamples),
+        _eyeSamples(eyeSamples)
+    {
+    }
+
+    META_NodeVisitor("osgDB","PrefetchVisitor")
+
+    virtual void apply(osg::Transform& transform)
+    {
+        EyeSamples parentEyeSamples(_eyeSamples);
+
+        osg::Matrix matrix;
+        transform.computeWorldToLocalMatrix(matrix, this);
+
+        const EyeSamples& eyeSamples = (transform.getReferenceFrame()==osg::Transform::RELATIVE_RF) ? parentEyeSamples : _worldEyeSamples;
+        for(unsigned int i=0; i<_eyeSamples.size(); ++i)
+        {
+            _eyeSamples[i]._eyePoint = eyeSamples[i]._eyePoint * matrix;
+        }
+
+        traverse(transform);
+
+        _eyeSamples.swap(parentEyeSamples);
+    }
+
+    virtual void apply(osg::Camera& camera)
+    {
+        // the predicted eye points are only known for the view of the parent, so an absolute Camera's subgraph is skipped.
+        if (camera.getReferenceFrame()!=osg::Transform::RELATIVE_RF) return;
+
+        if (camera.getTransformOrder()==osg::Camera::PRE_MULTIPLY)
+        {
+            // the view matrix is applied in the parent's local frame, just like the matrix of a MatrixTransform.
+            apply(static_cast<osg::Transform&>(camera));
+        }
+        else if (camera.getViewMatrix().getTrans().length2()==0.0)
+        {
+            // the view matrix is applied in eye space and doesn't move the eye point, which is all that is used here.
+            traverse(camera);
+        }
+
+        // otherwise the eye point is offset in eye space, which depends on the orientation of the predicted view,
+        // so the Camera's subgraph is skipped.
+    }
+
+    virtual void apply(osg::PagedLOD& plod)
+    {
+        // pixel size ranges require the predicted view's projection and viewport, which aren't known, so rather than
+        // prefetch every loaded child the PagedLOD is left to the cull traversal.
+        if (plod.getRangeMode()!=osg::LOD::DISTANCE_FROM_EYE_POINT) return;
+
+        const osg::LOD::RangeList& rangeList = plod.getRangeList();
+        unsigned int numChildren = plod.getNumChildren();
+
+        std::vector<bool> childRequired(numChildren, false);
+        bool needToLoadChild = false;
+        float priority = 0.0f;
+
+        for(EyeSamples::const_iterator itr = _eyeSamples.begin();
+            itr != _eyeSamples.end();
+            ++itr)
+        {
+            float required_range = (plod.getCenter()-itr->_eyePoint).length();
+            for(unsigned int i=0; i<rangeList.size(); ++i)
+            {
+                if (rangeList[i].first<=required_range && required_range<rangeList[i].second)
+                {
+                    if (i<numChildren)
+                    {
+                        childRequired[i] = true;
+                    }
+                    else if (numChildren<rangeList.size())
+                    {
+                        // same priority as PagedLOD::traverse() would give, scaled by the confidence in the sample.
+                        const osg::LOD::MinMaxPair& range = rangeList[numChildren];
+                        float samplePriority = range.second>range.first ? osg::clampBetween((range.second-required_range)/(range.second-range.first), 0.0f, 1.0f) : 1.0f;
+                        priority = osg::maximum(priority, samplePriority*itr->_weight);
+                        needToLoadChild = true;
+                    }
+                }
+            }
+        }
+
+        for(unsigned int i=0; i<numChildren; ++i)
+        {
+            if (childRequired[i]) plod.getChild(i)->accept(*this);
+        }
+
+        if (needToLoadChild &&
+            !plod.getDisableExternalChildrenPaging() &&
+            numChildren<plod.getNumFileNames() &&
+            !plod.getFileName(numChildren).empty())
+        {
+            requestNodeFile(plod.getDatabasePath()+plod.getFileName(numChildren), priority, plod.getDatabaseRequest(numChildren), plod.getDatabaseOptions());
+        }
+    }
+
+    virtual void apply(osg::ProxyNode& proxyNode)
+    {
+        if (proxyNode.getLoadingExternalReferenceMode()==osg::ProxyNode::NO_AUTOMATIC_LOADING ||
+            proxyNode.getNumFileNames()<=proxyNode.getNumChildren())
+        {
+            traverse(proxyNode);
+            return;
+        }
+
+        // ProxyNode has no ranges, so prefetch its children once a predicted eye point enters its bound.
+        const osg::BoundingSphere& bs = proxyNode.getBound();
+        float priority = 0.0f;
+        bool required = false;
+        for(EyeSamples::const_iterator itr = _eyeSamples.begin();
+            itr != _eyeSamples.end();
+            ++itr)
+        {
+            if (bs.contains(itr->_eyePoint))
+            {
+                priority = osg::maximum(priority, itr->_weight);
+                required = true;
+            }
+        }
+
+        if (!required) return;
+
+        for(unsigned int i=proxyNode.getNumChildren(); i<proxyNode.getNumFileNames(); ++i)
+        {
+            requestNodeFile(proxyNode.getDatabasePath()+proxyNode.getFileName(i), priority, proxyNode.getDatabaseRequest(i), proxyNode.getDatabaseOptions());
+        }
+    }
+
+    void requestNodeFile(const std::string& fileName, float priority, osg::ref_ptr<osg::Referenced>& databaseRequestRef, const osg::Referenced* options)
+    {
+        // don't demote a request that the cull traversal has already made this frame.
+        DatabasePager::DatabaseRequest* databaseRequest = dynamic_cast<DatabasePager::DatabaseRequest*>(databaseRequestRef.get());
+        if (databaseRequest)
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> drLock(_pager->_dr_mutex);
+            if (databaseRequest->valid() && databaseRequest->_frameNumberLastRequest==_frameNumber) return;
+        }
+
+        // offset the priority so prefetching always ranks behind the requests made by cull in the same frame.
+        _pager->requestNodeFile(fileName, getNodePath(), priority-1.0f, _framestamp, databaseRequestRef, options);
+    }
+
+    DatabasePager*          _pager;
+    const osg::FrameStamp*  _framestamp;
+    unsigned int            _frameNumber;
+    EyeSamples              _worldEyeSamples;
+    EyeSamples              _eyeSamples;
+
+protected:
+
+    PrefetchVisitor& operator = (const PrefetchVisitor&) { return *this; }
+};
+
+void DatabasePager::prefetch(osg::Node* subgraph, const osg::Vec3d& predictedEyePoint, const osg::FrameStamp* framestamp)
+{
+    if (!subgraph || !_acceptNewRequests) return;
+
+    PrefetchVisitor::EyeSamples eyeSamples;
+    eyeSamples.push_back(PrefetchVisitor::EyeSample(predictedEyePoint, 1.0f));
+
+    PrefetchVisitor pv(this, framestamp, eyeSamples);
+    subgraph->accept(pv);
+}
+
+void DatabasePager::prefetch(osg::Node* subgraph, const osg::AnimationPath* animationPath, double time, double lookAheadTime,
+                             const osg::FrameStamp* framestamp, unsigned int numSamples)
+{
+    if (!subgraph || !animationPath || numSamples==0 || !_acceptNewRequests) return;
+
+    PrefetchVisitor::EyeSamples eyeSamples;
+    for(unsigned int i=1; i<=numSamples; ++i)
+    {
+        double ratio = static_cast<double>(i)/static_cast<double>(numSamples);
+
+        osg::AnimationPath::ControlPoint cp;
+        if (animationPath->getInterpolatedControlPoint(time+lookAheadTime*ratio, cp))
+        {
+            // the further along the path the less certain the prediction, so the lower the priority.
+            eyeSamples.push_back(PrefetchVisitor::EyeSample(cp.getPosition(), 1.0f-0.5f*static_cast<float>(ratio)));
+        }
+    }
+
+    if (eyeSamples.empty()) return;
+
+    PrefetchVisitor pv(this, framestamp, eyeSamples);
+    subgraph->accept(pv);
+}
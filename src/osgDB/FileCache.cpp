@@ -16,23 +16,121 @@
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
+#include <osgDB/fstream>
+
+#include <osg/Timer>
+
+#include <OpenThreads/ScopedLock>
+
+#include <algorithm>
+#include <sstream>
+#include <stdio.h>
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
 
 using namespace osgDB;
 
+namespace FileCacheUtils
+{
+
+// the index is rewritten after this many files have been added to the cache.
+const unsigned int NUM_WRITES_BETWEEN_INDEX_SAVES = 32;
+
+// FNV-1a hash of the file contents, also returning the file size.
+bool hashFile(const std::string& fileName, unsigned int& hash, unsigned long long& size)
+{
+    osgDB::ifstream fin(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!fin) return false;
+
+    hash = 2166136261u;
+    size = 0;
+
+    char buffer[16384];
+    while (fin)
+    {
+        fin.read(buffer, sizeof(buffer));
+        std::streamsize numRead = fin.gcount();
+        for(std::streamsize i=0; i<numRead; ++i)
+        {
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 16777619u;
+        }
+        size += numRead;
+    }
+    return true;
+}
+
+// replace the destination file, atomically where the platform supports it.
+bool replaceFile(const std::string& from, const std::string& to)
+{
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING)!=0;
+#else
+    return ::rename(from.c_str(), to.c_str())==0;
+#endif
+}
+
+// remove a temporary directory along with anything left in it.
+void removeDirectory(const std::string& directory)
+{
+    osgDB::DirectoryContents contents = osgDB::getDirectoryContents(directory);
+    for(osgDB::DirectoryContents::iterator itr = contents.begin();
+        itr != contents.end();
+        ++itr)
+    {
+        if (*itr=="." || *itr=="..") continue;
+
+        std::string fileName = directory + "/" + (*itr);
+        if (osgDB::fileType(fileName)==osgDB::DIRECTORY) removeDirectory(fileName);
+        else ::remove(fileName.c_str());
+    }
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    RemoveDirectoryA(directory.c_str());
+#else
+    ::rmdir(directory.c_str());
+#endif
+}
+
+struct LessRecentlyUsed
+{
+    typedef std::pair<unsigned long long, std::string> AccessFileNamePair;
+    bool operator() (const AccessFileNamePair& lhs, const AccessFileNamePair& rhs) const { return lhs.first<rhs.first; }
+};
+
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 // FileCache
 //
 FileCache::FileCache(const std::string& path):
     osg::Referenced(true),
-    _fileCachePath(path)
+    _fileCachePath(path),
+    _cacheSize(0),
+    _accessCounter(0),
+    _numWritesSinceIndexSaved(0),
+    _temporaryFileCounter(0),
+    _maximumCacheSize(0),
+    _verifyContentHash(false)
 {
     OSG_INFO<<"Constructed FileCache : "<<path<<std::endl;
+
+    readIndex();
 }
 
 FileCache::~FileCache()
 {
     OSG_INFO<<"Destructed FileCache "<<std::endl;
+
+    if (_numWritesSinceIndexSaved>0) writeIndex();
 }
 
 bool FileCache::isFileAppropriateForFileCache(const std::string& originalFileName) const
@@ -54,20 +152,20 @@ std::string FileCache::createCacheFileName(const std::string& originalFileName)
 
 bool FileCache::existsInCache(const std::string& originalFileName) const
 {
-    if (osgDB::fileExists(createCacheFileName(originalFileName)))
-    {
-        return !isCachedFileBlackListed(originalFileName);
-    }
-    return false;
+    if (isCachedFileBlackListed(originalFileName)) return false;
+
+    return validateCachedFile(createCacheFileName(originalFileName), originalFileName);
 }
 
 ReaderWriter::ReadResult FileCache::readObject(const std::string& originalFileName, const osgDB::Options* options) const
 {
     std::string cacheFileName = createCacheFileName(originalFileName);
-    if (!cacheFileName.empty() && osgDB::fileExists(cacheFileName))
+    if (!cacheFileName.empty() && validateCachedFile(cacheFileName, originalFileName))
     {
         OSG_INFO<<"FileCache::readObjectFromCache("<<originalFileName<<") as "<<cacheFileName<<std::endl;
-        return osgDB::Registry::instance()->readObject(cacheFileName, options);
+        ReaderWriter::ReadResult result = osgDB::Registry::instance()->readObject(cacheFileName, options);
+        recordRead(cacheFileName, result.success());
+        return result;
     }
     else
     {
@@ -89,11 +187,20 @@ ReaderWriter::WriteResult FileCache::writeObject(const osg::Object& object, cons
         }
 
         OSG_INFO<<"FileCache::writeObjectToCache("<<originalFileName<<") as "<<cacheFileName<<std::endl;
-        ReaderWriter::WriteResult result = osgDB::Registry::instance()->writeObject(object, cacheFileName, options);
+        // write to a temporary directory first so that concurrent readers never see a partially written file.
+        std::string temporaryDirectory = createTemporaryDirectory(cacheFileName);
+        if (temporaryDirectory.empty()) return ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE;
+
+        ReaderWriter::WriteResult result = osgDB::Registry::instance()->writeObject(object, getTemporaryFileName(temporaryDirectory, cacheFileName), options);
         if (result.success())
         {
+            if (!commitToCache(temporaryDirectory, cacheFileName, originalFileName)) return ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE;
             removeFileFromBlackListed(originalFileName);
         }
+        else
+        {
+            FileCacheUtils::removeDirectory(temporaryDirectory);
+        }
         return result;
     }
     return ReaderWriter::WriteResult::FILE_NOT_HANDLED;
@@ -102,10 +209,12 @@ ReaderWriter::WriteResult FileCache::writeObject(const osg::Object& object, cons
 ReaderWriter::ReadResult FileCache::readImage(const std::string& originalFileName, const osgDB::Options* options) const
 {
     std::string cacheFileName = createCacheFileName(originalFileName);
-    if (!cacheFileName.empty() && osgDB::fileExists(cacheFileName))
+    if (!cacheFileName.empty() && validateCachedFile(cacheFileName, originalFileName))
     {
         OSG_INFO<<"FileCache::readImageFromCache("<<originalFileName<<") as "<<cacheFileName<<std::endl;
-        return osgDB::Registry::instance()->readImage(cacheFileName, options);
+        ReaderWriter::ReadResult result = osgDB::Registry::instance()->readImage(cacheFileName, options);
+        recordRead(cacheFileName, result.success());
+        return result;
     }
     else
     {
@@ -127,11 +236,20 @@ ReaderWriter::WriteResult FileCache::writeImage(const osg::Image& image, const s
         }
 
         OSG_INFO<<"FileCache::writeImageToCache("<<originalFileName<<") as "<<cacheFileName<<std::endl;
-        ReaderWriter::WriteResult result = osgDB::Registry::instance()->writeImage(image, cacheFileName, options);
+        // write to a temporary directory first so that concurrent readers never see a partially written file.
+        std::string temporaryDirectory = createTemporaryDirectory(cacheFileName);
+        if (temporaryDirectory.empty()) return ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE;
+
+        ReaderWriter::WriteResult result = osgDB::Registry::instance()->writeImage(image, getTemporaryFileName(temporaryDirectory, cacheFileName), options);
         if (result.success())
         {
+            if (!commitToCache(temporaryDirectory, cacheFileName, originalFileName)) return ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE;
             removeFileFromBlackListed(originalFileName);
         }
+        else
+        {
+            FileCacheUtils::removeDirectory(temporaryDirectory);
+        }
         return result;
     }
     return ReaderWriter::WriteResult::FILE_NOT_HANDLED;
@@ -140,10 +258,12 @@ ReaderWriter::WriteResult FileCache::writeImage(const osg::Image& image, const s
 ReaderWriter::ReadResult FileCache::readHeightField(const std::string& originalFileName, const osgDB::Options* options) const
 {
     std::string cacheFileName = createCacheFileName(originalFileName);
-    if (!cacheFileName.empty() && osgDB::fileExists(cacheFileName))
+    if (!cacheFileName.empty() && validateCachedFile(cacheFileName, originalFileName))
     {
         OSG_INFO<<"FileCache::readHeightFieldFromCache("<<originalFileName<<") as "<<cacheFileName<<std::endl;
-        return osgDB::Registry::instance()->readHeightField(cacheFileName, options);
+        ReaderWriter::ReadResult result = osgDB::Registry::instance()->readHeightField(cacheFileName, options);
+        recordRead(cacheFileName, result.success());
+        return result;
     }
     else
     {
@@ -165,11 +285,20 @@ ReaderWriter::WriteResult FileCache::writeHeightField(const osg::HeightField& hf
         }
 
         OSG_INFO<<"FileCache::writeHeightFieldToCache("<<originalFileName<<") as "<<cacheFileName<<std::endl;
-        ReaderWriter::WriteResult result = osgDB::Registry::instance()->writeHeightField(hf, cacheFileName, options);
+        // write to a temporary directory first so that concurrent readers never see a partially written file.
+        std::string temporaryDirectory = createTemporaryDirectory(cacheFileName);
+        if (temporaryDirectory.empty()) return ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE;
+
+        ReaderWriter::WriteResult result = osgDB::Registry::instance()->writeHeightField(hf, getTemporaryFileName(temporaryDirectory, cacheFileName), options);
         if (result.success())
         {
+            if (!commitToCache(temporaryDirectory, cacheFileName, originalFileName)) return ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE;
             removeFileFromBlackListed(originalFileName);
         }
+        else
+        {
+            FileCacheUtils::removeDirectory(temporaryDirectory);
+        }
         return result;
     }
     return ReaderWriter::WriteResult::FILE_NOT_HANDLED;
@@ -178,10 +307,12 @@ ReaderWriter::WriteResult FileCache::writeHeightField(const osg::HeightField& hf
 ReaderWriter::ReadResult FileCache::readNode(const std::string& originalFileName, const osgDB::Options* options, bool buildKdTreeIfRequired) const
 {
     std::string cacheFileName = createCacheFileName(originalFileName);
-    if (!cacheFileName.empty() && osgDB::fileExists(cacheFileName))
+    if (!cacheFileName.empty() && validateCachedFile(cacheFileName, originalFileName))
     {
         OSG_INFO<<"FileCache::readNodeFromCache("<<originalFileName<<") as "<<cacheFileName<<std::endl;
-        return osgDB::Registry::instance()->readNode(cacheFileName, options, buildKdTreeIfRequired);
+        ReaderWriter::ReadResult result = osgDB::Registry::instance()->readNode(cacheFileName, options, buildKdTreeIfRequired);
+        recordRead(cacheFileName, result.success());
+        return result;
     }
     else
     {
@@ -203,11 +334,20 @@ ReaderWriter::WriteResult FileCache::writeNode(const osg::Node& node, const std:
         }
 
         OSG_INFO<<"FileCache::writeNodeToCache("<<originalFileName<<") as "<<cacheFileName<<std::endl;
-        ReaderWriter::WriteResult result = osgDB::Registry::instance()->writeNode(node, cacheFileName, options);
+        // write to a temporary directory first so that concurrent readers never see a partially written file.
+        std::string temporaryDirectory = createTemporaryDirectory(cacheFileName);
+        if (temporaryDirectory.empty()) return ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE;
+
+        ReaderWriter::WriteResult result = osgDB::Registry::instance()->writeNode(node, getTemporaryFileName(temporaryDirectory, cacheFileName), options);
         if (result.success())
         {
+            if (!commitToCache(temporaryDirectory, cacheFileName, originalFileName)) return ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE;
             removeFileFromBlackListed(originalFileName);
         }
+        else
+        {
+            FileCacheUtils::removeDirectory(temporaryDirectory);
+        }
         return result;
     }
     return ReaderWriter::WriteResult::FILE_NOT_HANDLED;
@@ -217,10 +357,12 @@ ReaderWriter::WriteResult FileCache::writeNode(const osg::Node& node, const std:
 ReaderWriter::ReadResult FileCache::readShader(const std::string& originalFileName, const osgDB::Options* options) const
 {
     std::string cacheFileName = createCacheFileName(originalFileName);
-    if (!cacheFileName.empty() && osgDB::fileExists(cacheFileName))
+    if (!cacheFileName.empty() && validateCachedFile(cacheFileName, originalFileName))
     {
         OSG_INFO<<"FileCache::readShaderFromCache("<<originalFileName<<") as "<<cacheFileName<<std::endl;
-        return osgDB::Registry::instance()->readShader(cacheFileName, options);
+        ReaderWriter::ReadResult result = osgDB::Registry::instance()->readShader(cacheFileName, options);
+        recordRead(cacheFileName, result.success());
+        return result;
     }
     else
     {
@@ -242,17 +384,439 @@ ReaderWriter::WriteResult FileCache::writeShader(const osg::Shader& shader, cons
         }
 
         OSG_INFO<<"FileCache::writeShaderToCache("<<originalFileName<<") as "<<cacheFileName<<std::endl;
-        ReaderWriter::WriteResult result = osgDB::Registry::instance()->writeShader(shader, cacheFileName, options);
+        // write to a temporary directory first so that concurrent readers never see a partially written file.
+        std::string temporaryDirectory = createTemporaryDirectory(cacheFileName);
+        if (temporaryDirectory.empty()) return ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE;
+
+        ReaderWriter::WriteResult result = osgDB::Registry::instance()->writeShader(shader, getTemporaryFileName(temporaryDirectory, cacheFileName), options);
         if (result.success())
         {
+            if (!commitToCache(temporaryDirectory, cacheFileName, originalFileName)) return ReaderWriter::WriteResult::ERROR_IN_WRITING_FILE;
             removeFileFromBlackListed(originalFileName);
         }
+        else
+        {
+            FileCacheUtils::removeDirectory(temporaryDirectory);
+        }
         return result;
     }
     return ReaderWriter::WriteResult::FILE_NOT_HANDLED;
 }
 
 
+void FileCache::setMaximumCacheSize(unsigned long long bytes)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+    _maximumCacheSize = bytes;
+    if (_maximumCacheSize>0 && _cacheSize>_maximumCacheSize) pruneCacheNoLock(_maximumCacheSize, std::string());
+}
+
+unsigned long long FileCache::getCacheSize() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+    return _cacheSize;
+}
+
+FileCache::Statistics FileCache::getStatistics() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+    return _statistics;
+}
+
+void FileCache::resetStatistics()
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+    _statistics = Statistics();
+}
+
+void FileCache::reportStats(unsigned int frameNumber, osg::Stats& stats) const
+{
+    Statistics statistics = getStatistics();
+    unsigned int numLookups = statistics._numHits + statistics._numMisses;
+
+    stats.setAttribute(frameNumber, "FileCache hits", static_cast<double>(statistics._numHits));
+    stats.setAttribute(frameNumber, "FileCache misses", static_cast<double>(statistics._numMisses));
+    stats.setAttribute(frameNumber, "FileCache hit rate", numLookups>0 ? static_cast<double>(statistics._numHits)/static_cast<double>(numLookups) : 0.0);
+    stats.setAttribute(frameNumber, "FileCache stale", static_cast<double>(statistics._numStale));
+    stats.setAttribute(frameNumber, "FileCache evictions", static_cast<double>(statistics._numEvictions));
+    stats.setAttribute(frameNumber, "FileCache bytes saved", static_cast<double>(statistics._bytesRead));
+    stats.setAttribute(frameNumber, "FileCache size", static_cast<double>(getCacheSize()));
+}
+
+void FileCache::readIndex()
+{
+    osgDB::ifstream fin(getIndexFileName().c_str());
+    if (!fin) return;
+
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        if (line.empty() || line[0]=='#') continue;
+
+        // <last access> <size> <hash> <revision> <file name relative to the cache path>
+        std::istringstream iss(line);
+        IndexEntry entry;
+        iss >> entry._lastAccess >> entry._size >> std::hex >> entry._hash >> std::dec >> entry._revision;
+        if (iss.fail()) continue;
+        if (entry._revision=="-") entry._revision.clear();
+
+        std::string relativeFileName;
+        iss.get();
+        std::getline(iss, relativeFileName);
+        if (relativeFileName.empty()) continue;
+
+        std::string cacheFileName = _fileCachePath + "/" + relativeFileName;
+        _cacheSize += entry._size;
+        _accessCounter = osg::maximum(_accessCounter, entry._lastAccess);
+        _index[cacheFileName] = entry;
+    }
+
+    OSG_INFO<<"FileCache::readIndex() read "<<_index.size()<<" entries, "<<_cacheSize<<" bytes"<<std::endl;
+}
+
+bool FileCache::writeIndex() const
+{
+    std::ostringstream sstream;
+    sstream<<"# OpenSceneGraph FileCache index"<<std::endl;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+        std::string prefix = _fileCachePath + "/";
+        for(Index::const_iterator itr = _index.begin(); itr != _index.end(); ++itr)
+        {
+            if (itr->first.compare(0, prefix.length(), prefix)!=0) continue;
+
+            sstream<<itr->second._lastAccess<<" "<<itr->second._size<<" "
+                   <<std::hex<<itr->second._hash<<std::dec<<" "
+                   <<(itr->second._revision.empty() ? std::string("-") : itr->second._revision)<<" "
+                   <<itr->first.substr(prefix.length())<<std::endl;
+        }
+        _numWritesSinceIndexSaved = 0;
+    }
+
+    if (!osgDB::fileExists(_fileCachePath) && !osgDB::makeDirectory(_fileCachePath)) return false;
+
+    std::string indexFileName = getIndexFileName();
+    std::string temporaryFileName = createTemporaryFileName(indexFileName);
+    {
+        osgDB::ofstream fout(temporaryFileName.c_str());
+        if (!fout) return false;
+        fout<<sstream.str();
+        if (fout.fail()) return false;
+    }
+
+    if (!FileCacheUtils::replaceFile(temporaryFileName, indexFileName))
+    {
+        ::remove(temporaryFileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string FileCache::getRevisionForFile(const std::string& originalFileName) const
+{
+    for(DatabaseRevisionsList::const_iterator dr_itr = _databaseRevisionsList.begin();
+        dr_itr != _databaseRevisionsList.end();
+        ++dr_itr)
+    {
+        const DatabaseRevisions* dr = dr_itr->get();
+        if (dr->getDatabasePath().length()>=originalFileName.length()) continue;
+        if (originalFileName.compare(0,dr->getDatabasePath().length(), dr->getDatabasePath())!=0) continue;
+        if (dr->getDatabaseRevisionList().empty()) continue;
+
+        return dr->getDatabaseRevisionList().back()->getName();
+    }
+    return std::string();
+}
+
+bool FileCache::isRevisionCurrent(const std::string& originalFileName, const std::string& revision) const
+{
+    for(DatabaseRevisionsList::const_iterator dr_itr = _databaseRevisionsList.begin();
+        dr_itr != _databaseRevisionsList.end();
+        ++dr_itr)
+    {
+        const DatabaseRevisions* dr = dr_itr->get();
+        if (dr->getDatabasePath().length()>=originalFileName.length()) continue;
+        if (originalFileName.compare(0,dr->getDatabasePath().length(), dr->getDatabasePath())!=0) continue;
+
+        std::string localPath(originalFileName,
+                            dr->getDatabasePath().empty() ? 0 : dr->getDatabasePath().length()+1,
+                            std::string::npos);
+
+        // the file is stale if any revision after the one it was cached at touches it.
+        const DatabaseRevisions::DatabaseRevisionList& revisions = dr->getDatabaseRevisionList();
+        DatabaseRevisions::DatabaseRevisionList::const_iterator itr = revisions.begin();
+        if (!revision.empty())
+        {
+            for(; itr != revisions.end() && (*itr)->getName()!=revision; ++itr) {}
+            if (itr != revisions.end()) ++itr;
+            else itr = revisions.begin();
+        }
+
+        for(; itr != revisions.end(); ++itr)
+        {
+            const DatabaseRevision* dbr = itr->get();
+            if (dbr->getFilesAdded() && dbr->getFilesAdded()->containsFile(localPath)) return false;
+            if (dbr->getFilesRemoved() && dbr->getFilesRemoved()->containsFile(localPath)) return false;
+            if (dbr->getFilesModified() && dbr->getFilesModified()->containsFile(localPath)) return false;
+        }
+    }
+    return true;
+}
+
+bool FileCache::validateCachedFile(const std::string& cacheFileName, const std::string& originalFileName) const
+{
+    if (cacheFileName.empty()) return false;
+
+    std::string revision = getRevisionForFile(originalFileName);
+
+    // the file is checked and hashed without _indexMutex held so other threads aren't blocked while it is read,
+    // the result only being applied if no other thread has changed the file's entry in the mean time.
+    for(;;)
+    {
+        IndexEntry entry;
+        bool indexed = false;
+        {
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+            Index::const_iterator itr = _index.find(cacheFileName);
+            if (itr!=_index.end())
+            {
+                entry = itr->second;
+                indexed = true;
+            }
+        }
+
+        bool exists = osgDB::fileExists(cacheFileName);
+        bool stale = false;
+        bool verified = false;
+        if (!indexed)
+        {
+            // adopt files written before the index existed, or by a process without one.
+            verified = exists && FileCacheUtils::hashFile(cacheFileName, entry._hash, entry._size);
+        }
+        else if (exists)
+        {
+            if (entry._revision!=revision && !isRevisionCurrent(originalFileName, entry._revision)) stale = true;
+
+            if (!stale && _verifyContentHash && !entry._verified)
+            {
+                unsigned int hash = 0;
+                unsigned long long size = 0;
+                stale = !FileCacheUtils::hashFile(cacheFileName, hash, size) || hash!=entry._hash || size!=entry._size;
+                verified = !stale;
+            }
+        }
+
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+
+        Index::iterator itr = _index.find(cacheFileName);
+        if (indexed ? (itr==_index.end() || !itr->second.sameFile(entry)) : itr!=_index.end())
+        {
+            // another thread has written, removed or validated the file, so check it again.
+            continue;
+        }
+
+        if (!indexed)
+        {
+            if (!verified)
+            {
+                ++_statistics._numMisses;
+                return false;
+            }
+
+            entry._revision = revision;
+            entry._verified = true;
+            itr = _index.insert(Index::value_type(cacheFileName, entry)).first;
+            _cacheSize += entry._size;
+            ++_numWritesSinceIndexSaved;
+        }
+        else if (!exists)
+        {
+            _cacheSize -= osg::minimum(_cacheSize, itr->second._size);
+            _index.erase(itr);
+            ++_statistics._numMisses;
+            return false;
+        }
+        else if (stale)
+        {
+            OSG_INFO<<"FileCache::validateCachedFile("<<originalFileName<<") removing stale "<<cacheFileName<<std::endl;
+            ::remove(cacheFileName.c_str());
+            _cacheSize -= osg::minimum(_cacheSize, itr->second._size);
+            _index.erase(itr);
+            ++_statistics._numStale;
+            ++_statistics._numMisses;
+            ++_numWritesSinceIndexSaved;
+            return false;
+        }
+        else
+        {
+            itr->second._revision = revision;
+            if (verified) itr->second._verified = true;
+        }
+
+        itr->second._lastAccess = ++_accessCounter;
+        return true;
+    }
+}
+
+void FileCache::recordRead(const std::string& cacheFileName, bool success) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+
+    Index::iterator itr = _index.find(cacheFileName);
+    if (success)
+    {
+        ++_statistics._numHits;
+        if (itr!=_index.end()) _statistics._bytesRead += itr->second._size;
+    }
+    else
+    {
+        // a cached file that can't be read is no use, remove it so it is fetched again.
+        ++_statistics._numMisses;
+        if (itr!=_index.end())
+        {
+            ::remove(cacheFileName.c_str());
+            _cacheSize -= osg::minimum(_cacheSize, itr->second._size);
+            _index.erase(itr);
+            ++_statistics._numStale;
+            ++_numWritesSinceIndexSaved;
+        }
+    }
+}
+
+std::string FileCache::createTemporaryFileName(const std::string& cacheFileName) const
+{
+    unsigned int counter;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+        counter = ++_temporaryFileCounter;
+    }
+
+    // keep the extension so that the same plugin is used to write the temporary file.
+    std::ostringstream sstream;
+    sstream<<osgDB::getNameLessExtension(cacheFileName)<<"."<<osg::Timer::instance()->tick()<<"_"<<counter<<".tmp";
+    std::string extension = osgDB::getFileExtensionIncludingDot(cacheFileName);
+    return sstream.str() + extension;
+}
+
+std::string FileCache::createTemporaryDirectory(const std::string& cacheFileName) const
+{
+    // the directory name isn't a valid cache file name, so it can't clash with the files being cached.
+    std::string temporaryDirectory = createTemporaryFileName(cacheFileName) + ".dir";
+    if (!osgDB::makeDirectory(temporaryDirectory))
+    {
+        OSG_NOTICE<<"FileCache: could not create temporary directory "<<temporaryDirectory<<std::endl;
+        return std::string();
+    }
+    return temporaryDirectory;
+}
+
+std::string FileCache::getTemporaryFileName(const std::string& temporaryDirectory, const std::string& cacheFileName) const
+{
+    // the file keeps its own name so plugins that embed it, or name the files written alongside it after it, work as normal.
+    return temporaryDirectory + "/" + osgDB::getSimpleFileName(cacheFileName);
+}
+
+bool FileCache::commitToCache(const std::string& temporaryDirectory, const std::string& cacheFileName, const std::string& originalFileName) const
+{
+    std::string temporaryFileName = getTemporaryFileName(temporaryDirectory, cacheFileName);
+    std::string path = osgDB::getFilePath(cacheFileName);
+
+    IndexEntry entry;
+    bool moved = FileCacheUtils::hashFile(temporaryFileName, entry._hash, entry._size);
+
+    // move any files written alongside the cached file first, such as the .mtl of an .obj, so they are
+    // in place by the time the cached file itself appears.
+    osgDB::DirectoryContents contents = osgDB::getDirectoryContents(temporaryDirectory);
+    for(osgDB::DirectoryContents::iterator itr = contents.begin();
+        itr != contents.end() && moved;
+        ++itr)
+    {
+        if (*itr=="." || *itr==".." || temporaryDirectory+"/"+(*itr)==temporaryFileName) continue;
+
+        moved = FileCacheUtils::replaceFile(temporaryDirectory+"/"+(*itr), path+"/"+(*itr));
+    }
+
+    if (!moved || !FileCacheUtils::replaceFile(temporaryFileName, cacheFileName))
+    {
+        OSG_NOTICE<<"FileCache: could not move "<<temporaryFileName<<" into the cache as "<<cacheFileName<<std::endl;
+        FileCacheUtils::removeDirectory(temporaryDirectory);
+        return false;
+    }
+
+    FileCacheUtils::removeDirectory(temporaryDirectory);
+
+    entry._revision = getRevisionForFile(originalFileName);
+    entry._verified = true;
+
+    bool saveIndex = false;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+
+        Index::iterator itr = _index.find(cacheFileName);
+        if (itr!=_index.end()) _cacheSize -= osg::minimum(_cacheSize, itr->second._size);
+
+        entry._lastAccess = ++_accessCounter;
+        _index[cacheFileName] = entry;
+        _cacheSize += entry._size;
+
+        ++_statistics._numWrites;
+        _statistics._bytesWritten += entry._size;
+
+        if (_maximumCacheSize>0 && _cacheSize>_maximumCacheSize) pruneCacheNoLock(_maximumCacheSize, cacheFileName);
+
+        saveIndex = (++_numWritesSinceIndexSaved >= FileCacheUtils::NUM_WRITES_BETWEEN_INDEX_SAVES);
+    }
+
+    if (saveIndex) writeIndex();
+
+    return true;
+}
+
+void FileCache::pruneCache(unsigned long long targetSize)
+{
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_indexMutex);
+        pruneCacheNoLock(targetSize, std::string());
+    }
+    writeIndex();
+}
+
+void FileCache::pruneCacheNoLock(unsigned long long targetSize, const std::string& keepFileName) const
+{
+    if (_cacheSize<=targetSize) return;
+
+    // prune a little below the target so that pruning isn't required on every subsequent write.
+    unsigned long long pruneToSize = targetSize - targetSize/10;
+
+    std::vector<FileCacheUtils::LessRecentlyUsed::AccessFileNamePair> entries;
+    entries.reserve(_index.size());
+    for(Index::const_iterator itr = _index.begin(); itr != _index.end(); ++itr)
+    {
+        entries.push_back(FileCacheUtils::LessRecentlyUsed::AccessFileNamePair(itr->second._lastAccess, itr->first));
+    }
+    std::sort(entries.begin(), entries.end(), FileCacheUtils::LessRecentlyUsed());
+
+    for(std::vector<FileCacheUtils::LessRecentlyUsed::AccessFileNamePair>::iterator eitr = entries.begin();
+        eitr != entries.end() && _cacheSize>pruneToSize;
+        ++eitr)
+    {
+        if (eitr->second==keepFileName) continue;
+
+        Index::iterator itr = _index.find(eitr->second);
+        OSG_DEBUG<<"FileCache: evicting "<<itr->first<<std::endl;
+
+        ::remove(itr->first.c_str());
+        _cacheSize -= osg::minimum(_cacheSize, itr->second._size);
+        ++_statistics._numEvictions;
+        _statistics._bytesEvicted += itr->second._size;
+        _index.erase(itr);
+    }
+
+    ++_numWritesSinceIndexSaved;
+}
+
 bool FileCache::isCachedFileBlackListed(const std::string& originalFileName) const
 {
     for(DatabaseRevisionsList::const_iterator itr = _databaseRevisionsList.begin();
@@ -14,6 +14,10 @@
 
 #include <osg/Notify>
 #include <osg/ImageSequence>
+#include <osg/Group>
+#include <osg/OperationThread>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
 #include <osgDB/XmlParser>
@@ -26,7 +30,7 @@ using namespace osgDB;
 static std::string s_lastSchema;
 
 InputStream::InputStream( const osgDB::Options* options )
-    :   _fileVersion(0), _useSchemaData(false), _forceReadingImage(false), _dataDecompress(0)
+    :   _fileVersion(0), _useSchemaData(false), _readChunks(false), _forceReadingImage(false), _dataDecompress(0)
 {
     BEGIN_BRACKET.set( "{", +INDENT_VALUE );
     END_BRACKET.set( "}", -INDENT_VALUE );
@@ -879,6 +883,13 @@ osg::ref_ptr<osg::Image> InputStream::readImage(bool readFromExternal)
 
 osg::ref_ptr<osg::Object> InputStream::readObject( osg::Object* existingObj )
 {
+    if ( _readChunks )
+    {
+        // only the root object of the scene is chunked
+        _readChunks = false;
+        return readChunkedObject();
+    }
+
     std::string className;
     unsigned int id = 0;
     *this >> className;
@@ -990,6 +1001,7 @@ InputStream::ReadType InputStream::start( InputIterator* inIterator )
         unsigned int attributes; *this >> attributes;
         if ( attributes&0x4 ) inIterator->setSupportBinaryBrackets( true );
         if ( attributes&0x2 ) _useSchemaData = true;
+        if ( attributes&0x8 ) _readChunks = true;
 
         // Record custom domains
         if ( attributes&0x1 )
@@ -1067,6 +1079,239 @@ void InputStream::decompress()
 
 // PROTECTED METHODS
 
+namespace InputStreamUtils
+{
+
+struct ChunkResult
+{
+    std::vector<unsigned int> _indices;
+    std::vector< osg::ref_ptr<osg::Object> > _objects;
+    std::string _error;
+};
+
+// The chunks of one scene and their results, shared by the reading thread and the pool threads helping it
+class ChunkJob : public osg::Referenced
+{
+public:
+    ChunkJob( const InputIterator* prototype, const osgDB::Options* options ):
+        _prototype(prototype),
+        _options(options),
+        _numDecoded(0) {}
+
+    // Sets up the results once all the chunks have been added
+    void prepare()
+    {
+        _results.resize( _chunks.size() );
+        _numDecoded.setBlockCount( static_cast<unsigned int>(_chunks.size()) );
+        _numDecoded.reset();
+    }
+
+    // Decodes chunks, each with its own InputStream, until none are left
+    void decodeChunks()
+    {
+        unsigned int c;
+        while ( (c = (++_nextChunk)-1) < _chunks.size() )
+        {
+            decode( _chunks[c], _results[c] );
+            _numDecoded.completed();
+        }
+    }
+
+    // Waits until every chunk has been decoded, by whichever thread took it
+    void waitForChunks()
+    {
+        while ( _numDecoded.getCurrentCount()>0 ) _numDecoded.block();
+    }
+
+    std::vector<std::string>& getChunks() { return _chunks; }
+    std::vector<ChunkResult>& getResults() { return _results; }
+
+protected:
+
+    void decode( const std::string& chunk, ChunkResult& result )
+    {
+        std::istringstream iss( chunk );
+        osg::ref_ptr<InputIterator> ii = _prototype->cloneForStream( &iss );
+
+        InputStream is( _options.get() );
+        is.start( ii.get() );
+        is.decompress();
+
+        unsigned int numItems = 0;
+        if ( !is.getException() ) is >> numItems;
+        for ( unsigned int i=0; i<numItems && !is.getException(); ++i )
+        {
+            unsigned int index = 0; is >> index;
+            osg::ref_ptr<osg::Object> obj = is.readObject();
+            result._indices.push_back( index );
+            result._objects.push_back( obj );
+        }
+
+        if ( is.getException() )
+            result._error = is.getException()->getError() + " At " + is.getException()->getField();
+    }
+
+    osg::ref_ptr<const InputIterator>   _prototype;
+    osg::ref_ptr<const osgDB::Options>  _options;
+    std::vector<std::string>            _chunks;
+    std::vector<ChunkResult>            _results;
+    OpenThreads::Atomic                 _nextChunk;
+    OpenThreads::BlockCount             _numDecoded;
+};
+
+class ChunkDecodeOperation : public osg::Operation
+{
+public:
+    ChunkDecodeOperation( ChunkJob* job ) : osg::Operation("ChunkDecode", false), _job(job) {}
+
+    virtual void operator () ( osg::Object* ) { _job->decodeChunks(); }
+
+protected:
+    osg::ref_ptr<ChunkJob> _job;
+};
+
+// Threads shared by all chunked reads, started on first use and kept for the life of the application
+class ChunkDecoderPool
+{
+public:
+    static ChunkDecoderPool& instance()
+    {
+        static ChunkDecoderPool s_pool;
+        return s_pool;
+    }
+
+    unsigned int getNumThreads() const { return static_cast<unsigned int>(_threads.size()); }
+
+    void add( osg::Operation* operation ) { _operationQueue->add( operation ); }
+
+protected:
+    ChunkDecoderPool():
+        _operationQueue(new osg::OperationQueue)
+    {
+        // the reading thread decodes chunks too, so one thread fewer than there are processors
+        int numThreads = OpenThreads::GetNumberOfProcessors()-1;
+        for ( int t=0; t<numThreads; ++t )
+        {
+            osg::ref_ptr<osg::OperationThread> thread = new osg::OperationThread;
+            thread->setOperationQueue( _operationQueue.get() );
+            if ( thread->startThread()==0 ) _threads.push_back( thread );
+        }
+    }
+
+    osg::ref_ptr<osg::OperationQueue>                   _operationQueue;
+    std::vector< osg::ref_ptr<osg::OperationThread> >   _threads;
+};
+
+}
+
+osg::ref_ptr<osg::Object> InputStream::readChunkedObject()
+{
+    const unsigned int ROOT_INDEX = 0xffffffff;
+
+    _fields.push_back( "ChunkedObject" );
+
+    unsigned int numChunks = 0, numChildren = 0; *this >> numChunks >> numChildren;
+    if ( getException() ) return 0;
+
+    osg::ref_ptr<InputIterator> prototype = _in->cloneForStream( 0 );
+    if ( !prototype )
+    {
+        throwException( "InputStream: Input format doesn't support chunked scenes." );
+        return 0;
+    }
+
+    // chunks are added as they are read, so a corrupt count fails on the stream rather than allocating up front
+    osg::ref_ptr<InputStreamUtils::ChunkJob> job = new InputStreamUtils::ChunkJob( prototype.get(), _options.get() );
+    std::vector<std::string>& chunks = job->getChunks();
+    for ( unsigned int c=0; c<numChunks && !getException(); ++c )
+    {
+        unsigned int size = 0; *this >> size;
+        if ( getException() ) break;
+
+        chunks.push_back( std::string() );
+        if ( size>0 )
+        {
+            chunks.back().resize( size );
+            readCharArray( &chunks.back()[0], size );
+            checkStream();
+        }
+    }
+    if ( getException() ) return 0;
+
+    job->prepare();
+
+    // Decode on the shared pool threads and this thread, chunks are independent so need no synchronization beyond the
+    // chunk counter. Pool threads that get to the job after this thread has taken the last chunk have nothing to do.
+    InputStreamUtils::ChunkDecoderPool& pool = InputStreamUtils::ChunkDecoderPool::instance();
+    unsigned int numHelpers = numChunks>0 ? osg::minimum( numChunks-1, pool.getNumThreads() ) : 0;
+    for ( unsigned int t=0; t<numHelpers; ++t )
+    {
+        pool.add( new InputStreamUtils::ChunkDecodeOperation(job.get()) );
+    }
+
+    job->decodeChunks();
+    job->waitForChunks();
+
+    // Stitch the children back onto the root in their original order
+    std::vector<InputStreamUtils::ChunkResult>& results = job->getResults();
+    unsigned int numItems = 0;
+    for ( std::vector<InputStreamUtils::ChunkResult>::iterator ritr=results.begin(); ritr!=results.end(); ++ritr )
+    {
+        if ( !ritr->_error.empty() )
+        {
+            throwException( ritr->_error );
+            return 0;
+        }
+        numItems += static_cast<unsigned int>(ritr->_indices.size());
+    }
+
+    // every child is an item decoded from the chunks, so a larger count is corrupt
+    if ( numChildren>numItems )
+    {
+        throwException( "InputStream: Invalid number of chunked children." );
+        return 0;
+    }
+
+    osg::ref_ptr<osg::Object> root;
+    std::vector< osg::ref_ptr<osg::Node> > children( numChildren );
+    for ( std::vector<InputStreamUtils::ChunkResult>::iterator ritr=results.begin(); ritr!=results.end(); ++ritr )
+    {
+        for ( unsigned int i=0; i<ritr->_indices.size(); ++i )
+        {
+            unsigned int index = ritr->_indices[i];
+            if ( index==ROOT_INDEX )
+            {
+                root = ritr->_objects[i];
+            }
+            else if ( index<numChildren )
+            {
+                children[index] = dynamic_cast<osg::Node*>( ritr->_objects[i].get() );
+            }
+            else
+            {
+                throwException( "InputStream: Chunked child index out of range." );
+                return 0;
+            }
+        }
+    }
+
+    osg::Group* group = (root.valid() && root->asNode()) ? root->asNode()->asGroup() : 0;
+    if ( group )
+    {
+        for ( std::vector< osg::ref_ptr<osg::Node> >::iterator itr=children.begin(); itr!=children.end(); ++itr )
+        {
+            if ( itr->valid() ) group->addChild( itr->get() );
+        }
+    }
+    else if ( !children.empty() )
+    {
+        OSG_WARN << "InputStream::readChunkedObject(): Chunked children without a root group." << std::endl;
+    }
+
+    _fields.pop_back();
+    return root;
+}
+
 void InputStream::setWrapperSchema( const std::string& name, const std::string& properties )
 {
     ObjectWrapper* wrapper = Registry::instance()->getObjectWrapperManager()->findWrapper(name);
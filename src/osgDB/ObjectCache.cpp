@@ -12,9 +12,12 @@
 */
 
 #include <osg/Texture>
+#include <osg/Geometry>
 #include <osgDB/ObjectCache>
 #include <osgDB/Options>
 
+#include <set>
+
 using namespace osgDB;
 
 bool ObjectCache::ClassComp::operator() (const ObjectCache::FileNameOptionsPair& lhs, const ObjectCache::FileNameOptionsPair& rhs) const
@@ -42,7 +45,9 @@ bool ObjectCache::ClassComp::operator() (const ObjectCache::FileNameOptionsPair&
 // ObjectCache
 //
 ObjectCache::ObjectCache():
-    osg::Referenced(true)
+    osg::Referenced(true),
+    _maximumMemoryUsage(0),
+    _memoryUsage(0)
 {
 //    OSG_NOTICE<<"Constructed ObjectCache"<<std::endl;
 }
@@ -52,18 +57,151 @@ ObjectCache::~ObjectCache()
 //    OSG_NOTICE<<"Destructed ObjectCache"<<std::endl;
 }
 
+ObjectCache::Shard& ObjectCache::getShard(const std::string& fileName)
+{
+    // FNV-1a hash of the file name
+    unsigned int hash = 2166136261u;
+    for(std::string::const_iterator itr = fileName.begin(); itr != fileName.end(); ++itr)
+    {
+        hash ^= static_cast<unsigned char>(*itr);
+        hash *= 16777619u;
+    }
+    return _shards[hash % NUM_SHARDS];
+}
+
+ObjectCache::ObjectCacheMap::iterator ObjectCache::find(Shard& shard, const std::string& fileName, const osgDB::Options* options)
+{
+    // entries with the same file name are adjacent in the map, starting with the one without Options.
+    for(ObjectCacheMap::iterator itr = shard._objectCache.lower_bound(FileNameOptionsPair(fileName, 0));
+        itr != shard._objectCache.end() && itr->first.first==fileName;
+        ++itr)
+    {
+        if (itr->first.second.valid())
+        {
+            if (options && *(itr->first.second)==*options) return itr;
+        }
+        else if (!options) return itr;
+    }
+    return shard._objectCache.end();
+}
+
+void ObjectCache::insert(Shard& shard, const FileNameOptionsPair& key, osg::Object* object, double timestamp, size_t memoryUsage)
+{
+    ObjectCacheMap::iterator itr = shard._objectCache.find(key);
+    if (itr==shard._objectCache.end())
+    {
+        itr = shard._objectCache.insert(ObjectCacheMap::value_type(key, Entry())).first;
+        shard._lruList.push_front(&(itr->first));
+        itr->second._lruPosition = shard._lruList.begin();
+    }
+    else
+    {
+        shard._memoryUsage -= itr->second._memoryUsage;
+        removeMemoryUsage(itr->second._memoryUsage);
+        touch(shard, itr);
+    }
+
+    itr->second._object = object;
+    itr->second._timestamp = timestamp;
+    itr->second._memoryUsage = memoryUsage;
+    shard._memoryUsage += memoryUsage;
+    addMemoryUsage(memoryUsage);
+}
+
+void ObjectCache::erase(Shard& shard, ObjectCacheMap::iterator itr)
+{
+    shard._memoryUsage -= itr->second._memoryUsage;
+    removeMemoryUsage(itr->second._memoryUsage);
+    shard._lruList.erase(itr->second._lruPosition);
+    shard._objectCache.erase(itr);
+}
+
+void ObjectCache::touch(Shard& shard, ObjectCacheMap::iterator itr)
+{
+    shard._lruList.splice(shard._lruList.begin(), shard._lruList, itr->second._lruPosition);
+}
+
+void ObjectCache::addMemoryUsage(size_t bytes)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_memoryUsageMutex);
+    _memoryUsage += bytes;
+}
+
+void ObjectCache::removeMemoryUsage(size_t bytes)
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_memoryUsageMutex);
+    _memoryUsage -= bytes;
+}
+
+bool ObjectCache::evictLeastRecentlyUsed(Shard& shard)
+{
+    // walk from the least recently used end, objects still referenced elsewhere are skipped as evicting them frees no memory.
+    LRUList::iterator lru_itr = shard._lruList.end();
+    while(lru_itr!=shard._lruList.begin())
+    {
+        --lru_itr;
+
+        ObjectCacheMap::iterator itr = shard._objectCache.find(**lru_itr);
+        if (itr->second._object.valid() && itr->second._object->referenceCount()>1) continue;
+
+        OSG_DEBUG<<"Evicting "<<itr->first.first<<" from ObjectCache "<<this<<std::endl;
+
+        erase(shard, itr);
+
+        ++shard._statistics._numEvictions;
+        return true;
+    }
+    return false;
+}
+
+void ObjectCache::evict()
+{
+    if (_maximumMemoryUsage==0) return;
+
+    // take the least recently used entry of each shard in turn so the budget is shared by the whole cache
+    // rather than one shard being emptied while the others stay full.
+    bool evicted = true;
+    while(evicted && getMemoryUsage()>_maximumMemoryUsage)
+    {
+        evicted = false;
+        for(unsigned int i=0; i<NUM_SHARDS && getMemoryUsage()>_maximumMemoryUsage; ++i)
+        {
+            Shard& shard = _shards[i];
+            OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+            if (evictLeastRecentlyUsed(shard)) evicted = true;
+        }
+    }
+}
+
 void ObjectCache::addObjectCache(ObjectCache* objectCache)
 {
     // don't allow a cache to be added to itself.
     if (objectCache==this) return;
 
-    // lock both ObjectCache to prevent their contents from being modified by other threads while we merge.
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock1(_objectCacheMutex);
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock2(objectCache->_objectCacheMutex);
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        // both caches hash file names the same way so entries map to the same shard index in each.
+        Shard& shard = _shards[i];
+        Shard& otherShard = objectCache->_shards[i];
 
-    OSG_DEBUG<<"Inserting objects to main ObjectCache "<<objectCache->_objectCache.size()<<std::endl;
+        // lock both shards to prevent their contents from being modified by other threads while we merge.
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock1(shard._objectCacheMutex);
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock2(otherShard._objectCacheMutex);
 
-    _objectCache.insert(objectCache->_objectCache.begin(), objectCache->_objectCache.end());
+        OSG_DEBUG<<"Inserting objects to main ObjectCache "<<otherShard._objectCache.size()<<std::endl;
+
+        for(ObjectCacheMap::iterator itr = otherShard._objectCache.begin();
+            itr != otherShard._objectCache.end();
+            ++itr)
+        {
+            // existing entries are kept, matching std::map::insert.
+            if (shard._objectCache.count(itr->first)!=0) continue;
+
+            insert(shard, itr->first, itr->second._object.get(), itr->second._timestamp, itr->second._memoryUsage);
+        }
+    }
+
+    evict();
 }
 
 
@@ -71,35 +209,27 @@ void ObjectCache::addEntryToObjectCache(const std::string& filename, osg::Object
 {
     if (!object) return;
 
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache[FileNameOptionsPair(filename, options ? osg::clone(options) : 0)] = ObjectTimeStampPair(object,timestamp);
-    OSG_DEBUG<<"Adding "<<filename<<" with options '"<<(options ? options->getOptionString() : "")<<"' to ObjectCache "<<this<<std::endl;
-}
+    // estimate outside of the lock as it may traverse a whole subgraph.
+    size_t memoryUsage = estimateMemoryUsage(object);
 
-ObjectCache::ObjectCacheMap::iterator ObjectCache::find(const std::string& fileName, const osgDB::Options* options)
-{
-    for(ObjectCacheMap::iterator itr = _objectCache.begin();
-        itr != _objectCache.end();
-        ++itr)
     {
-        if (itr->first.first==fileName)
-        {
-            if (itr->first.second.valid())
-            {
-                if (options && *(itr->first.second)==*options) return itr;
-            }
-            else if (!options) return itr;
-        }
+        Shard& shard = getShard(filename);
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+        insert(shard, FileNameOptionsPair(filename, options ? osg::clone(options) : 0), object, timestamp, memoryUsage);
+        OSG_DEBUG<<"Adding "<<filename<<" with options '"<<(options ? options->getOptionString() : "")<<"' to ObjectCache "<<this<<std::endl;
     }
-    return _objectCache.end();
+
+    // evict once the shard is unlocked as the entries freed may live in any shard.
+    evict();
 }
 
 
 osg::Object* ObjectCache::getFromObjectCache(const std::string& fileName, const Options *options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end())
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+    ObjectCacheMap::iterator itr = find(shard, fileName, options);
+    if (itr!=shard._objectCache.end())
     {
         osg::ref_ptr<const osgDB::Options> o = itr->first.second;
         if (o.valid())
@@ -110,16 +240,23 @@ osg::Object* ObjectCache::getFromObjectCache(const std::string& fileName, const
         {
             OSG_DEBUG<<"Found "<<fileName<<" in ObjectCache "<<this<<std::endl;
         }
-        return itr->second.first.get();
+        touch(shard, itr);
+        ++shard._statistics._numHits;
+        return itr->second._object.get();
+    }
+    else
+    {
+        ++shard._statistics._numMisses;
+        return 0;
     }
-    else return 0;
 }
 
 osg::ref_ptr<osg::Object> ObjectCache::getRefFromObjectCache(const std::string& fileName, const Options *options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end())
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+    ObjectCacheMap::iterator itr = find(shard, fileName, options);
+    if (itr!=shard._objectCache.end())
     {
         osg::ref_ptr<const osgDB::Options> o = itr->first.second;
         if (o.valid())
@@ -130,63 +267,130 @@ osg::ref_ptr<osg::Object> ObjectCache::getRefFromObjectCache(const std::string&
         {
             OSG_DEBUG<<"Found "<<fileName<<" in ObjectCache "<<this<<std::endl;
         }
-        return itr->second.first.get();
+        touch(shard, itr);
+        ++shard._statistics._numHits;
+        return itr->second._object.get();
+    }
+    else
+    {
+        ++shard._statistics._numMisses;
+        return 0;
     }
-    else return 0;
 }
 
 void ObjectCache::updateTimeStampOfObjectsInCacheWithExternalReferences(double referenceTime)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    // look for objects with external references and update their time stamp.
-    for(ObjectCacheMap::iterator itr=_objectCache.begin();
-        itr!=_objectCache.end();
-        ++itr)
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
     {
-        // if ref count is greater the 1 the object has an external reference.
-        if (itr->second.first->referenceCount()>1)
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+
+        // look for objects with external references and update their time stamp.
+        for(ObjectCacheMap::iterator itr=shard._objectCache.begin();
+            itr!=shard._objectCache.end();
+            ++itr)
         {
-            // so update it time stamp.
-            itr->second.second = referenceTime;
+            // if ref count is greater the 1 the object has an external reference.
+            if (itr->second._object->referenceCount()>1)
+            {
+                // so update it time stamp.
+                itr->second._timestamp = referenceTime;
+            }
         }
     }
 }
 
 void ObjectCache::removeExpiredObjectsInCache(double expiryTime)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
-    // Remove expired entries from object cache
-    ObjectCacheMap::iterator oitr = _objectCache.begin();
-    while(oitr != _objectCache.end())
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
     {
-        if (oitr->second.second<=expiryTime)
-        {
-#if __cplusplus > 199711L
-            oitr = _objectCache.erase(oitr);
-#else
-            _objectCache.erase(oitr++);
-#endif
-        }
-        else
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+
+        // Remove expired entries from object cache
+        ObjectCacheMap::iterator oitr = shard._objectCache.begin();
+        while(oitr != shard._objectCache.end())
         {
-            ++oitr;
+            if (oitr->second._timestamp<=expiryTime)
+            {
+                erase(shard, oitr++);
+            }
+            else
+            {
+                ++oitr;
+            }
         }
     }
 }
 
 void ObjectCache::removeFromObjectCache(const std::string& fileName, const Options *options)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    ObjectCacheMap::iterator itr = find(fileName, options);
-    if (itr!=_objectCache.end()) _objectCache.erase(itr);
+    Shard& shard = getShard(fileName);
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+    ObjectCacheMap::iterator itr = find(shard, fileName, options);
+    if (itr!=shard._objectCache.end()) erase(shard, itr);
 }
 
 void ObjectCache::clear()
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-    _objectCache.clear();
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+        shard._objectCache.clear();
+        shard._lruList.clear();
+        removeMemoryUsage(shard._memoryUsage);
+        shard._memoryUsage = 0;
+    }
+}
+
+void ObjectCache::setMaximumMemoryUsage(size_t bytes)
+{
+    _maximumMemoryUsage = bytes;
+
+    evict();
+}
+
+size_t ObjectCache::getMemoryUsage() const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_memoryUsageMutex);
+    return _memoryUsage;
+}
+
+unsigned int ObjectCache::getNumObjects() const
+{
+    unsigned int numObjects = 0;
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        const Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+        numObjects += shard._objectCache.size();
+    }
+    return numObjects;
+}
+
+ObjectCache::Statistics ObjectCache::getStatistics() const
+{
+    Statistics statistics;
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        const Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+        statistics._numHits += shard._statistics._numHits;
+        statistics._numMisses += shard._statistics._numMisses;
+        statistics._numEvictions += shard._statistics._numEvictions;
+    }
+    return statistics;
+}
+
+void ObjectCache::resetStatistics()
+{
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
+        shard._statistics = Statistics();
+    }
 }
 
 namespace ObjectCacheUtils
@@ -252,32 +456,133 @@ struct ContainsUnreffedTextures : public osg::NodeVisitor
     }
 };
 
+struct EstimateMemoryUsage : public osg::NodeVisitor
+{
+    EstimateMemoryUsage() :
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+        memoryUsage(0)
+    {}
+
+    size_t memoryUsage;
+
+    // shared images, arrays and state are only counted once.
+    std::set<const osg::Object*> counted;
+
+    bool firstVisit(const osg::Object* object)
+    {
+        return object && counted.insert(object).second;
+    }
+
+    void add(const osg::BufferData* bufferData)
+    {
+        if (firstVisit(bufferData)) memoryUsage += bufferData->getTotalDataSize();
+    }
+
+    void add(const osg::StateSet* stateset)
+    {
+        if (!firstVisit(stateset)) return;
+
+        for(unsigned int i=0; i<stateset->getNumTextureAttributeLists(); ++i)
+        {
+            const osg::StateAttribute* sa = stateset->getTextureAttribute(i, osg::StateAttribute::TEXTURE);
+            if (sa) add(sa);
+        }
+    }
+
+    void add(const osg::Object* object)
+    {
+        if (object->asNode())
+        {
+            const_cast<osg::Node*>(object->asNode())->accept(*this);
+        }
+        else if (object->asStateSet())
+        {
+            add(object->asStateSet());
+        }
+        else if (object->asStateAttribute())
+        {
+            const osg::Texture* texture = dynamic_cast<const osg::Texture*>(object);
+            if (texture && firstVisit(texture))
+            {
+                for(unsigned int i=0; i<texture->getNumImages(); ++i)
+                {
+                    add(texture->getImage(i));
+                }
+            }
+        }
+        else
+        {
+            add(dynamic_cast<const osg::BufferData*>(object));
+        }
+    }
+
+    void apply(osg::Node& node)
+    {
+        if (node.getStateSet()) add(node.getStateSet());
+
+        traverse(node);
+    }
+
+    void apply(osg::Drawable& drawable)
+    {
+        if (drawable.getStateSet()) add(drawable.getStateSet());
+
+        osg::Geometry* geometry = drawable.asGeometry();
+        if (!geometry || !firstVisit(geometry)) return;
+
+        osg::Geometry::ArrayList arrays;
+        geometry->getArrayList(arrays);
+        for(osg::Geometry::ArrayList::iterator itr = arrays.begin(); itr != arrays.end(); ++itr)
+        {
+            add(itr->get());
+        }
+
+        for(unsigned int i=0; i<geometry->getNumPrimitiveSets(); ++i)
+        {
+            add(geometry->getPrimitiveSet(i));
+        }
+    }
+};
+
 } // ObjectCacheUtils
 
 void ObjectCache::releaseGLObjects(osg::State* state)
 {
-    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_objectCacheMutex);
-
     ObjectCacheUtils::ContainsUnreffedTextures cut;
 
-    for(ObjectCacheMap::iterator itr = _objectCache.begin();
-        itr != _objectCache.end();
-        )
+    for(unsigned int i=0; i<NUM_SHARDS; ++i)
     {
-        ObjectCacheMap::iterator curr_itr = itr;
+        Shard& shard = _shards[i];
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(shard._objectCacheMutex);
 
-        // get object and advance iterator to next item
-        osg::Object* object = itr->second.first.get();
+        for(ObjectCacheMap::iterator itr = shard._objectCache.begin();
+            itr != shard._objectCache.end();
+            )
+        {
+            ObjectCacheMap::iterator curr_itr = itr;
 
-        bool needToRemoveEntry = cut.check(itr->second.first.get());
+            // get object and advance iterator to next item
+            osg::Object* object = itr->second._object.get();
 
-        object->releaseGLObjects(state);
+            bool needToRemoveEntry = cut.check(itr->second._object.get());
 
-        ++itr;
+            object->releaseGLObjects(state);
 
-        if (needToRemoveEntry)
-        {
-            _objectCache.erase(curr_itr);
+            ++itr;
+
+            if (needToRemoveEntry)
+            {
+                erase(shard, curr_itr);
+            }
         }
     }
 }
+
+size_t ObjectCache::estimateMemoryUsage(const osg::Object* object)
+{
+    if (!object) return 0;
+
+    ObjectCacheUtils::EstimateMemoryUsage emu;
+    emu.add(object);
+    return emu.memoryUsage;
+}
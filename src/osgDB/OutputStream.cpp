@@ -14,6 +14,7 @@
 
 #include <osg/Version>
 #include <osg/Notify>
+#include <osg/Geode>
 #include <osgDB/ConvertBase64>
 #include <osgDB/FileUtils>
 #include <osgDB/WriteFile>
@@ -21,12 +22,15 @@
 #include <osgDB/ObjectWrapper>
 #include <osgDB/fstream>
 #include <sstream>
+#include <algorithm>
+#include <typeinfo>
 #include <stdlib.h>
 
 using namespace osgDB;
 
 OutputStream::OutputStream( const osgDB::Options* options )
-:   _writeImageHint(WRITE_USE_IMAGE_HINT), _useSchemaData(false), _useRobustBinaryFormat(true), _targetFileVersion(OPENSCENEGRAPH_SOVERSION)
+:   _writeImageHint(WRITE_USE_IMAGE_HINT), _useSchemaData(false), _useRobustBinaryFormat(true), _targetFileVersion(OPENSCENEGRAPH_SOVERSION),
+    _numChunks(0), _writeChunks(false)
 {
     BEGIN_BRACKET.set( "{", +INDENT_VALUE );
     END_BRACKET.set( "}", -INDENT_VALUE );
@@ -42,6 +46,8 @@ OutputStream::OutputStream( const osgDB::Options* options )
         _schemaName = options->getPluginStringData("SchemaFile");
     if ( !options->getPluginStringData("Compressor").empty() )
         _compressorName = options->getPluginStringData("Compressor");
+    if ( !options->getPluginStringData("Chunks").empty() )
+        _numChunks = atoi(options->getPluginStringData("Chunks").c_str());
     if ( !options->getPluginStringData("WriteImageHint").empty() )
     {
         std::string hintString = options->getPluginStringData("WriteImageHint");
@@ -659,6 +665,14 @@ void OutputStream::writeImage( const osg::Image* img )
 
 void OutputStream::writeObject( const osg::Object* obj )
 {
+    if ( _writeChunks )
+    {
+        // only the root object of the scene is chunked
+        _writeChunks = false;
+        writeChunkedObject( obj );
+        return;
+    }
+
     if ( !obj )
     {
         *this << std::string("NULL") << std::endl;  // Write NULL token.
@@ -787,6 +801,10 @@ void OutputStream::start( OutputIterator* outIterator, OutputStream::WriteType t
             outIterator->setSupportBinaryBrackets( true );
             attributes |= 0x4;
         }
+
+        // Scenes may be split into independently decodable chunks, the inbuilt schema isn't supported as it is per stream
+        _writeChunks = _numChunks>1 && type==WRITE_SCENE && !_useSchemaData;
+        if ( _writeChunks ) attributes |= 0x8;
         *this << attributes;
 
         // Record all custom versions
@@ -927,6 +945,176 @@ void OutputStream::writeSchema( std::ostream& fout )
 
 // PROTECTED METHODS
 
+namespace OutputStreamUtils
+{
+
+unsigned int findRoot( std::vector<unsigned int>& parents, unsigned int i )
+{
+    while ( parents[i]!=i )
+    {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+struct ComponentSizeGreater
+{
+    ComponentSizeGreater( const std::vector<size_t>& sizes ) : _sizes(sizes) {}
+    bool operator()( unsigned int lhs, unsigned int rhs ) const { return _sizes[lhs]>_sizes[rhs]; }
+    const std::vector<size_t>& _sizes;
+};
+
+// Shallow copies a group without its children, so the children written separately keep their parent lists untouched
+struct ChildlessCopyOp : public osg::CopyOp
+{
+    ChildlessCopyOp() : osg::CopyOp(osg::CopyOp::SHALLOW_COPY) {}
+    virtual osg::Node* operator() ( const osg::Node* ) const { return 0; }
+};
+
+}
+
+void OutputStream::setUpChunkStream( OutputStream& chunkStream ) const
+{
+    // chunks are plain streams, compression and schema data apply to the enclosing stream
+    chunkStream._domainVersionMap = _domainVersionMap;
+    chunkStream._writeImageHint = _writeImageHint;
+    chunkStream._useSchemaData = false;
+    chunkStream._useRobustBinaryFormat = _useRobustBinaryFormat;
+    chunkStream._compressorName.clear();
+    chunkStream._targetFileVersion = _targetFileVersion;
+    chunkStream._numChunks = 0;
+}
+
+void OutputStream::writeChunkedObject( const osg::Object* obj )
+{
+    const unsigned int ROOT_INDEX = 0xffffffff;
+
+    _fields.push_back( "ChunkedObject" );
+
+    // Items are the root without its children followed by each child, Groups with per child data such as LOD and Switch
+    // are kept whole as their children can't be reattached without that data.
+    std::vector<const osg::Object*> items;
+    std::vector<unsigned int> indices;
+    osg::ref_ptr<osg::Group> shell;
+
+    const osg::Group* group = (obj && obj->asNode()) ? obj->asNode()->asGroup() : 0;
+    bool splitChildren = group && group->getNumChildren()>1 &&
+                         ( typeid(*group)==typeid(osg::Group) || typeid(*group)==typeid(osg::Geode) || group->asTransform()!=0 );
+    if ( splitChildren )
+    {
+        shell = osg::clone( group, OutputStreamUtils::ChildlessCopyOp() );
+
+        items.push_back( shell.get() ); indices.push_back( ROOT_INDEX );
+        for ( unsigned int i=0; i<group->getNumChildren(); ++i )
+        {
+            items.push_back( group->getChild(i) ); indices.push_back( i );
+        }
+    }
+    else
+    {
+        items.push_back( obj ); indices.push_back( ROOT_INDEX );
+    }
+
+    // Write each item to a scratch stream to find its size and the objects it references, items that reference
+    // the same object are merged into one component so sharing is preserved within a chunk.
+    std::vector<unsigned int> parents( items.size() );
+    std::vector<size_t> sizes( items.size(), 0 );
+    std::map<const void*, unsigned int> owners;
+    for ( unsigned int i=0; i<items.size(); ++i )
+    {
+        parents[i] = i;
+
+        std::stringstream scratch;
+        osg::ref_ptr<OutputIterator> scratchIterator = _out->cloneForStream( &scratch );
+        if ( !scratchIterator )
+        {
+            throwException( "OutputStream: Output format doesn't support chunked scenes." );
+            return;
+        }
+
+        OutputStream scratchStream( _options.get() );
+        setUpChunkStream( scratchStream );
+        scratchStream.start( scratchIterator.get(), WRITE_SCENE );
+        scratchStream.writeObject( items[i] );
+        scratchIterator->flush();
+        sizes[i] = scratch.str().size();
+
+        std::vector<const void*> referenced;
+        for ( ObjectMap::iterator itr=scratchStream._objectMap.begin(); itr!=scratchStream._objectMap.end(); ++itr )
+            referenced.push_back( itr->first );
+        for ( ArrayMap::iterator itr=scratchStream._arrayMap.begin(); itr!=scratchStream._arrayMap.end(); ++itr )
+            referenced.push_back( itr->first );
+
+        for ( std::vector<const void*>::iterator itr=referenced.begin(); itr!=referenced.end(); ++itr )
+        {
+            std::map<const void*, unsigned int>::iterator oitr = owners.find( *itr );
+            if ( oitr==owners.end() ) owners[*itr] = i;
+            else parents[OutputStreamUtils::findRoot(parents, i)] = OutputStreamUtils::findRoot(parents, oitr->second);
+        }
+    }
+
+    // Accumulate the size of each component
+    std::vector<unsigned int> components;
+    std::vector<size_t> componentSizes( items.size(), 0 );
+    for ( unsigned int i=0; i<items.size(); ++i )
+    {
+        unsigned int root = OutputStreamUtils::findRoot(parents, i);
+        if ( root==i ) components.push_back( i );
+        componentSizes[root] += sizes[i];
+    }
+
+    // Distribute the components, largest first, onto the least loaded chunk
+    unsigned int numChunks = osg::minimum( _numChunks, static_cast<unsigned int>(components.size()) );
+    std::sort( components.begin(), components.end(), OutputStreamUtils::ComponentSizeGreater(componentSizes) );
+
+    std::vector<size_t> chunkSizes( numChunks, 0 );
+    std::vector<unsigned int> componentChunks( items.size(), 0 );
+    for ( std::vector<unsigned int>::iterator itr=components.begin(); itr!=components.end(); ++itr )
+    {
+        unsigned int chunk = std::min_element(chunkSizes.begin(), chunkSizes.end()) - chunkSizes.begin();
+        componentChunks[*itr] = chunk;
+        chunkSizes[chunk] += componentSizes[*itr];
+    }
+
+    // the number of children lets the reader check the child indices it decodes
+    *this << numChunks << static_cast<unsigned int>(items.size()-1);
+    for ( unsigned int c=0; c<numChunks; ++c )
+    {
+        std::vector<unsigned int> chunkItems;
+        for ( unsigned int i=0; i<items.size(); ++i )
+        {
+            if ( componentChunks[OutputStreamUtils::findRoot(parents, i)]==c ) chunkItems.push_back( i );
+        }
+
+        std::stringstream chunkData;
+        osg::ref_ptr<OutputIterator> chunkIterator = _out->cloneForStream( &chunkData );
+
+        OutputStream chunkStream( _options.get() );
+        setUpChunkStream( chunkStream );
+        chunkStream.start( chunkIterator.get(), WRITE_SCENE );
+        chunkStream << static_cast<unsigned int>(chunkItems.size());
+        for ( std::vector<unsigned int>::iterator itr=chunkItems.begin(); itr!=chunkItems.end(); ++itr )
+        {
+            chunkStream << indices[*itr];
+            chunkStream.writeObject( items[*itr] );
+        }
+        chunkIterator->flush();
+
+        if ( chunkStream.getException() )
+        {
+            _exception = new OutputException( chunkStream._fields, chunkStream.getException()->getError() );
+            return;
+        }
+
+        std::string data = chunkData.str();
+        *this << static_cast<unsigned int>(data.size());
+        writeCharArray( data.c_str(), data.size() );
+    }
+
+    _fields.pop_back();
+}
+
 template<typename T>
 void OutputStream::writeArrayImplementation( const T* a, int write_size, unsigned int numInRow )
 {
@@ -25,6 +25,8 @@
 #include <osg/Version>
 #include <osg/Timer>
 
+#include <OpenThreads/Thread>
+
 #include <osgDB/Registry>
 #include <osgDB/FileUtils>
 #include <osgDB/ReadFile>
@@ -63,6 +65,10 @@ static osg::ApplicationUsageProxy Registry_e1(osg::ApplicationUsage::ENVIRONMENT
 #endif
 
 static osg::ApplicationUsageProxy Registry_e2(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_BUILD_KDTREES on/off","Enable/disable the automatic building of KdTrees for each loaded Geometry.");
+static osg::ApplicationUsageProxy Registry_e3(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OBJECT_CACHE_MAX_MEMORY <megabytes>","Set the estimated memory budget of the ObjectCache, least recently used unreferenced objects are evicted once exceeded. 0 disables the budget.");
+static osg::ApplicationUsageProxy Registry_e4(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_FILE_CACHE_MAX_SIZE <megabytes>","Set the maximum size of the OSG_FILE_CACHE directory, least recently used files are removed once exceeded. 0 disables the limit.");
+static osg::ApplicationUsageProxy Registry_e5(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_KDTREE_NUM_THREADS <num>","Set the number of threads used to build the KdTrees of each loaded model.");
+static osg::ApplicationUsageProxy Registry_e6(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_KDTREE_SPLIT_METHOD MIDPOINT/SAH","Set whether KdTrees are split at the middle of their nodes or where the surface area heuristic finds intersection tests cheapest.");
 
 
 // from MimeTypes.cpp
@@ -72,9 +78,8 @@ extern const char* builtinMimeTypeExtMappings[];
 class Registry::AvailableReaderWriterIterator
 {
 public:
-    AvailableReaderWriterIterator(Registry::ReaderWriterList& rwList, OpenThreads::ReentrantMutex& pluginMutex):
-        _rwList(rwList),
-        _pluginMutex(pluginMutex) {}
+    AvailableReaderWriterIterator(Registry& registry):
+        _registry(registry) {}
 
 
     ReaderWriter& operator * () { return *get(); }
@@ -92,16 +97,34 @@ protected:
 
     AvailableReaderWriterIterator& operator = (const AvailableReaderWriterIterator&) { return *this; }
 
-    Registry::ReaderWriterList&     _rwList;
-    OpenThreads::ReentrantMutex&    _pluginMutex;
+    Registry&                       _registry;
 
     std::set<ReaderWriter*>         _rwUsed;
 
     ReaderWriter* get()
     {
-        OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(_pluginMutex);
-        Registry::ReaderWriterList::iterator itr=_rwList.begin();
-        for(;itr!=_rwList.end();++itr)
+        // first check the published snapshot, which doesn't require the plugin mutex
+        {
+            Registry::ReaderWriterSnapshotReader reader(_registry);
+            const Registry::ReaderWriterSnapshot* snapshot = reader.get();
+            if (snapshot)
+            {
+                for(Registry::ReaderWriterSnapshot::ReaderWriters::const_iterator itr=snapshot->readerWriters.begin();
+                    itr!=snapshot->readerWriters.end();
+                    ++itr)
+                {
+                    if (_rwUsed.find(itr->get())==_rwUsed.end())
+                    {
+                        return itr->get();
+                    }
+                }
+            }
+        }
+
+        // fallback to the authoritative list in case it has been modified directly via getReaderWriterList()
+        OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(_registry._pluginMutex);
+        Registry::ReaderWriterList::iterator itr=_registry._rwList.begin();
+        for(;itr!=_registry._rwList.end();++itr)
         {
             if (_rwUsed.find(itr->get())==_rwUsed.end())
             {
@@ -235,6 +258,21 @@ Registry::Registry()
         else _buildKdTreesHint = Options::BUILD_KDTREES;
     }
 
+    const char* kdtree_threads_str = getenv("OSG_KDTREE_NUM_THREADS");
+    if (kdtree_threads_str)
+    {
+        int numThreads = atoi(kdtree_threads_str);
+        if (numThreads>0) _kdTreeBuilder->setNumThreads(numThreads);
+        OSG_INFO<<"Registry : KdTree build threads = "<<_kdTreeBuilder->getNumThreads()<<std::endl;
+    }
+
+    const char* kdtree_split_str = getenv("OSG_KDTREE_SPLIT_METHOD");
+    if (kdtree_split_str)
+    {
+        if (strcmp(kdtree_split_str, "SAH")==0 || strcmp(kdtree_split_str, "sah")==0) _kdTreeBuilder->_buildOptions._splitMethod = osg::KdTree::BuildOptions::SAH_SPLIT;
+        else _kdTreeBuilder->_buildOptions._splitMethod = osg::KdTree::BuildOptions::MIDPOINT_SPLIT;
+    }
+
     const char* ptr=0;
 
     _expiryDelay = 10.0;
@@ -248,10 +286,23 @@ Registry::Registry()
     if (fileCachePath)
     {
         _fileCache = new FileCache(fileCachePath);
+
+        if( (ptr = getenv("OSG_FILE_CACHE_MAX_SIZE")) != 0)
+        {
+            double megabytes = osg::asciiToDouble(ptr);
+            if (megabytes>0.0) _fileCache->setMaximumCacheSize(static_cast<unsigned long long>(megabytes*1024.0*1024.0));
+            OSG_INFO<<"Registry : FileCache maximum size = "<<_fileCache->getMaximumCacheSize()<<" bytes"<<std::endl;
+        }
     }
 
     // assign ObjectCache.
     _objectCache = new ObjectCache;
+    if( (ptr = getenv("OSG_OBJECT_CACHE_MAX_MEMORY")) != 0)
+    {
+        double megabytes = osg::asciiToDouble(ptr);
+        if (megabytes>0.0) _objectCache->setMaximumMemoryUsage(static_cast<size_t>(megabytes*1024.0*1024.0));
+        OSG_INFO<<"Registry : ObjectCache maximum memory usage = "<<_objectCache->getMaximumMemoryUsage()<<" bytes"<<std::endl;
+    }
 
     _createNodeFromImage = false;
     _openingLibrary = false;
@@ -616,6 +667,7 @@ void Registry::addReaderWriter(ReaderWriter* rw)
 
     _rwList.push_back(rw);
 
+    publishReaderWriterSnapshot();
 }
 
 
@@ -631,10 +683,23 @@ void Registry::removeReaderWriter(ReaderWriter* rw)
     if (rwitr!=_rwList.end())
     {
         _rwList.erase(rwitr);
+
+        publishReaderWriterSnapshot();
     }
 
 }
 
+void Registry::publishReaderWriterSnapshot()
+{
+    osg::ref_ptr<ReaderWriterSnapshot> snapshot = new ReaderWriterSnapshot;
+    snapshot->readerWriters.assign(_rwList.begin(), _rwList.end());
+
+    // the previous snapshot is released by whichever of this thread or its last reader drops the final reference,
+    // so publishing never waits on readers.
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_rwSnapshotMutex);
+    _rwSnapshot.swap(snapshot);
+}
+
 ImageProcessor* Registry::getImageProcessor()
 {
     {
@@ -872,6 +937,21 @@ DynamicLibrary* Registry::getLibrary(const std::string& fileName)
 
 ReaderWriter* Registry::getReaderWriterForExtension(const std::string& ext)
 {
+    // fast path for already registered plugins, doesn't require the plugin mutex
+    {
+        ReaderWriterSnapshotReader reader(*this);
+        const ReaderWriterSnapshot* snapshot = reader.get();
+        if (snapshot)
+        {
+            for(ReaderWriterSnapshot::ReaderWriters::const_iterator itr=snapshot->readerWriters.begin();
+                itr!=snapshot->readerWriters.end();
+                ++itr)
+            {
+                if((*itr)->acceptsExtension(ext)) return itr->get();
+            }
+        }
+    }
+
     // record the existing reader writer.
     std::set<ReaderWriter*> rwOriginal;
 
@@ -1015,6 +1095,8 @@ struct Registry::ReadScriptFunctor : public Registry::ReadFunctor
 
 void Registry::addArchiveExtension(const std::string ext)
 {
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_archiveExtMutex);
+
     for(ArchiveExtensionList::iterator aitr=_archiveExtList.begin();
         aitr!=_archiveExtList.end();
         ++aitr)
@@ -1025,6 +1107,24 @@ void Registry::addArchiveExtension(const std::string ext)
     _archiveExtList.push_back(ext);
 }
 
+bool Registry::containsArchivePath(const std::string& filename) const
+{
+    OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_archiveExtMutex);
+
+    for(ArchiveExtensionList::const_iterator aitr=_archiveExtList.begin();
+        aitr!=_archiveExtList.end();
+        ++aitr)
+    {
+        std::string archiveExtension = "." + (*aitr);
+        if (filename.find(archiveExtension+'/')!=std::string::npos ||
+            filename.find(archiveExtension+'\\')!=std::string::npos)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 std::string Registry::findDataFileImplementation(const std::string& filename, const Options* options, CaseSensitivity caseSensitivity)
 {
     if (filename.empty()) return filename;
@@ -1140,8 +1240,15 @@ std::string Registry::findLibraryFileImplementation(const std::string& filename,
 
 ReaderWriter::ReadResult Registry::read(const ReadFunctor& readFunctor)
 {
-    for(ArchiveExtensionList::iterator aitr=_archiveExtList.begin();
-        aitr!=_archiveExtList.end();
+    // copy the archive extensions as opening an archive may load a plugin that adds to them.
+    ArchiveExtensionList archiveExtensions;
+    {
+        OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_archiveExtMutex);
+        archiveExtensions = _archiveExtList;
+    }
+
+    for(ArchiveExtensionList::iterator aitr=archiveExtensions.begin();
+        aitr!=archiveExtensions.end();
         ++aitr)
     {
         std::string archiveExtension = "." + (*aitr);
@@ -1189,7 +1296,7 @@ ReaderWriter::ReadResult Registry::read(const ReadFunctor& readFunctor)
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(*this);
     for(;itr.valid();++itr)
     {
         ReaderWriter::ReadResult rr = readFunctor.doRead(*itr);
@@ -1345,7 +1452,7 @@ ReaderWriter::WriteResult Registry::writeObjectImplementation(const Object& obj,
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(*this);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeObject(obj,fileName,options);
@@ -1391,7 +1498,7 @@ ReaderWriter::WriteResult Registry::writeImageImplementation(const Image& image,
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(*this);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeImage(image,fileName,options);
@@ -1436,7 +1543,7 @@ ReaderWriter::WriteResult Registry::writeHeightFieldImplementation(const HeightF
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(*this);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeHeightField(HeightField,fileName,options);
@@ -1493,7 +1600,7 @@ ReaderWriter::WriteResult Registry::writeNodeImplementation(const Node& node,con
     Results results;
 
     // first attempt to write the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(*this);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeNode(node,fileName,options);
@@ -1539,7 +1646,7 @@ ReaderWriter::WriteResult Registry::writeShaderImplementation(const Shader& shad
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(*this);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeShader(shader,fileName,options);
@@ -1586,7 +1693,7 @@ ReaderWriter::WriteResult Registry::writeScriptImplementation(const Script& imag
     Results results;
 
     // first attempt to load the file from existing ReaderWriter's
-    AvailableReaderWriterIterator itr(_rwList, _pluginMutex);
+    AvailableReaderWriterIterator itr(*this);
     for(;itr.valid();++itr)
     {
         ReaderWriter::WriteResult rr = itr->writeScript(image,fileName,options);
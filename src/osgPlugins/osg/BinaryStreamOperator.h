@@ -14,6 +14,9 @@ public:
 
     virtual bool isBinary() const { return true; }
 
+    virtual osgDB::OutputIterator* cloneForStream( std::ostream* ostream ) const
+    { return new BinaryOutputIterator( ostream ); }
+
     virtual void writeBool( bool b )
     { char c = b?1:0; _out->write( &c, osgDB::CHAR_SIZE ); }
 
@@ -154,6 +157,9 @@ public:
 
     virtual bool isBinary() const { return true; }
 
+    virtual osgDB::InputIterator* cloneForStream( std::istream* istream ) const
+    { return new BinaryInputIterator( istream, _byteSwap ); }
+
     virtual void readBool( bool& b )
     {
         char c = 0;
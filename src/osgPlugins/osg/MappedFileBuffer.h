@@ -0,0 +1,144 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2010 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#ifndef OSG2_MAPPEDFILEBUFFER
+#define OSG2_MAPPEDFILEBUFFER
+
+#include <osg/Notify>
+#include <streambuf>
+#include <string>
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+/** Read only std::streambuf over a memory mapped file.
+  * The whole file is the get area, so std::istream::read() is a single memcpy straight from the mapped pages
+  * and seekg()/tellg() are pointer arithmetic, avoiding the buffering and per call overhead of std::ifstream.*/
+class MappedFileBuffer : public std::streambuf
+{
+public:
+    MappedFileBuffer( const std::string& fileName ):
+        _data(0),
+        _size(0)
+    {
+#if defined(_WIN32) && !defined(__CYGWIN__)
+        _file = INVALID_HANDLE_VALUE;
+        _mapping = 0;
+
+        _file = CreateFileA( fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0 );
+        if ( _file==INVALID_HANDLE_VALUE ) return;
+
+        LARGE_INTEGER fileSize;
+        if ( !GetFileSizeEx(_file, &fileSize) || fileSize.QuadPart<=0 || static_cast<unsigned long long>(fileSize.QuadPart)>static_cast<size_t>(-1) ) return;
+
+        _mapping = CreateFileMappingA( _file, 0, PAGE_READONLY, 0, 0, 0 );
+        if ( !_mapping ) return;
+
+        void* data = MapViewOfFile( _mapping, FILE_MAP_READ, 0, 0, 0 );
+        if ( !data ) return;
+
+        _data = static_cast<char*>(data);
+        _size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = open( fileName.c_str(), O_RDONLY );
+        if ( fd<0 ) return;
+
+        struct stat fileStat;
+        if ( fstat(fd, &fileStat)==0 && fileStat.st_size>0 && static_cast<unsigned long long>(fileStat.st_size)<=static_cast<size_t>(-1) )
+        {
+            size_t size = static_cast<size_t>(fileStat.st_size);
+            void* data = mmap( 0, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if ( data!=MAP_FAILED )
+            {
+        #ifdef MADV_SEQUENTIAL
+                madvise( data, size, MADV_SEQUENTIAL );
+        #endif
+                _data = static_cast<char*>(data);
+                _size = size;
+            }
+        }
+
+        // the mapping remains valid once the descriptor is closed.
+        close( fd );
+#endif
+
+        if ( _data )
+        {
+            setg( _data, _data, _data+_size );
+        }
+        else
+        {
+            OSG_INFO<<"MappedFileBuffer: unable to map "<<fileName<<", falling back to a file stream."<<std::endl;
+        }
+    }
+
+    virtual ~MappedFileBuffer()
+    {
+#if defined(_WIN32) && !defined(__CYGWIN__)
+        if ( _data ) UnmapViewOfFile( _data );
+        if ( _mapping ) CloseHandle( _mapping );
+        if ( _file!=INVALID_HANDLE_VALUE ) CloseHandle( _file );
+#else
+        if ( _data ) munmap( _data, _size );
+#endif
+    }
+
+    bool valid() const { return _data!=0; }
+
+    size_t size() const { return _size; }
+
+protected:
+
+    virtual pos_type seekoff( off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode which )
+    {
+        if ( !_data || !(which & std::ios_base::in) ) return pos_type(off_type(-1));
+
+        off_type position;
+        if ( dir==std::ios_base::beg ) position = offset;
+        else if ( dir==std::ios_base::cur ) position = off_type(gptr()-eback()) + offset;
+        else position = off_type(_size) + offset;
+
+        if ( position<0 || position>off_type(_size) ) return pos_type(off_type(-1));
+
+        setg( eback(), eback()+position, egptr() );
+        return pos_type(position);
+    }
+
+    virtual pos_type seekpos( pos_type position, std::ios_base::openmode which )
+    {
+        return seekoff( off_type(position), std::ios_base::beg, which );
+    }
+
+    // prevent copying as the buffer owns the mapping.
+    MappedFileBuffer( const MappedFileBuffer& );
+    MappedFileBuffer& operator = ( const MappedFileBuffer& );
+
+    char*   _data;
+    size_t  _size;
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+    HANDLE  _file;
+    HANDLE  _mapping;
+#endif
+};
+
+#endif
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include "AsciiStreamOperator.h"
 #include "BinaryStreamOperator.h"
+#include "MappedFileBuffer.h"
 #include "XmlStreamOperator.h"
 
 using namespace osgDB;
@@ -132,9 +133,11 @@ public:
         supportsOption( "Ascii", "Import/Export option: Force reading/writing ascii file" );
         supportsOption( "XML", "Import/Export option: Force reading/writing XML file" );
         supportsOption( "ForceReadingImage", "Import option: Load an empty image instead if required file missed" );
+        supportsOption( "NoMemoryMap", "Import option: Read .osgb files through a file stream rather than memory mapping them" );
         supportsOption( "SchemaData", "Export option: Record inbuilt schema data into a binary file" );
         supportsOption( "SchemaFile=<file>", "Import/Export option: Use/Record an ascii schema file" );
         supportsOption( "Compressor=<n>", "Export option: Use an inbuilt or user-defined compressor" );
+        supportsOption( "Chunks=<n>", "Export option: Split a binary scene into <n> chunks that are decoded in parallel when read" );
         supportsOption( "WriteImageHint=<hint>", "Export option: Hint of writing image to stream: "
                         "<IncludeData> writes Image::data() directly; "
                         "<IncludeFile> writes the image file itself to stream; "
@@ -196,6 +199,20 @@ public:
         return local_opt.release();
     }
 
+    // 二进制文件默认使用内存映射读取，可通过NoMemoryMap选项关闭
+    bool useMemoryMap( const Options* options ) const
+    {
+        if ( !options || options->getPluginStringData("fileType")!="Binary" ) return false;
+
+        std::istringstream iss( options->getOptionString() );
+        std::string opt;
+        while ( iss >> opt )
+        {
+            if ( opt=="NoMemoryMap" ) return false;
+        }
+        return true;
+    }
+
     // 从文件读取对象：统一的对象读取接口
     virtual ReadResult readObject( const std::string& file, const Options* options ) const
     {
@@ -207,6 +224,17 @@ public:
         Options* local_opt = prepareReading( result, fileName, mode, options );
         if ( !result.success() ) return result;
 
+        // 内存映射：整个文件作为流缓冲区，避免ifstream的逐次拷贝
+        if ( useMemoryMap(local_opt) )
+        {
+            MappedFileBuffer buffer( fileName );
+            if ( buffer.valid() )
+            {
+                std::istream istream( &buffer );
+                return readObject( istream, local_opt );
+            }
+        }
+
         // 打开文件流并读取
         osgDB::ifstream istream( fileName.c_str(), mode );
         return readObject( istream, local_opt );
@@ -249,6 +277,17 @@ public:
         Options* local_opt = prepareReading( result, fileName, mode, options );
         if ( !result.success() ) return result;
 
+        // 内存映射：整个文件作为流缓冲区，避免ifstream的逐次拷贝
+        if ( useMemoryMap(local_opt) )
+        {
+            MappedFileBuffer buffer( fileName );
+            if ( buffer.valid() )
+            {
+                std::istream istream( &buffer );
+                return readImage( istream, local_opt );
+            }
+        }
+
         // 打开文件流并读取图像
         osgDB::ifstream istream( fileName.c_str(), mode );
         return readImage( istream, local_opt );
@@ -289,6 +328,17 @@ public:
         Options* local_opt = prepareReading( result, fileName, mode, options );
         if ( !result.success() ) return result;
 
+        // 内存映射：整个文件作为流缓冲区，避免ifstream的逐次拷贝
+        if ( useMemoryMap(local_opt) )
+        {
+            MappedFileBuffer buffer( fileName );
+            if ( buffer.valid() )
+            {
+                std::istream istream( &buffer );
+                return readNode( istream, local_opt );
+            }
+        }
+
         // 打开文件流并读取节点
         osgDB::ifstream istream( fileName.c_str(), mode );
         return readNode( istream, local_opt );
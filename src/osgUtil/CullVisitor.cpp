@@ -32,6 +32,7 @@
 
 #include <float.h>
 #include <algorithm>
+#include <typeinfo>
 
 #include <osg/Timer>
 
@@ -51,7 +52,11 @@ CullVisitor::CullVisitor():
     _computed_znear(FLT_MAX),
     _computed_zfar(-FLT_MAX),
     _traversalOrderNumber(0),
+    _traversalSubsetGroup(0),
+    _traversalSubsetBegin(0),
+    _traversalSubsetEnd(0),
     _currentReuseRenderLeafIndex(0),
+    _numberOfAssignedRenderLeaves(0),
     _numberOfEncloseOverrideRenderBinDetails(0)
 {
     _identifier = new Identifier;
@@ -66,7 +71,12 @@ CullVisitor::CullVisitor(const CullVisitor& rhs):
     _computed_znear(FLT_MAX),
     _computed_zfar(-FLT_MAX),
     _traversalOrderNumber(0),
+    _traversalSubsetGroup(0),
+    _traversalSubsetBegin(0),
+    _traversalSubsetEnd(0),
+    _softwareOcclusionBuffer(rhs._softwareOcclusionBuffer),
     _currentReuseRenderLeafIndex(0),
+    _numberOfAssignedRenderLeaves(0),
     _numberOfEncloseOverrideRenderBinDetails(0),
     _identifier(rhs._identifier)
 {
@@ -75,6 +85,44 @@ CullVisitor::CullVisitor(const CullVisitor& rhs):
 CullVisitor::~CullVisitor()
 {
     reset();
+
+    for(RenderLeafBlockList::iterator itr = _renderLeafBlocks.begin();
+        itr != _renderLeafBlocks.end();
+        ++itr)
+    {
+        RenderLeaf* block = *itr;
+        bool referenced = false;
+        for(unsigned int i=0; i<RENDER_LEAF_BLOCK_SIZE; ++i)
+        {
+            if (block[i].referenceCount()>1) referenced = true;
+        }
+
+        if (referenced)
+        {
+            // a RenderLeaf is still held outside the CullVisitor, so leak the block rather than leave a dangling reference.
+            OSG_NOTICE<<"Warning: CullVisitor::~CullVisitor() RenderLeaf still referenced, unable to delete its block."<<std::endl;
+            continue;
+        }
+
+        for(unsigned int i=0; i<RENDER_LEAF_BLOCK_SIZE; ++i)
+        {
+            block[i].unref_nodelete();
+        }
+        delete [] block;
+    }
+}
+
+RenderLeaf* CullVisitor::createRenderLeafBlock()
+{
+    RenderLeaf* block = new RenderLeaf[RENDER_LEAF_BLOCK_SIZE];
+
+    // the block owns its RenderLeaf, so hold a reference to each to prevent the ref_ptr<> of a StateGraph from deleting it.
+    for(unsigned int i=0; i<RENDER_LEAF_BLOCK_SIZE; ++i)
+    {
+        block[i].ref();
+    }
+
+    return block;
 }
 
 osg::ref_ptr<CullVisitor>& CullVisitor::prototype()
@@ -106,6 +154,9 @@ void CullVisitor::reset()
     // reset the traversal order number
     _traversalOrderNumber = 0;
 
+    // traverse all children unless a subset is requested for this frame.
+    _traversalSubsetGroup = 0;
+
     // reset the calculated near far planes.
     _computed_znear = FLT_MAX;
     _computed_zfar = -FLT_MAX;
@@ -119,16 +170,16 @@ void CullVisitor::reset()
 
     _bbCornerNear = (~_bbCornerFar)&7;
 
-    // Only reset the RenderLeaf objects used last frame.
-    for(RenderLeafList::iterator itr=_reuseRenderLeafList.begin(),
-        iter_end=_reuseRenderLeafList.begin()+_currentReuseRenderLeafIndex;
-        itr!=iter_end;
-        ++itr)
+    // RenderLeaf used this frame are simply reassigned next frame, so only release the drawables and matrices
+    // still held by those beyond this frame's count, keeping the cost independent of the number of leaves.
+    for(unsigned int i=_currentReuseRenderLeafIndex; i<_numberOfAssignedRenderLeaves; ++i)
     {
-        (*itr)->reset();
+        RenderLeaf& renderleaf = _renderLeafBlocks[i / RENDER_LEAF_BLOCK_SIZE][i % RENDER_LEAF_BLOCK_SIZE];
+        if (renderleaf.referenceCount()==1) renderleaf.reset();
     }
 
-    // reset the resuse lists.
+    // rewind the RenderLeaf arena.
+    _numberOfAssignedRenderLeaves = _currentReuseRenderLeafIndex;
     _currentReuseRenderLeafIndex = 0;
 
     _nearPlaneCandidateMap.clear();
@@ -861,7 +912,7 @@ void CullVisitor::updateCalculatedNearFar(const osg::Vec3& pos)
 
 void CullVisitor::apply(Node& node)
 {
-    if (isCulled(node)) return;
+    if (isCulled(node) || isSoftwareOccluded(node)) return;
 
     // push the culling mode.
     pushCurrentMask();
@@ -882,7 +933,7 @@ void CullVisitor::apply(Node& node)
 
 void CullVisitor::apply(Geode& node)
 {
-    if (isCulled(node)) return;
+    if (isCulled(node) || isSoftwareOccluded(node)) return;
 
     // push the culling mode.
     pushCurrentMask();
@@ -919,7 +970,7 @@ void CullVisitor::apply(osg::Drawable& drawable)
         }
     }
 
-    if (drawable.isCullingActive() && isCulled(bb)) return;
+    if (drawable.isCullingActive() && (isCulled(bb) || isSoftwareOccluded(bb))) return;
 
 
     if (_computeNearFar && bb.valid())
@@ -1136,7 +1187,7 @@ void CullVisitor::apply(TexGenNode& node)
 
 void CullVisitor::apply(Group& node)
 {
-    if (isCulled(node)) return;
+    if (isCulled(node) || isSoftwareOccluded(node)) return;
 
     // push the culling mode.
     pushCurrentMask();
@@ -1145,7 +1196,9 @@ void CullVisitor::apply(Group& node)
     StateSet* node_state = node.getStateSet();
     if (node_state) pushStateSet(node_state);
 
-    handle_cull_callbacks_and_traverse(node);
+    if (&node==_traversalSubsetGroup) traverseSubset(node);
+    else if (!node.getCullCallback() && typeid(node)==typeid(osg::Group)) traverseChildren(node, 0, node.getNumChildren());
+    else handle_cull_callbacks_and_traverse(node);
 
     // pop the node's state off the render graph stack.
     if (node_state) popStateSet();
@@ -1154,9 +1207,72 @@ void CullVisitor::apply(Group& node)
     popCurrentMask();
 }
 
+void CullVisitor::traverseChildren(osg::Group& group, unsigned int begin, unsigned int end)
+{
+    end = osg::minimum(end, group.getNumChildren());
+
+    osg::CullingSet& cullingSet = getCurrentCullingSet();
+    const osg::Polytope::ClippingMask frustumMask = cullingSet.getFrustum().getCurrentMask();
+    if (end<begin+2 || !(cullingSet.getCullingMask() & osg::CullingSet::VIEW_FRUSTUM_CULLING) || !frustumMask)
+    {
+        for(unsigned int i=begin; i<end; ++i)
+        {
+            group.getChild(i)->accept(*this);
+        }
+        return;
+    }
+
+    // check the children with culling active against the frustum in one batch, the entries
+    // below base belong to the groups above this one in the traversal.
+    const unsigned int base = static_cast<unsigned int>(_batchCullChildren.size());
+    const unsigned int visibilityBase = static_cast<unsigned int>(_batchCullVisibility.size());
+    for(unsigned int i=begin; i<end; ++i)
+    {
+        osg::Node* child = group.getChild(i);
+        if (child->isCullingActive())
+        {
+            _batchCullChildren.push_back(child);
+            _batchCullBounds.push_back(child->getBound());
+        }
+    }
+
+    const unsigned int numBatched = static_cast<unsigned int>(_batchCullChildren.size())-base;
+    if (numBatched>0)
+    {
+        _batchCullResultMasks.resize(base+numBatched);
+        _batchCullVisibility.resize(visibilityBase+(numBatched+31)/32);
+        cullingSet.getFrustum().contains(&_batchCullBounds[base], numBatched, &_batchCullResultMasks[base], &_batchCullVisibility[visibilityBase]);
+    }
+
+    unsigned int batchIndex = 0;
+    for(unsigned int i=begin; i<end && i<group.getNumChildren(); ++i)
+    {
+        osg::Node* child = group.getChild(i);
+        if (batchIndex<numBatched && _batchCullChildren[base+batchIndex]==child)
+        {
+            // only pass on the result if the frustum it was computed against is still current.
+            if (&getCurrentCullingSet()==&cullingSet && cullingSet.getFrustum().getCurrentMask()==frustumMask)
+            {
+                bool contains = (_batchCullVisibility[visibilityBase+(batchIndex>>5)] & (1u<<(batchIndex&31)))!=0;
+                setFrustumCullHint(child, _batchCullBounds[base+batchIndex], contains, _batchCullResultMasks[base+batchIndex]);
+            }
+            ++batchIndex;
+        }
+
+        child->accept(*this);
+
+        clearFrustumCullHint();
+    }
+
+    _batchCullChildren.resize(base);
+    _batchCullBounds.resize(base);
+    _batchCullResultMasks.resize(base);
+    _batchCullVisibility.resize(visibilityBase);
+}
+
 void CullVisitor::apply(Transform& node)
 {
-    if (isCulled(node)) return;
+    if (isCulled(node) || isSoftwareOccluded(node)) return;
 
     // push the culling mode.
     pushCurrentMask();
@@ -1244,7 +1360,7 @@ void CullVisitor::apply(Switch& node)
 
 void CullVisitor::apply(LOD& node)
 {
-    if (isCulled(node)) return;
+    if (isCulled(node) || isSoftwareOccluded(node)) return;
 
     // push the culling mode.
     pushCurrentMask();
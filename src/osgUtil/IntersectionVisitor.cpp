@@ -16,6 +16,7 @@
 #include <osgUtil/LineSegmentIntersector>
 
 #include <osg/PagedLOD>
+#include <osg/BVHGroup>
 #include <osg/Transform>
 #include <osg/Projection>
 #include <osg/Camera>
@@ -101,6 +102,20 @@ void IntersectorGroup::leave()
     }
 }
 
+bool IntersectorGroup::intersects(const osg::BoundingBox& bb)
+{
+    if (disabled()) return false;
+
+    for(Intersectors::iterator itr = _intersectors.begin();
+        itr != _intersectors.end();
+        ++itr)
+    {
+        if (!(*itr)->disabled() && (*itr)->intersects(bb)) return true;
+    }
+
+    return false;
+}
+
 void IntersectorGroup::intersect(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable)
 {
     if (disabled()) return;
@@ -221,6 +236,36 @@ void IntersectionVisitor::apply(osg::Group& group)
     leave();
 }
 
+namespace
+{
+    struct IntersectorBoxTest
+    {
+        IntersectorBoxTest(Intersector* intersector): _intersector(intersector) {}
+
+        inline bool operator() (const osg::BoundingBox& bb) { return _intersector->intersects(bb); }
+
+        Intersector* _intersector;
+    };
+}
+
+void IntersectionVisitor::apply(osg::BVHGroup& group)
+{
+    if (!enter(group)) return;
+
+    // children with culling disabled are intersected whatever their bounds, so need visiting whatever the boxes of the tree.
+    if (group.getNumChildrenWithCullingDisabled()==0)
+    {
+        IntersectorBoxTest test(_intersectorStack.back().get());
+        group.traverse(*this, test);
+    }
+    else
+    {
+        traverse(group);
+    }
+
+    leave();
+}
+
 void IntersectionVisitor::apply(osg::Drawable& drawable)
 {
     intersect( &drawable );
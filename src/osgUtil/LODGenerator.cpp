@@ -0,0 +1,242 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+
+#include <osgUtil/LODGenerator>
+
+#include <osg/Geode>
+#include <osg/Billboard>
+#include <osg/PagedLOD>
+#include <osg/ValueObject>
+#include <osg/Notify>
+
+#include <algorithm>
+#include <sstream>
+#include <float.h>
+
+using namespace osgUtil;
+
+LODGenerator::LODGenerator():
+    osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+    _simplifier(new Simplifier),
+    _maximumPixelError(1.0f),
+    _rangeMode(osg::LOD::PIXEL_SIZE_ON_SCREEN),
+    _referenceHeight(1024.0f),
+    _referenceFovy(30.0f),
+    _usePagedLOD(false),
+    _fileNamePrefix("lod_"),
+    _fileNameExtension("osgb"),
+    _traversalDepth(0),
+    _numLODsGenerated(0)
+{
+    _sampleRatios.push_back(0.5f);
+    _sampleRatios.push_back(0.25f);
+    _sampleRatios.push_back(0.125f);
+}
+
+void LODGenerator::apply(osg::Node& node)
+{
+    ++_traversalDepth;
+    traverse(node);
+    --_traversalDepth;
+
+    if (_traversalDepth==0 && !_nodes.empty()) generateLODs();
+}
+
+void LODGenerator::apply(osg::LOD&)
+{
+}
+
+void LODGenerator::apply(osg::Billboard&)
+{
+    // copying a Billboard as a Geode would lose its per drawable positions, so leave it as it is.
+}
+
+void LODGenerator::apply(osg::Geode& geode)
+{
+    _nodes.push_back(&geode);
+
+    if (_traversalDepth==0) generateLODs();
+}
+
+void LODGenerator::apply(osg::Geometry& geometry)
+{
+    _nodes.push_back(&geometry);
+
+    if (_traversalDepth==0) generateLODs();
+}
+
+void LODGenerator::generateLODs()
+{
+    // nodes shared between several parents are only replaced once.
+    std::sort(_nodes.begin(), _nodes.end());
+    _nodes.erase(std::unique(_nodes.begin(), _nodes.end()), _nodes.end());
+
+    unsigned int numLevels = static_cast<unsigned int>(_sampleRatios.size())+1;
+
+    for(NodeList::iterator itr = _nodes.begin(); itr != _nodes.end(); ++itr)
+    {
+        osg::Node* node = itr->get();
+        if (node->getNumParents()==0)
+        {
+            OSG_INFO<<"LODGenerator::generateLODs() cannot replace node without parents."<<std::endl;
+            continue;
+        }
+
+        // the levels run from the original to the coarsest, each with the largest error of its geometries.
+        NodeList levels(1, node);
+        std::vector<float> errors(numLevels, 0.0f);
+
+        if (osg::Geode* geode = node->asGeode())
+        {
+            for(unsigned int i=1; i<numLevels; ++i)
+            {
+                levels.push_back(new osg::Geode(*geode, osg::CopyOp::DEEP_COPY_USERDATA));
+            }
+
+            bool simplified = false;
+            for(unsigned int d=0; d<geode->getNumDrawables(); ++d)
+            {
+                osg::Geometry* geometry = geode->getDrawable(d)->asGeometry();
+                if (!geometry) continue;
+
+                Simplifier::GeometryList geometryLevels;
+                Simplifier::ErrorList geometryErrors;
+                _simplifier->simplify(*geometry, _sampleRatios, geometryLevels, geometryErrors);
+                if (geometryLevels.size()!=numLevels-1) continue;
+
+                for(unsigned int i=1; i<numLevels; ++i)
+                {
+                    levels[i]->asGeode()->setDrawable(d, geometryLevels[i-1].get());
+                    errors[i] = osg::maximum(errors[i], geometryErrors[i-1]);
+                }
+                simplified = true;
+            }
+
+            if (!simplified) continue;
+        }
+        else if (osg::Geometry* geometry = node->asGeometry())
+        {
+            Simplifier::GeometryList geometryLevels;
+            Simplifier::ErrorList geometryErrors;
+            _simplifier->simplify(*geometry, _sampleRatios, geometryLevels, geometryErrors);
+            if (geometryLevels.size()!=numLevels-1) continue;
+
+            for(unsigned int i=1; i<numLevels; ++i)
+            {
+                levels.push_back(geometryLevels[i-1].get());
+                errors[i] = geometryErrors[i-1];
+            }
+        }
+        else continue;
+
+        // drop levels that are no further from the original than the finer level before them, as they
+        // would get an empty range or share the finer level's range and be drawn along with it.
+        unsigned int numKept = 1;
+        for(unsigned int i=1; i<numLevels; ++i)
+        {
+            if (errors[i]<=errors[numKept-1]) continue;
+
+            levels[numKept] = levels[i];
+            errors[numKept] = errors[i];
+            ++numKept;
+        }
+        levels.resize(numKept);
+        errors.resize(numKept);
+
+        if (numKept==1)
+        {
+            OSG_INFO<<"LODGenerator::generateLODs() simplification introduced no error, leaving "<<node->className()<<" as it is."<<std::endl;
+            continue;
+        }
+
+        // take a copy of the parents before the node is added to the LOD, as replacing the node removes them from its list.
+        osg::Node::ParentList parents = node->getParents();
+
+        osg::ref_ptr<osg::LOD> lod = createLOD(*node, levels, errors);
+
+        for(osg::Node::ParentList::iterator pitr = parents.begin(); pitr != parents.end(); ++pitr)
+        {
+            (*pitr)->replaceChild(node, lod.get());
+        }
+
+        ++_numLODsGenerated;
+    }
+
+    _nodes.clear();
+}
+
+osg::LOD* LODGenerator::createLOD(osg::Node& node, const NodeList& levels, const std::vector<float>& errors)
+{
+    const osg::BoundingSphere& bs = node.getBound();
+
+    osg::ref_ptr<osg::LOD> lod;
+    osg::PagedLOD* pagedLOD = 0;
+    if (_usePagedLOD)
+    {
+        // the bound of a PagedLOD must cover the levels yet to be loaded.
+        pagedLOD = new osg::PagedLOD;
+        pagedLOD->setCenter(bs.center());
+        pagedLOD->setRadius(bs.radius());
+        lod = pagedLOD;
+    }
+    else
+    {
+        lod = new osg::LOD;
+    }
+
+    lod->setName(node.getName());
+    lod->setRangeMode(_rangeMode);
+    lod->setUserValue("MaximumPixelError", _maximumPixelError);
+
+    // a level's error covers error*pixelSize/(2*radius) pixels when the LOD's diameter covers pixelSize pixels,
+    // as measured by CullStack::clampedPixelSize(), or error*pixelsPerRadian/distance pixels at a distance.
+    double pixelsPerRadian = _referenceHeight/(2.0*tan(osg::DegreesToRadians(_referenceFovy)*0.5));
+    double radius = bs.radius();
+
+    // add the levels coarsest first, so that the coarsest is held inline by a PagedLOD.
+    unsigned int coarsestLevel = static_cast<unsigned int>(levels.size())-1;
+    for(int i=coarsestLevel; i>=0; --i)
+    {
+        double error = errors[i];
+        double coarserError = i<static_cast<int>(coarsestLevel) ? errors[i+1] : 0.0;
+
+        float minRange, maxRange;
+        if (_rangeMode==osg::LOD::PIXEL_SIZE_ON_SCREEN)
+        {
+            minRange = coarserError>0.0 ? static_cast<float>(_maximumPixelError*2.0*radius/coarserError) : 0.0f;
+            maxRange = error>0.0 ? static_cast<float>(_maximumPixelError*2.0*radius/error) : FLT_MAX;
+        }
+        else
+        {
+            minRange = static_cast<float>(error*pixelsPerRadian/_maximumPixelError);
+            maxRange = i<static_cast<int>(coarsestLevel) ? static_cast<float>(coarserError*pixelsPerRadian/_maximumPixelError) : FLT_MAX;
+        }
+
+        osg::Node* level = levels[i].get();
+        level->setUserValue("GeometricError", errors[i]);
+
+        unsigned int childNo = lod->getNumChildren();
+        lod->addChild(level, minRange, maxRange);
+
+        if (pagedLOD && childNo>0)
+        {
+            std::ostringstream fileName;
+            fileName<<_fileNamePrefix<<_numLODsGenerated<<"_"<<i<<"."<<_fileNameExtension;
+            pagedLOD->setFileName(childNo, fileName.str());
+        }
+    }
+
+    OSG_INFO<<"LODGenerator::createLOD() generated "<<levels.size()<<" levels for "<<node.className()<<" with errors up to "<<errors.back()<<std::endl;
+
+    return lod.release();
+}
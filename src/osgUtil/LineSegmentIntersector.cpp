@@ -501,6 +501,14 @@ void LineSegmentIntersector::leave()
     // do nothing
 }
 
+bool LineSegmentIntersector::intersects(const osg::BoundingBox& bb)
+{
+    if (reachedLimit()) return false;
+
+    osg::Vec3d s(_start), e(_end);
+    return intersectAndClip( s, e, bb );
+}
+
 void LineSegmentIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable)
 {
     if (reachedLimit()) return;
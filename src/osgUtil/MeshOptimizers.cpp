@@ -20,6 +20,8 @@
 
 #include <iostream>
 
+#include <osg/BVHGroup>
+#include <osg/ClusterCullingCallback>
 #include <osg/Geometry>
 #include <osg/Math>
 #include <osg/PrimitiveSet>
@@ -1247,4 +1249,252 @@ void SharedArrayOptimizer::deduplicateUVs(osg::Geometry& geometry)
     }
 }
 
+void ClusterMeshVisitor::buildClusters()
+{
+    for (GeometryList::iterator itr = _geometryList.begin(), end = _geometryList.end();
+         itr != end;
+         ++itr)
+    {
+        buildClusters(*(*itr));
+    }
+}
+
+namespace
+{
+inline bool isTriangleMode(GLenum mode)
+{
+    return mode == PrimitiveSet::TRIANGLES || mode == PrimitiveSet::TRIANGLE_STRIP
+        || mode == PrimitiveSet::TRIANGLE_FAN || mode == PrimitiveSet::QUADS
+        || mode == PrimitiveSet::QUAD_STRIP || mode == PrimitiveSet::POLYGON;
+}
+
+// Grow clusters of triangles across the mesh, each starting from a
+// seed triangle and taking in the adjacent triangle that adds the
+// fewest new vertices, nearest the cluster's centre, until the
+// cluster is full or has no neighbours left.
+struct ClusterBuilder
+{
+    typedef std::vector<IndexList> ClusterList;
+
+    ClusterBuilder(const Vec3Array& vertices, const IndexList& indices)
+        : _vertices(vertices), _indices(indices),
+          _numTriangles(static_cast<unsigned>(indices.size() / 3))
+    {
+        // triangles using each vertex, in compressed rows.
+        unsigned numVertices = static_cast<unsigned>(vertices.size());
+        _offsets.resize(numVertices + 1, 0);
+        for (IndexList::const_iterator itr = indices.begin(); itr != indices.end(); ++itr)
+            ++_offsets[*itr + 1];
+        for (unsigned i = 0; i < numVertices; ++i)
+            _offsets[i + 1] += _offsets[i];
+        _adjacency.resize(indices.size());
+        IndexList fill(_offsets.begin(), _offsets.end() - 1);
+        for (unsigned i = 0; i < indices.size(); ++i)
+            _adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    void build(unsigned maxVertices, unsigned maxTriangles, ClusterList& clusters)
+    {
+        const unsigned invalid = std::numeric_limits<unsigned>::max();
+        std::vector<bool> assigned(_numTriangles, false);
+        IndexList vertexStamp(_vertices.size(), invalid);
+        IndexList triangleStamp(_numTriangles, invalid);
+        IndexList candidates;
+        unsigned nextUnassigned = 0;
+        unsigned seed = 0;
+
+        while (seed != invalid)
+        {
+            unsigned clusterNo = static_cast<unsigned>(clusters.size());
+            clusters.push_back(IndexList());
+            IndexList& cluster = clusters.back();
+            candidates.clear();
+            unsigned numVertices = 0;
+            Vec3 centroidSum;
+
+            unsigned triangle = seed;
+            while (triangle != invalid)
+            {
+                assigned[triangle] = true;
+                for (unsigned i = 0; i < 3; ++i)
+                {
+                    unsigned v = _indices[triangle * 3 + i];
+                    cluster.push_back(v);
+                    if (vertexStamp[v] == clusterNo)
+                        continue;
+                    vertexStamp[v] = clusterNo;
+                    ++numVertices;
+                    centroidSum += _vertices[v];
+                    for (unsigned a = _offsets[v]; a < _offsets[v + 1]; ++a)
+                    {
+                        unsigned t = _adjacency[a];
+                        if (!assigned[t] && triangleStamp[t] != clusterNo)
+                        {
+                            triangleStamp[t] = clusterNo;
+                            candidates.push_back(t);
+                        }
+                    }
+                }
+                if (cluster.size() / 3 >= maxTriangles)
+                    break;
+
+                Vec3 centroid = centroidSum / static_cast<float>(numVertices);
+                triangle = invalid;
+                unsigned bestNewVertices = 4;
+                float bestDistance = 0.0f;
+                IndexList::iterator last = candidates.begin();
+                for (IndexList::iterator itr = candidates.begin(); itr != candidates.end(); ++itr)
+                {
+                    unsigned t = *itr;
+                    if (assigned[t])
+                        continue;
+                    *last++ = t;
+                    unsigned newVertices = 0;
+                    for (unsigned i = 0; i < 3; ++i)
+                        if (vertexStamp[_indices[t * 3 + i]] != clusterNo)
+                            ++newVertices;
+                    if (numVertices + newVertices > maxVertices || newVertices > bestNewVertices)
+                        continue;
+                    float distance = (triangleCenter(t) - centroid).length2();
+                    if (newVertices < bestNewVertices || distance < bestDistance)
+                    {
+                        triangle = t;
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+                candidates.erase(last, candidates.end());
+            }
+
+            // continue from a neighbour of the last cluster if there
+            // is one, to keep the clusters in spatial order.
+            seed = invalid;
+            for (IndexList::iterator itr = candidates.begin(); itr != candidates.end(); ++itr)
+            {
+                if (!assigned[*itr])
+                {
+                    seed = *itr;
+                    break;
+                }
+            }
+            if (seed == invalid)
+            {
+                while (nextUnassigned < _numTriangles && assigned[nextUnassigned])
+                    ++nextUnassigned;
+                if (nextUnassigned < _numTriangles)
+                    seed = nextUnassigned;
+            }
+        }
+    }
+
+    Vec3 triangleCenter(unsigned t) const
+    {
+        return (_vertices[_indices[t * 3]] + _vertices[_indices[t * 3 + 1]]
+                + _vertices[_indices[t * 3 + 2]]) / 3.0f;
+    }
+
+    const Vec3Array& _vertices;
+    const IndexList& _indices;
+    unsigned _numTriangles;
+    IndexList _offsets;
+    IndexList _adjacency;
+};
+}
+
+void ClusterMeshVisitor::buildClusters(Geometry& geom)
+{
+    if (!isOperationPermissibleForObject(&geom) || geom.getNumParents() == 0)
+        return;
+
+    if (geom.containsDeprecatedData()) geom.fixDeprecatedData();
+
+    if (osg::getBinding(geom.getNormalArray())==osg::Array::BIND_PER_PRIMITIVE_SET) return;
+
+    if (osg::getBinding(geom.getColorArray())==osg::Array::BIND_PER_PRIMITIVE_SET) return;
+
+    if (osg::getBinding(geom.getSecondaryColorArray())==osg::Array::BIND_PER_PRIMITIVE_SET) return;
+
+    if (osg::getBinding(geom.getFogCoordArray())==osg::Array::BIND_PER_PRIMITIVE_SET) return;
+
+    const Vec3Array* vertices = dynamic_cast<const Vec3Array*>(geom.getVertexArray());
+    if (!vertices || vertices->empty())
+        return;
+
+    // lines and points would be lost from the clusters.
+    Geometry::PrimitiveSetList& primSets = geom.getPrimitiveSetList();
+    for (Geometry::PrimitiveSetList::iterator itr = primSets.begin(), end = primSets.end();
+         itr != end;
+         ++itr)
+    {
+        if (!isTriangleMode((*itr)->getMode()))
+            return;
+    }
+
+    MyTriangleIndexFunctor collectTriangles;
+    geom.accept(collectTriangles);
+    IndexList& indices = collectTriangles._in_indices;
+    if (indices.size() / 3 <= _maximumTriangles)
+        return;
+
+    ClusterBuilder::ClusterList clusterIndices;
+    ClusterBuilder builder(*vertices, indices);
+    builder.build(osg::maximum(_maximumVertices, 3u), osg::maximum(_maximumTriangles, 1u), clusterIndices);
+
+    // the clusters share all of the original's arrays and state.
+    std::vector< ref_ptr<Geometry> > clusters;
+    for (ClusterBuilder::ClusterList::iterator citr = clusterIndices.begin(), cend = clusterIndices.end();
+         citr != cend;
+         ++citr)
+    {
+        ref_ptr<Geometry> cluster = new Geometry(geom, CopyOp::SHALLOW_COPY);
+        cluster->removePrimitiveSet(0, cluster->getNumPrimitiveSets());
+
+        unsigned maxIndex = *std::max_element(citr->begin(), citr->end());
+        if (maxIndex <= std::numeric_limits<GLushort>::max())
+            cluster->addPrimitiveSet(new DrawElementsUShort(PrimitiveSet::TRIANGLES, citr->begin(), citr->end()));
+        else
+            cluster->addPrimitiveSet(new DrawElementsUInt(PrimitiveSet::TRIANGLES, citr->begin(), citr->end()));
+
+        if (_normalConeCulling && !cluster->getCullCallback())
+            cluster->setCullCallback(new ClusterCullingCallback(cluster.get()));
+
+        clusters.push_back(cluster);
+    }
+
+    // take a copy of the parents, as replacing the geometry removes them from its list.
+    ref_ptr<Geometry> original = &geom;
+    Node::ParentList parents = geom.getParents();
+    ref_ptr<BVHGroup> clusterGroup;
+    for (Node::ParentList::iterator pitr = parents.begin(), pend = parents.end();
+         pitr != pend;
+         ++pitr)
+    {
+        Group* parent = *pitr;
+        if (parent->asGeode())
+        {
+            unsigned pos = parent->getChildIndex(&geom);
+            if (pos >= parent->getNumChildren())
+                continue;
+            parent->setChild(pos, clusters[0].get());
+            for (unsigned i = 1; i < clusters.size(); ++i)
+                parent->insertChild(pos + i, clusters[i].get());
+        }
+        else
+        {
+            if (!clusterGroup.valid())
+            {
+                clusterGroup = new BVHGroup;
+                clusterGroup->setName(geom.getName());
+                for (unsigned i = 0; i < clusters.size(); ++i)
+                    clusterGroup->addChild(clusters[i].get());
+            }
+            parent->replaceChild(&geom, clusterGroup.get());
+        }
+    }
+
+    _numClusters += static_cast<unsigned>(clusters.size());
+
+    OSG_INFO<<"ClusterMeshVisitor::buildClusters() split "<<indices.size() / 3<<" triangles into "<<clusters.size()<<" clusters"<<std::endl;
+}
+
 }
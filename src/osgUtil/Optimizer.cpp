@@ -33,6 +33,8 @@
 #include <osg/ImageStream>
 #include <osg/Timer>
 #include <osg/TexMat>
+#include <osg/TexGen>
+#include <osg/ClusterCullingCallback>
 #include <osg/io_utils>
 
 #include <osgUtil/TransformAttributeFunctor>
@@ -53,7 +55,7 @@ void Optimizer::reset()
 {
 }
 
-static osg::ApplicationUsageProxy Optimizer_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER \"<type> [<type>]\"","OFF | DEFAULT | FLATTEN_STATIC_TRANSFORMS | FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS | REMOVE_REDUNDANT_NODES | COMBINE_ADJACENT_LODS | SHARE_DUPLICATE_STATE | MERGE_GEOMETRY | MERGE_GEODES | SPATIALIZE_GROUPS  | COPY_SHARED_NODES | OPTIMIZE_TEXTURE_SETTINGS | REMOVE_LOADED_PROXY_NODES | TESSELLATE_GEOMETRY | CHECK_GEOMETRY |  FLATTEN_BILLBOARDS | TEXTURE_ATLAS_BUILDER | STATIC_OBJECT_DETECTION | INDEX_MESH | VERTEX_POSTTRANSFORM | VERTEX_PRETRANSFORM | BUFFER_OBJECT_SETTINGS");
+static osg::ApplicationUsageProxy Optimizer_e0(osg::ApplicationUsage::ENVIRONMENTAL_VARIABLE,"OSG_OPTIMIZER \"<type> [<type>]\"","OFF | DEFAULT | FLATTEN_STATIC_TRANSFORMS | FLATTEN_STATIC_TRANSFORMS_DUPLICATING_SHARED_SUBGRAPHS | REMOVE_REDUNDANT_NODES | COMBINE_ADJACENT_LODS | SHARE_DUPLICATE_STATE | MERGE_GEOMETRY | MERGE_GEODES | SPATIALIZE_GROUPS  | COPY_SHARED_NODES | OPTIMIZE_TEXTURE_SETTINGS | REMOVE_LOADED_PROXY_NODES | TESSELLATE_GEOMETRY | CHECK_GEOMETRY |  FLATTEN_BILLBOARDS | TEXTURE_ATLAS_BUILDER | STATIC_OBJECT_DETECTION | INDEX_MESH | VERTEX_POSTTRANSFORM | VERTEX_PRETRANSFORM | CLUSTER_MESH | QUANTIZE_GEOMETRY | BUFFER_OBJECT_SETTINGS");
 
 void Optimizer::optimize(osg::Node* node)
 {
@@ -130,6 +132,12 @@ void Optimizer::optimize(osg::Node* node)
         if(str.find("~VERTEX_PRETRANSFORM")!=std::string::npos) options ^= VERTEX_PRETRANSFORM;
         else if(str.find("VERTEX_PRETRANSFORM")!=std::string::npos) options |= VERTEX_PRETRANSFORM;
 
+        if(str.find("~CLUSTER_MESH")!=std::string::npos) options ^= CLUSTER_MESH;
+        else if(str.find("CLUSTER_MESH")!=std::string::npos) options |= CLUSTER_MESH;
+
+        if(str.find("~QUANTIZE_GEOMETRY")!=std::string::npos) options ^= QUANTIZE_GEOMETRY;
+        else if(str.find("QUANTIZE_GEOMETRY")!=std::string::npos) options |= QUANTIZE_GEOMETRY;
+
         if(str.find("~BUFFER_OBJECT_SETTINGS")!=std::string::npos) options ^= BUFFER_OBJECT_SETTINGS;
         else if(str.find("BUFFER_OBJECT_SETTINGS")!=std::string::npos) options |= BUFFER_OBJECT_SETTINGS;
     }
@@ -362,6 +370,23 @@ void Optimizer::optimize(osg::Node* node, unsigned int options)
         vaov.optimizeOrder();
     }
 
+    if (options & CLUSTER_MESH)
+    {
+        OSG_INFO<<"Optimizer::optimize() doing CLUSTER_MESH"<<std::endl;
+        ClusterMeshVisitor cmv(this);
+        node->accept(cmv);
+        cmv.buildClusters();
+    }
+
+    if (options & QUANTIZE_GEOMETRY)
+    {
+        OSG_INFO<<"Optimizer::optimize() doing QUANTIZE_GEOMETRY"<<std::endl;
+        QuantizeGeometryVisitor qgv(this);
+        node->accept(qgv);
+        qgv.quantize();
+        OSG_INFO<<"Optimizer::optimize() quantization saved "<<qgv.getNumBytesSaved()<<" bytes"<<std::endl;
+    }
+
     if (options & BUFFER_OBJECT_SETTINGS)
     {
         OSG_INFO<<"Optimizer::optimize() doing BUFFER_OBJECT_SETTINGS"<<std::endl;
@@ -403,10 +428,15 @@ struct LessDerefFunctor
     }
 };
 
+/** Order StateSets by their cached hash first so that most comparisons avoid walking the StateSet contents,
+  * equal StateSets share a hash so still end up next to each other.*/
 struct LessStateSetFunctor
 {
     bool operator () (const osg::StateSet* lhs,const osg::StateSet* rhs) const
     {
+        uint64_t lhs_hash = lhs->getHash();
+        uint64_t rhs_hash = rhs->getHash();
+        if (lhs_hash!=rhs_hash) return lhs_hash<rhs_hash;
         return (*lhs<*rhs);
     }
 };
@@ -625,7 +655,7 @@ void Optimizer::StateVisitor::optimize()
 
         // sort the StateSet's so that equal StateSet's sit along side each
         // other.
-        std::sort(statesetSortList.begin(),statesetSortList.end(),LessDerefFunctor<osg::StateSet>());
+        std::sort(statesetSortList.begin(),statesetSortList.end(),LessStateSetFunctor());
 
         OSG_INFO << "searching for duplicate attributes"<< std::endl;
         // find the duplicates.
@@ -1599,107 +1629,6 @@ void Optimizer::CombineLODsVisitor::combineLODs()
 // code to merge geometry object which share, state, and attribute bindings.
 ////////////////////////////////////////////////////////////////////////////
 
-#define COMPARE_BINDING(lhs, rhs) \
-        if (osg::getBinding(lhs)<osg::getBinding(rhs)) return true; \
-        if (osg::getBinding(rhs)<osg::getBinding(lhs)) return false;
-
-
-struct LessGeometry
-{
-    bool operator() (const osg::ref_ptr<osg::Geometry>& lhs,const osg::ref_ptr<osg::Geometry>& rhs) const
-    {
-        if (lhs->getStateSet()<rhs->getStateSet()) return true;
-        if (rhs->getStateSet()<lhs->getStateSet()) return false;
-
-        COMPARE_BINDING(lhs->getNormalArray(), rhs->getNormalArray())
-        COMPARE_BINDING(lhs->getColorArray(), rhs->getColorArray())
-        COMPARE_BINDING(lhs->getSecondaryColorArray(), rhs->getSecondaryColorArray())
-        COMPARE_BINDING(lhs->getFogCoordArray(), rhs->getFogCoordArray())
-
-
-        if (lhs->getNumTexCoordArrays()<rhs->getNumTexCoordArrays()) return true;
-        if (rhs->getNumTexCoordArrays()<lhs->getNumTexCoordArrays()) return false;
-
-        // therefore lhs->getNumTexCoordArrays()==rhs->getNumTexCoordArrays()
-
-        unsigned int i;
-        for(i=0;i<lhs->getNumTexCoordArrays();++i)
-        {
-            if (rhs->getTexCoordArray(i))
-            {
-                if (!lhs->getTexCoordArray(i)) return true;
-            }
-            else if (lhs->getTexCoordArray(i)) return false;
-        }
-
-        for(i=0;i<lhs->getNumVertexAttribArrays();++i)
-        {
-            if (rhs->getVertexAttribArray(i))
-            {
-                if (!lhs->getVertexAttribArray(i)) return true;
-            }
-            else if (lhs->getVertexAttribArray(i)) return false;
-        }
-
-
-        if (osg::getBinding(lhs->getNormalArray())==osg::Array::BIND_OVERALL)
-        {
-            // assumes that the bindings and arrays are set up correctly, this
-            // should be the case after running computeCorrectBindingsAndArraySizes();
-            const osg::Array* lhs_normalArray = lhs->getNormalArray();
-            const osg::Array* rhs_normalArray = rhs->getNormalArray();
-            if (lhs_normalArray->getType()<rhs_normalArray->getType()) return true;
-            if (rhs_normalArray->getType()<lhs_normalArray->getType()) return false;
-            switch(lhs_normalArray->getType())
-            {
-            case(osg::Array::Vec3bArrayType):
-                if ((*static_cast<const osg::Vec3bArray*>(lhs_normalArray))[0]<(*static_cast<const osg::Vec3bArray*>(rhs_normalArray))[0]) return true;
-                if ((*static_cast<const osg::Vec3bArray*>(rhs_normalArray))[0]<(*static_cast<const osg::Vec3bArray*>(lhs_normalArray))[0]) return false;
-                break;
-            case(osg::Array::Vec3sArrayType):
-                if ((*static_cast<const osg::Vec3sArray*>(lhs_normalArray))[0]<(*static_cast<const osg::Vec3sArray*>(rhs_normalArray))[0]) return true;
-                if ((*static_cast<const osg::Vec3sArray*>(rhs_normalArray))[0]<(*static_cast<const osg::Vec3sArray*>(lhs_normalArray))[0]) return false;
-                break;
-            case(osg::Array::Vec3ArrayType):
-                if ((*static_cast<const osg::Vec3Array*>(lhs_normalArray))[0]<(*static_cast<const osg::Vec3Array*>(rhs_normalArray))[0]) return true;
-                if ((*static_cast<const osg::Vec3Array*>(rhs_normalArray))[0]<(*static_cast<const osg::Vec3Array*>(lhs_normalArray))[0]) return false;
-                break;
-            default:
-                break;
-            }
-        }
-
-        if (osg::getBinding(lhs->getColorArray())==osg::Array::BIND_OVERALL)
-        {
-            const osg::Array* lhs_colorArray = lhs->getColorArray();
-            const osg::Array* rhs_colorArray = rhs->getColorArray();
-            if (lhs_colorArray->getType()<rhs_colorArray->getType()) return true;
-            if (rhs_colorArray->getType()<lhs_colorArray->getType()) return false;
-            switch(lhs_colorArray->getType())
-            {
-                case(osg::Array::Vec4ubArrayType):
-                    if ((*static_cast<const osg::Vec4ubArray*>(lhs_colorArray))[0]<(*static_cast<const osg::Vec4ubArray*>(rhs_colorArray))[0]) return true;
-                    if ((*static_cast<const osg::Vec4ubArray*>(rhs_colorArray))[0]<(*static_cast<const osg::Vec4ubArray*>(lhs_colorArray))[0]) return false;
-                    break;
-                case(osg::Array::Vec3ArrayType):
-                    if ((*static_cast<const osg::Vec3Array*>(lhs_colorArray))[0]<(*static_cast<const osg::Vec3Array*>(rhs_colorArray))[0]) return true;
-                    if ((*static_cast<const osg::Vec3Array*>(rhs_colorArray))[0]<(*static_cast<const osg::Vec3Array*>(lhs_colorArray))[0]) return false;
-                    break;
-                case(osg::Array::Vec4ArrayType):
-                    if ((*static_cast<const osg::Vec4Array*>(lhs_colorArray))[0]<(*static_cast<const osg::Vec4Array*>(rhs_colorArray))[0]) return true;
-                    if ((*static_cast<const osg::Vec4Array*>(rhs_colorArray))[0]<(*static_cast<const osg::Vec4Array*>(lhs_colorArray))[0]) return false;
-                    break;
-                default:
-                    break;
-            }
-
-        }
-
-        return false;
-
-    }
-};
-
 struct LessGeometryPrimitiveType
 {
     bool operator() (const osg::ref_ptr<osg::Geometry>& lhs,const osg::ref_ptr<osg::Geometry>& rhs) const
@@ -1733,45 +1662,73 @@ void Optimizer::MakeFastGeometryVisitor::apply(osg::Geometry& geom)
 /// Shortcut to get size of an array, even if pointer is NULL.
 inline unsigned int getSize(const osg::Array * a) { return a ? a->getNumElements() : 0; }
 
-/// When merging geometries, tests if two arrays can be merged, regarding to their number of components, and the number of vertices.
-bool isArrayCompatible(unsigned int numVertice1, unsigned int numVertice2, const osg::Array* compare1, const osg::Array* compare2)
+/** Key of the properties that geometries must share to be merged: their StateSet and, for each of their arrays, its type,
+  * binding, normalization and any value bound overall. Keys are compared by a hash of their contents first, so that bucketing
+  * many geometries costs little more than computing a key for each.*/
+struct GeometryMergeKey
 {
-    // Sumed up truth table:
-    //  If array (1 or 2) not empty and vertices empty => error, should not happen (allows simplification in formulae below)
-    //  If one side has both vertices and array, and the other side has only vertices => then arrays cannot be merged
-    //  Else, arrays can be merged
-    //assert(numVertice1 || !getSize(compare1));
-    //assert(numVertice2 || !getSize(compare2));
-    return !(   (numVertice1 && !getSize(compare1) && getSize(compare2))
-             || (numVertice2 && !getSize(compare2) && getSize(compare1)) );
-}
+    GeometryMergeKey(const osg::Geometry& geometry):
+        _hash(2166136261u)
+    {
+        addValue(geometry.getStateSet());
 
-/// Return true only if both geometries have same array type and if arrays (such as TexCoords) are compatible (i.e. both empty or both filled)
-bool isAbleToMerge(const osg::Geometry& g1, const osg::Geometry& g2)
-{
-    unsigned int numVertice1( getSize(g1.getVertexArray()) );
-    unsigned int numVertice2( getSize(g2.getVertexArray()) );
+        addArray(geometry.getVertexArray());
+        addArray(geometry.getNormalArray());
+        addArray(geometry.getColorArray());
+        addArray(geometry.getSecondaryColorArray());
+        addArray(geometry.getFogCoordArray());
+
+        addValue(geometry.getNumTexCoordArrays());
+        for(unsigned int unit=0; unit<geometry.getNumTexCoordArrays(); ++unit)
+        {
+            addArray(geometry.getTexCoordArray(unit));
+        }
 
-    // first verify arrays size
-    if (!isArrayCompatible(numVertice1,numVertice2,g1.getNormalArray(),g2.getNormalArray()) ||
-        !isArrayCompatible(numVertice1,numVertice2,g1.getColorArray(),g2.getColorArray()) ||
-        !isArrayCompatible(numVertice1,numVertice2,g1.getSecondaryColorArray(),g2.getSecondaryColorArray()) ||
-        !isArrayCompatible(numVertice1,numVertice2,g1.getFogCoordArray(),g2.getFogCoordArray()) ||
-        g1.getNumTexCoordArrays()!=g2.getNumTexCoordArrays()) return false;
+        addValue(geometry.getNumVertexAttribArrays());
+        for(unsigned int index=0; index<geometry.getNumVertexAttribArrays(); ++index)
+        {
+            addArray(geometry.getVertexAttribArray(index));
+        }
+    }
 
-    for (unsigned int eachTexCoordArray=0;eachTexCoordArray<g1.getNumTexCoordArrays();++eachTexCoordArray)
+    void addArray(const osg::Array* array)
     {
-        if (!isArrayCompatible(numVertice1,numVertice2,g1.getTexCoordArray(eachTexCoordArray),g2.getTexCoordArray(eachTexCoordArray))) return false;
+        if (!array || array->getNumElements()==0)
+        {
+            addValue(0);
+            return;
+        }
+
+        addValue(array->getType());
+        addValue(array->getBinding());
+        addValue(array->getNormalize());
+
+        // arrays bound overall are kept from the first of the geometries merged, so must all hold the same value.
+        if (array->getBinding()==osg::Array::BIND_OVERALL) addBytes(array->getDataPointer(), array->getElementSize());
     }
 
-    // then verify data type compatibility
-    if (g1.getVertexArray() && g2.getVertexArray() && g1.getVertexArray()->getDataType()!=g2.getVertexArray()->getDataType()) return false;
-    if (g1.getNormalArray() && g2.getNormalArray() && g1.getNormalArray()->getDataType()!=g2.getNormalArray()->getDataType()) return false;
-    if (g1.getColorArray() && g2.getColorArray() && g1.getColorArray()->getDataType()!=g2.getColorArray()->getDataType()) return false;
-    if (g1.getSecondaryColorArray() && g2.getSecondaryColorArray() && g1.getSecondaryColorArray()->getDataType()!=g2.getSecondaryColorArray()->getDataType()) return false;
-    if (g1.getFogCoordArray() && g2.getNormalArray() && g1.getFogCoordArray()->getDataType()!=g2.getFogCoordArray()->getDataType()) return false;
-    return true;
-}
+    template<typename T>
+    void addValue(const T& value) { addBytes(&value, sizeof(T)); }
+
+    void addBytes(const GLvoid* data, unsigned int size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        _data.append(bytes, size);
+        for(unsigned int i=0; i<size; ++i)
+        {
+            _hash = (_hash ^ static_cast<unsigned char>(bytes[i]))*16777619u;
+        }
+    }
+
+    bool operator < (const GeometryMergeKey& rhs) const
+    {
+        if (_hash!=rhs._hash) return _hash<rhs._hash;
+        return _data<rhs._data;
+    }
+
+    unsigned int    _hash;
+    std::string     _data;
+};
 
 bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
 {
@@ -1780,13 +1737,12 @@ bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
     if (group.getNumChildren()>=2)
     {
 
-        typedef std::vector< osg::ref_ptr<osg::Geometry> >                          DuplicateList;
-        typedef std::vector< osg::ref_ptr<osg::Node> >                              Nodes;
-        typedef std::map< osg::ref_ptr<osg::Geometry> ,DuplicateList,LessGeometry>  GeometryDuplicateMap;
-
-        typedef std::vector<DuplicateList> MergeList;
+        typedef std::vector< osg::ref_ptr<osg::Node> >      Nodes;
+        typedef std::map< GeometryMergeKey, GeometryList >  GeometryBucketMap;
+        typedef std::vector<GeometryList>                   MergeList;
 
-        GeometryDuplicateMap geometryDuplicateMap;
+        // bucket the geometries by a key of the properties they must share to be merged, rather than comparing them pairwise.
+        GeometryBucketMap geometryBuckets;
         Nodes standardChildren;
 
         unsigned int i;
@@ -1800,7 +1756,7 @@ bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
                     geom->getDataVariance()!=osg::Object::DYNAMIC &&
                     isOperationPermissibleForObject(geom))
                 {
-                    geometryDuplicateMap[geom].push_back(geom);
+                    geometryBuckets[GeometryMergeKey(*geom)].push_back(geom);
                 }
                 else
                 {
@@ -1813,102 +1769,40 @@ bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
             }
         }
 
-        // first try to group geometries with the same properties
-        // (i.e. array types) to avoid loss of data during merging
-        MergeList mergeListChecked;        // List of drawables just before merging, grouped by "compatibility" and vertex limit
-        MergeList mergeList;            // Intermediate list of drawables, grouped ony by "compatibility"
-        for(GeometryDuplicateMap::iterator itr=geometryDuplicateMap.begin();
-            itr!=geometryDuplicateMap.end();
-            ++itr)
-        {
-            if (itr->second.empty()) continue;
-            if (itr->second.size()==1)
-            {
-                mergeList.push_back(DuplicateList());
-                DuplicateList* duplicateList = &mergeList.back();
-                duplicateList->push_back(itr->second[0]);
-                continue;
-            }
-
-            std::sort(itr->second.begin(),itr->second.end(),LessGeometryPrimitiveType());
-
-            // initialize the temporary list by pushing the first geometry
-            MergeList mergeListTmp;
-            mergeListTmp.push_back(DuplicateList());
-            DuplicateList* duplicateList = &mergeListTmp.back();
-            duplicateList->push_back(itr->second[0]);
-
-            for(DuplicateList::iterator dupItr=itr->second.begin()+1;
-                dupItr!=itr->second.end();
-                ++dupItr)
-            {
-                osg::Geometry* geomToPush = dupItr->get();
-
-                // try to group geomToPush with another geometry
-                MergeList::iterator eachMergeList=mergeListTmp.begin();
-                for(;eachMergeList!=mergeListTmp.end();++eachMergeList)
-                {
-                    if (!eachMergeList->empty() && eachMergeList->front()!=NULL
-                        && isAbleToMerge(*eachMergeList->front(),*geomToPush))
-                    {
-                        eachMergeList->push_back(geomToPush);
-                        break;
-                    }
-                }
-
-                // if no suitable group was found, then a new one is created
-                if (eachMergeList==mergeListTmp.end())
-                {
-                    mergeListTmp.push_back(DuplicateList());
-                    duplicateList = &mergeListTmp.back();
-                    duplicateList->push_back(geomToPush);
-                }
-            }
-
-            // copy the group in the mergeListChecked
-            for(MergeList::iterator eachMergeList=mergeListTmp.begin();eachMergeList!=mergeListTmp.end();++eachMergeList)
-            {
-                mergeListChecked.push_back(*eachMergeList);
-            }
-        }
-
-        // then build merge list using _targetMaximumNumberOfVertices
+        // then split each bucket into lists within _targetMaximumNumberOfVertices, keeping geometries with the same
+        // primitive types next to each other so their primitives can be combined.
+        MergeList mergeList;
         bool needToDoMerge = false;
-        // dequeue each DuplicateList when vertices limit is reached or when all elements has been checked
-        for(MergeList::iterator itr=mergeListChecked.begin(); itr!=mergeListChecked.end(); ++itr)
+        for(GeometryBucketMap::iterator itr=geometryBuckets.begin();
+            itr!=geometryBuckets.end();
+            ++itr)
         {
-            DuplicateList& duplicateList(*itr);
-            if (duplicateList.size()==0)
-            {
-                continue;
-            }
-
-            if (duplicateList.size()==1)
-            {
-                mergeList.push_back(duplicateList);
-                continue;
-            }
+            GeometryList& geometries = itr->second;
+            if (geometries.size()>1) std::stable_sort(geometries.begin(),geometries.end(),LessGeometryPrimitiveType());
 
             unsigned int totalNumberVertices = 0;
-            DuplicateList subset;
-            for(DuplicateList::iterator ditr = duplicateList.begin();
-                ditr != duplicateList.end();
-                ++ditr)
+            GeometryList subset;
+            for(GeometryList::iterator gitr = geometries.begin();
+                gitr != geometries.end();
+                ++gitr)
             {
-                osg::Geometry* geometry = ditr->get();
-                unsigned int numVertices = (geometry->getVertexArray() ? geometry->getVertexArray()->getNumElements() : 0);
+                osg::Geometry* geometry = gitr->get();
+                unsigned int numVertices = getSize(geometry->getVertexArray());
                 if ((totalNumberVertices+numVertices)>_targetMaximumNumberOfVertices && !subset.empty())
                 {
-
-                    mergeList.push_back(subset);
-                    subset.clear();
+                    mergeList.push_back(GeometryList());
+                    mergeList.back().swap(subset);
                     totalNumberVertices = 0;
                 }
                 totalNumberVertices += numVertices;
                 subset.push_back(geometry);
                 if (subset.size()>1) needToDoMerge = true;
             }
-            if (!subset.empty()) mergeList.push_back(subset);
+            if (!subset.empty())
+            {
+                mergeList.push_back(GeometryList());
+                mergeList.back().swap(subset);
+            }
         }
 
         if (needToDoMerge)
@@ -1928,20 +1822,8 @@ bool Optimizer::MergeGeometryVisitor::mergeGroup(osg::Group& group)
                 mitr != mergeList.end();
                 ++mitr)
             {
-                DuplicateList& duplicateList = *mitr;
-                if (!duplicateList.empty())
-                {
-                    DuplicateList::iterator ditr = duplicateList.begin();
-                    osg::ref_ptr<osg::Geometry> lhs = *ditr++;
-                    group.addChild(lhs.get());
-
-                    for(;
-                        ditr != duplicateList.end();
-                        ++ditr)
-                    {
-                        mergeGeometry(*lhs, **ditr);
-                    }
-                }
+                group.addChild(mitr->front().get());
+                if (mitr->size()>1) mergeGeometries(*mitr);
             }
         }
     }
@@ -2423,6 +2305,167 @@ bool Optimizer::MergeGeometryVisitor::mergeGeometry(osg::Geometry& lhs,osg::Geom
     return true;
 }
 
+/// Collect the arrays of a geometry in a fixed order, so that the arrays of geometries with equal GeometryMergeKeys line up.
+static void collectMergeArrays(osg::Geometry& geometry, std::vector<osg::Array*>& arrays)
+{
+    arrays.clear();
+    arrays.push_back(geometry.getVertexArray());
+    arrays.push_back(geometry.getNormalArray());
+    arrays.push_back(geometry.getColorArray());
+    arrays.push_back(geometry.getSecondaryColorArray());
+    arrays.push_back(geometry.getFogCoordArray());
+
+    for(unsigned int unit=0; unit<geometry.getNumTexCoordArrays(); ++unit)
+    {
+        arrays.push_back(geometry.getTexCoordArray(unit));
+    }
+
+    for(unsigned int index=0; index<geometry.getNumVertexAttribArrays(); ++index)
+    {
+        arrays.push_back(geometry.getVertexAttribArray(index));
+    }
+}
+
+/// Lists of points, lines, triangles and quads of the same mode can be drawn as one.
+static bool isCombinablePrimitive(const osg::PrimitiveSet* primitive)
+{
+    if (!primitive->getDrawElements() || primitive->getNumInstances()!=0) return false;
+
+    switch(primitive->getMode())
+    {
+    case(osg::PrimitiveSet::POINTS):
+    case(osg::PrimitiveSet::LINES):
+    case(osg::PrimitiveSet::TRIANGLES):
+    case(osg::PrimitiveSet::QUADS):
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool Optimizer::MergeGeometryVisitor::mergeGeometries(GeometryList& geometries)
+{
+    if (geometries.size()<2) return false;
+
+    osg::Geometry& lhs = *geometries.front();
+
+    typedef std::vector<osg::Array*> ArrayList;
+    std::vector<ArrayList> arrays(geometries.size());
+    std::vector<unsigned int> bases(geometries.size(), 0);
+    unsigned int numVertices = 0;
+    bool perPrimitiveSetBinding = false;
+
+    for(unsigned int g=0; g<geometries.size(); ++g)
+    {
+        collectMergeArrays(*geometries[g], arrays[g]);
+        bases[g] = numVertices;
+        numVertices += getSize(geometries[g]->getVertexArray());
+    }
+
+    // append the arrays of all the geometries to those of the first, reserving each once for its merged size.
+    MergeArrayVisitor merger;
+    for(unsigned int a=0; a<arrays[0].size(); ++a)
+    {
+        osg::Array* lhsArray = arrays[0][a];
+        if (!lhsArray || lhsArray->getBinding()==osg::Array::BIND_OVERALL) continue;
+
+        if (lhsArray->getBinding()==osg::Array::BIND_PER_PRIMITIVE_SET) perPrimitiveSetBinding = true;
+
+        unsigned int numElements = 0;
+        for(unsigned int g=0; g<geometries.size(); ++g)
+        {
+            numElements += getSize(arrays[g][a]);
+        }
+        lhsArray->reserveArray(numElements);
+
+        for(unsigned int g=1; g<geometries.size(); ++g)
+        {
+            if (!merger.merge(lhsArray, arrays[g][a]))
+            {
+                OSG_DEBUG << "MergeGeometry: array not merged. Some data may be lost." <<std::endl;
+            }
+        }
+        lhsArray->dirty();
+    }
+
+    // primitives bound per primitive set must stay apart.
+    bool useUInt = numVertices>65536;
+    typedef std::map<GLenum, osg::ref_ptr<osg::DrawElements> > ElementsMap;
+    ElementsMap combinedElements;
+    if (!perPrimitiveSetBinding)
+    {
+        std::map<GLenum, unsigned int> numIndices;
+        for(GeometryList::iterator gitr = geometries.begin(); gitr != geometries.end(); ++gitr)
+        {
+            osg::Geometry::PrimitiveSetList& primitives = (*gitr)->getPrimitiveSetList();
+            for(osg::Geometry::PrimitiveSetList::iterator pitr = primitives.begin(); pitr != primitives.end(); ++pitr)
+            {
+                if (isCombinablePrimitive(pitr->get())) numIndices[(*pitr)->getMode()] += (*pitr)->getNumIndices();
+            }
+        }
+
+        for(std::map<GLenum, unsigned int>::iterator nitr = numIndices.begin(); nitr != numIndices.end(); ++nitr)
+        {
+            osg::DrawElements* elements = useUInt ? static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(nitr->first)) :
+                                                    static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(nitr->first));
+            elements->reserveElements(nitr->second);
+            combinedElements[nitr->first] = elements;
+        }
+    }
+
+    // gather the primitives with their indices shifted past the vertices of the geometries before them,
+    // each combined DrawElements taking the place of the first list of its mode.
+    osg::Geometry::PrimitiveSetList mergedPrimitives;
+    std::set<osg::DrawElements*> placedElements;
+    for(unsigned int g=0; g<geometries.size(); ++g)
+    {
+        unsigned int base = bases[g];
+        osg::Geometry::PrimitiveSetList& primitives = geometries[g]->getPrimitiveSetList();
+        for(osg::Geometry::PrimitiveSetList::iterator pitr = primitives.begin(); pitr != primitives.end(); ++pitr)
+        {
+            osg::PrimitiveSet* primitive = pitr->get();
+            ElementsMap::iterator eitr = isCombinablePrimitive(primitive) ? combinedElements.find(primitive->getMode()) : combinedElements.end();
+            if (eitr != combinedElements.end())
+            {
+                osg::DrawElements* elements = eitr->second.get();
+                for(unsigned int i=0; i<primitive->getNumIndices(); ++i)
+                {
+                    elements->addElement(primitive->index(i)+base);
+                }
+                if (placedElements.insert(elements).second) mergedPrimitives.push_back(elements);
+            }
+            else if (primitive->getDrawElements())
+            {
+                osg::DrawElements* elements = useUInt ? static_cast<osg::DrawElements*>(new osg::DrawElementsUInt(primitive->getMode())) :
+                                                        static_cast<osg::DrawElements*>(new osg::DrawElementsUShort(primitive->getMode()));
+                elements->reserveElements(primitive->getNumIndices());
+                for(unsigned int i=0; i<primitive->getNumIndices(); ++i)
+                {
+                    elements->addElement(primitive->index(i)+base);
+                }
+                elements->setNumInstances(primitive->getNumInstances());
+                mergedPrimitives.push_back(elements);
+            }
+            else
+            {
+                primitive->offsetIndices(base);
+                mergedPrimitives.push_back(primitive);
+            }
+        }
+    }
+
+    lhs.removePrimitiveSet(0, lhs.getNumPrimitiveSets());
+    for(osg::Geometry::PrimitiveSetList::iterator pitr = mergedPrimitives.begin(); pitr != mergedPrimitives.end(); ++pitr)
+    {
+        lhs.addPrimitiveSet(pitr->get());
+    }
+
+    lhs.dirtyBound();
+    lhs.dirtyGLObjects();
+
+    return true;
+}
+
 bool Optimizer::MergeGeometryVisitor::mergePrimitive(osg::DrawArrays& lhs,osg::DrawArrays& rhs)
 {
     if (lhs.getFirst()+lhs.getCount()==rhs.getFirst())
@@ -4546,3 +4589,450 @@ void Optimizer::BufferObjectVisitor::apply(osg::Geometry& geometry)
         geometry.setUseDisplayList(_valueDisplayList);
     }
 }
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Quantize vertex attributes to shorts.
+//
+
+namespace
+{
+    const float QUANTIZED_MAXIMUM = 32767.0f;
+
+    inline short quantizeValue(float value)
+    {
+        return static_cast<short>(osg::round(osg::clampBetween(value, -QUANTIZED_MAXIMUM, QUANTIZED_MAXIMUM)));
+    }
+
+    osg::Vec3sArray* quantizeVertices(const osg::Vec3Array& vertices, const osg::Vec3& center, float scale)
+    {
+        osg::Vec3sArray* quantized = new osg::Vec3sArray(vertices.size());
+        quantized->setBinding(vertices.getBinding());
+        for(unsigned int i=0; i<vertices.size(); ++i)
+        {
+            osg::Vec3 v = (vertices[i]-center)/scale;
+            (*quantized)[i].set(quantizeValue(v.x()), quantizeValue(v.y()), quantizeValue(v.z()));
+        }
+        return quantized;
+    }
+
+    osg::Array* quantizeNormals(const osg::Vec3Array& normals, Optimizer::QuantizeGeometryVisitor::NormalEncoding encoding)
+    {
+        if (encoding==Optimizer::QuantizeGeometryVisitor::OCTAHEDRAL_NORMALS)
+        {
+            // project onto the octahedron |x|+|y|+|z|=1 and fold its lower half over the upper.
+            osg::Vec2sArray* quantized = new osg::Vec2sArray(normals.size());
+            for(unsigned int i=0; i<normals.size(); ++i)
+            {
+                const osg::Vec3& n = normals[i];
+                float length = fabsf(n.x())+fabsf(n.y())+fabsf(n.z());
+                osg::Vec2 oct = length>0.0f ? osg::Vec2(n.x()/length, n.y()/length) : osg::Vec2(0.0f, 0.0f);
+                if (n.z()<0.0f)
+                {
+                    oct.set((1.0f-fabsf(oct.y()))*(oct.x()>=0.0f ? 1.0f : -1.0f),
+                            (1.0f-fabsf(oct.x()))*(oct.y()>=0.0f ? 1.0f : -1.0f));
+                }
+                (*quantized)[i].set(quantizeValue(oct.x()*QUANTIZED_MAXIMUM), quantizeValue(oct.y()*QUANTIZED_MAXIMUM));
+            }
+            quantized->setBinding(normals.getBinding());
+            quantized->setNormalize(true);
+            return quantized;
+        }
+
+        osg::Vec3sArray* quantized = new osg::Vec3sArray(normals.size());
+        for(unsigned int i=0; i<normals.size(); ++i)
+        {
+            osg::Vec3 n = normals[i];
+            n.normalize();
+            n *= QUANTIZED_MAXIMUM;
+            (*quantized)[i].set(quantizeValue(n.x()), quantizeValue(n.y()), quantizeValue(n.z()));
+        }
+        quantized->setBinding(normals.getBinding());
+        quantized->setNormalize(true);
+        return quantized;
+    }
+
+    osg::Vec2sArray* quantizeTexCoords(const osg::Vec2Array& texcoords, const osg::Vec2& center, const osg::Vec2& scale)
+    {
+        osg::Vec2sArray* quantized = new osg::Vec2sArray(texcoords.size());
+        quantized->setBinding(texcoords.getBinding());
+        for(unsigned int i=0; i<texcoords.size(); ++i)
+        {
+            osg::Vec2 tc = texcoords[i]-center;
+            (*quantized)[i].set(quantizeValue(tc.x()/scale.x()), quantizeValue(tc.y()/scale.y()));
+        }
+        return quantized;
+    }
+
+    inline float quantizationScale(float halfRange)
+    {
+        return halfRange>0.0f ? halfRange/QUANTIZED_MAXIMUM : 1.0f;
+    }
+
+    unsigned int findQuantizationGroup(std::vector<unsigned int>& groups, unsigned int index)
+    {
+        while(groups[index]!=index)
+        {
+            groups[index] = groups[groups[index]];
+            index = groups[index];
+        }
+        return index;
+    }
+}
+
+void Optimizer::QuantizeGeometryVisitor::reset()
+{
+    _nodes.clear();
+    _textureUnitsStack.clear();
+}
+
+unsigned int Optimizer::QuantizeGeometryVisitor::getFixedTextureUnits(const osg::StateSet* stateset) const
+{
+    unsigned int units = _textureUnitsStack.empty() ? 0 : _textureUnitsStack.back();
+    if (!stateset) return units;
+
+    unsigned int numUnits = osg::maximum(stateset->getTextureAttributeList().size(), stateset->getTextureModeList().size());
+    for(unsigned int unit=0; unit<numUnits && unit<32; ++unit)
+    {
+        if (stateset->getTextureAttribute(unit, osg::StateAttribute::TEXMAT) ||
+            stateset->getTextureAttribute(unit, osg::StateAttribute::TEXGEN) ||
+            (stateset->getTextureMode(unit, GL_TEXTURE_GEN_S) & osg::StateAttribute::ON) ||
+            (stateset->getTextureMode(unit, GL_TEXTURE_GEN_T) & osg::StateAttribute::ON))
+        {
+            units |= (1u<<unit);
+        }
+    }
+    return units;
+}
+
+void Optimizer::QuantizeGeometryVisitor::apply(osg::Node& node)
+{
+    _textureUnitsStack.push_back(getFixedTextureUnits(node.getStateSet()));
+
+    traverse(node);
+
+    _textureUnitsStack.pop_back();
+}
+
+void Optimizer::QuantizeGeometryVisitor::apply(osg::Billboard&)
+{
+    // the decoding transform would rotate with the billboard's drawables, so leave them as they are.
+}
+
+void Optimizer::QuantizeGeometryVisitor::apply(osg::Geode& geode)
+{
+    if (!isOperationPermissibleForObject(&geode)) return;
+
+    unsigned int units = getFixedTextureUnits(geode.getStateSet());
+    for(unsigned int i=0; i<geode.getNumDrawables(); ++i)
+    {
+        units |= getFixedTextureUnits(geode.getDrawable(i)->getStateSet());
+    }
+
+    // a geode reached along several paths keeps the texture coordinates fixed along any of them.
+    _nodes[&geode] |= units;
+}
+
+void Optimizer::QuantizeGeometryVisitor::apply(osg::Geometry& geometry)
+{
+    _nodes[&geometry] |= getFixedTextureUnits(geometry.getStateSet());
+}
+
+void Optimizer::QuantizeGeometryVisitor::quantize()
+{
+    // nodes whose geometries share arrays are grouped together, so that each array is quantized once against the bounds of all its users.
+    typedef std::map<const osg::Array*, unsigned int> ArrayIndexMap;
+    NodeList nodes;
+    std::vector<GeometryList> nodeGeometries;
+    std::vector<unsigned int> nodeTextureUnits;
+    std::vector<unsigned int> groups;
+    ArrayIndexMap arrayNodes;
+    ArrayIndexMap arrayUses;
+
+    for(NodeMap::iterator itr = _nodes.begin(); itr != _nodes.end(); ++itr)
+    {
+        GeometryList geometries;
+        if (!getGeometries(*(itr->first), geometries)) continue;
+
+        unsigned int index = static_cast<unsigned int>(nodes.size());
+        nodes.push_back(itr->first);
+        nodeGeometries.push_back(geometries);
+        nodeTextureUnits.push_back(itr->second);
+        groups.push_back(index);
+
+        for(GeometryList::iterator gitr = geometries.begin(); gitr != geometries.end(); ++gitr)
+        {
+            osg::Geometry* geometry = *gitr;
+
+            std::vector<const osg::Array*> arrays;
+            arrays.push_back(geometry->getVertexArray());
+            arrays.push_back(geometry->getNormalArray());
+            for(unsigned int unit=0; unit<geometry->getNumTexCoordArrays(); ++unit)
+            {
+                arrays.push_back(geometry->getTexCoordArray(unit));
+            }
+
+            for(std::vector<const osg::Array*>::iterator aitr = arrays.begin(); aitr != arrays.end(); ++aitr)
+            {
+                if (!*aitr) continue;
+
+                ++arrayUses[*aitr];
+
+                ArrayIndexMap::iterator nitr = arrayNodes.find(*aitr);
+                if (nitr==arrayNodes.end()) arrayNodes[*aitr] = index;
+                else groups[findQuantizationGroup(groups, index)] = findQuantizationGroup(groups, nitr->second);
+            }
+        }
+    }
+
+    // an array referenced from outside the nodes would be left decoded by the wrong transform, or not at all.
+    std::vector<bool> validGroups(nodes.size(), true);
+    for(ArrayIndexMap::iterator itr = arrayUses.begin(); itr != arrayUses.end(); ++itr)
+    {
+        if (itr->first->referenceCount()>static_cast<int>(itr->second))
+        {
+            validGroups[findQuantizationGroup(groups, arrayNodes[itr->first])] = false;
+        }
+    }
+
+    typedef std::map<unsigned int, std::vector<unsigned int> > GroupMap;
+    GroupMap groupMembers;
+    for(unsigned int i=0; i<nodes.size(); ++i)
+    {
+        groupMembers[findQuantizationGroup(groups, i)].push_back(i);
+    }
+
+    unsigned int numQuantized = 0;
+    for(GroupMap::iterator itr = groupMembers.begin(); itr != groupMembers.end(); ++itr)
+    {
+        if (!validGroups[itr->first]) continue;
+
+        NodeList groupNodes;
+        GeometryList groupGeometries;
+        unsigned int fixedTextureUnits = 0;
+        for(std::vector<unsigned int>::iterator mitr = itr->second.begin(); mitr != itr->second.end(); ++mitr)
+        {
+            unsigned int i = *mitr;
+            groupNodes.push_back(nodes[i]);
+            groupGeometries.insert(groupGeometries.end(), nodeGeometries[i].begin(), nodeGeometries[i].end());
+            fixedTextureUnits |= nodeTextureUnits[i];
+        }
+
+        if (quantize(groupNodes, groupGeometries, fixedTextureUnits)) numQuantized += static_cast<unsigned int>(groupNodes.size());
+    }
+
+    OSG_INFO<<"QuantizeGeometryVisitor::quantize() quantized "<<numQuantized<<" of "<<_nodes.size()<<" nodes, saving "<<_numBytesSaved<<" bytes"<<std::endl;
+
+    _nodes.clear();
+}
+
+bool Optimizer::QuantizeGeometryVisitor::getGeometries(osg::Node& node, GeometryList& geometries) const
+{
+    // the decoding transform applies to all the drawables of a geode, which must all be quantized with it.
+    if (osg::Geode* geode = node.asGeode())
+    {
+        for(unsigned int i=0; i<geode->getNumDrawables(); ++i)
+        {
+            osg::Geometry* geometry = geode->getDrawable(i)->asGeometry();
+            if (!geometry || geometry->getNumParents()!=1) return false;
+            geometries.push_back(geometry);
+        }
+    }
+    else if (osg::Geometry* geometry = node.asGeometry())
+    {
+        // a geometry also held by a geode is quantized along with that geode, or not at all.
+        for(unsigned int i=0; i<geometry->getNumParents(); ++i)
+        {
+            if (geometry->getParent(i)->asGeode()) return false;
+        }
+        geometries.push_back(geometry);
+    }
+
+    if (geometries.empty() || node.getNumParents()==0) return false;
+
+    for(GeometryList::iterator itr = geometries.begin(); itr != geometries.end(); ++itr)
+    {
+        osg::Geometry* geometry = *itr;
+        if (!isOperationPermissibleForObject(geometry) ||
+            geometry->containsDeprecatedData() ||
+            geometry->getUpdateCallback()) return false;
+
+        if (geometry->getCullCallback() && !dynamic_cast<osg::ClusterCullingCallback*>(geometry->getCullCallback())) return false;
+
+        if (!dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray())) return false;
+
+        if (_normalEncoding==OCTAHEDRAL_NORMALS &&
+            dynamic_cast<const osg::Vec3Array*>(geometry->getNormalArray()) &&
+            geometry->getVertexAttribArray(_octahedralNormalAttribIndex)) return false;
+    }
+
+    return true;
+}
+
+bool Optimizer::QuantizeGeometryVisitor::quantize(const NodeList& nodes, const GeometryList& geometries, unsigned int fixedTextureUnits)
+{
+    osg::BoundingBox bb;
+    std::vector<osg::BoundingBox> texCoordBounds;
+    for(GeometryList::const_iterator itr = geometries.begin(); itr != geometries.end(); ++itr)
+    {
+        osg::Geometry* geometry = *itr;
+        const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+
+        for(osg::Vec3Array::const_iterator vitr = vertices->begin(); vitr != vertices->end(); ++vitr)
+        {
+            bb.expandBy(*vitr);
+        }
+
+        if (!_quantizeTexCoords) continue;
+
+        // the decoding TexMat of a unit applies to all the geometries, so all their coordinates on it must be quantized.
+        unsigned int numUnits = osg::minimum(geometry->getNumTexCoordArrays(), 32u);
+        if (texCoordBounds.size()<numUnits) texCoordBounds.resize(numUnits);
+        for(unsigned int unit=0; unit<numUnits; ++unit)
+        {
+            const osg::Array* array = geometry->getTexCoordArray(unit);
+            if (!array) continue;
+
+            const osg::Vec2Array* texcoords = dynamic_cast<const osg::Vec2Array*>(array);
+            if (!texcoords)
+            {
+                fixedTextureUnits |= (1u<<unit);
+                continue;
+            }
+
+            for(osg::Vec2Array::const_iterator titr = texcoords->begin(); titr != texcoords->end(); ++titr)
+            {
+                texCoordBounds[unit].expandBy(osg::Vec3(titr->x(), titr->y(), 0.0f));
+            }
+        }
+    }
+
+    if (!bb.valid()) return false;
+
+    // quantize to the same step along all axes, so that normals only need rescaling once decoded.
+    osg::Vec3 center = bb.center();
+    float scale = quantizationScale(osg::maximum(bb.xMax()-bb.xMin(), osg::maximum(bb.yMax()-bb.yMin(), bb.zMax()-bb.zMin()))*0.5f);
+
+    std::vector<osg::Vec2> texCoordCenters(texCoordBounds.size());
+    std::vector<osg::Vec2> texCoordScales(texCoordBounds.size());
+    for(unsigned int unit=0; unit<texCoordBounds.size(); ++unit)
+    {
+        const osg::BoundingBox& tbb = texCoordBounds[unit];
+        if (!tbb.valid() || (fixedTextureUnits & (1u<<unit))) continue;
+
+        texCoordCenters[unit].set(tbb.center().x(), tbb.center().y());
+        texCoordScales[unit].set(quantizationScale((tbb.xMax()-tbb.xMin())*0.5f), quantizationScale((tbb.yMax()-tbb.yMin())*0.5f));
+    }
+
+    // arrays shared between the geometries stay shared, the originals being kept until the bytes saved are counted.
+    typedef std::map< osg::ref_ptr<const osg::Array>, osg::ref_ptr<osg::Array> > ArrayMap;
+    typedef std::map<const osg::Callback*, osg::ref_ptr<osg::ClusterCullingCallback> > CallbackMap;
+    ArrayMap quantizedArrays;
+    CallbackMap quantizedCallbacks;
+    bool quantizedNormals = false;
+    unsigned int quantizedTextureUnits = 0;
+
+    for(GeometryList::const_iterator itr = geometries.begin(); itr != geometries.end(); ++itr)
+    {
+        osg::Geometry* geometry = *itr;
+
+        const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+        osg::ref_ptr<osg::Array>& quantizedVertices = quantizedArrays[vertices];
+        if (!quantizedVertices) quantizedVertices = quantizeVertices(*vertices, center, scale);
+        geometry->setVertexArray(quantizedVertices.get());
+
+        const osg::Vec3Array* normals = dynamic_cast<const osg::Vec3Array*>(geometry->getNormalArray());
+        if (normals && _normalEncoding!=FLOAT_NORMALS)
+        {
+            osg::ref_ptr<osg::Array>& quantizedArray = quantizedArrays[normals];
+            if (!quantizedArray) quantizedArray = quantizeNormals(*normals, _normalEncoding);
+
+            if (_normalEncoding==OCTAHEDRAL_NORMALS)
+            {
+                // glNormalPointer always reads three components, so the two component encoding is passed as a generic attribute.
+                geometry->setVertexAttribArray(_octahedralNormalAttribIndex, quantizedArray.get());
+                geometry->setNormalArray(0);
+            }
+            else
+            {
+                geometry->setNormalArray(quantizedArray.get());
+                quantizedNormals = true;
+            }
+        }
+
+        for(unsigned int unit=0; unit<texCoordBounds.size() && unit<geometry->getNumTexCoordArrays(); ++unit)
+        {
+            const osg::Vec2Array* texcoords = dynamic_cast<const osg::Vec2Array*>(geometry->getTexCoordArray(unit));
+            if (!texcoords || (fixedTextureUnits & (1u<<unit))) continue;
+
+            osg::ref_ptr<osg::Array>& quantizedArray = quantizedArrays[texcoords];
+            if (!quantizedArray) quantizedArray = quantizeTexCoords(*texcoords, texCoordCenters[unit], texCoordScales[unit]);
+            geometry->setTexCoordArray(unit, quantizedArray.get());
+            quantizedTextureUnits |= (1u<<unit);
+        }
+
+        // move the cluster culling control point and radius into the quantized coordinates.
+        if (const osg::ClusterCullingCallback* ccc = dynamic_cast<const osg::ClusterCullingCallback*>(geometry->getCullCallback()))
+        {
+            osg::ref_ptr<osg::ClusterCullingCallback>& quantizedCallback = quantizedCallbacks[ccc];
+            if (!quantizedCallback)
+            {
+                quantizedCallback = new osg::ClusterCullingCallback((ccc->getControlPoint()-center)/scale,
+                                                                    ccc->getNormal(),
+                                                                    ccc->getDeviation(),
+                                                                    ccc->getRadius()>0.0f ? ccc->getRadius()/scale : ccc->getRadius());
+            }
+            geometry->setCullCallback(quantizedCallback.get());
+        }
+
+        geometry->dirtyBound();
+    }
+
+    for(ArrayMap::iterator itr = quantizedArrays.begin(); itr != quantizedArrays.end(); ++itr)
+    {
+        _numBytesSaved += itr->first->getTotalDataSize()-itr->second->getTotalDataSize();
+    }
+
+    // the nodes of a group share the decoding state, each being given its own transform.
+    osg::ref_ptr<osg::StateSet> stateset;
+    if (quantizedNormals)
+    {
+        stateset = new osg::StateSet;
+        stateset->setMode(GL_RESCALE_NORMAL, osg::StateAttribute::ON);
+    }
+
+    for(unsigned int unit=0; unit<texCoordBounds.size(); ++unit)
+    {
+        if (!(quantizedTextureUnits & (1u<<unit))) continue;
+
+        const osg::Vec2& tcCenter = texCoordCenters[unit];
+        const osg::Vec2& tcScale = texCoordScales[unit];
+        if (!stateset) stateset = new osg::StateSet;
+        stateset->setTextureAttribute(unit, new osg::TexMat(osg::Matrix::scale(tcScale.x(), tcScale.y(), 1.0)*osg::Matrix::translate(tcCenter.x(), tcCenter.y(), 0.0)));
+    }
+
+    osg::Matrix matrix = osg::Matrix::scale(scale, scale, scale)*osg::Matrix::translate(center);
+    for(NodeList::const_iterator itr = nodes.begin(); itr != nodes.end(); ++itr)
+    {
+        osg::Node* node = *itr;
+
+        osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform(matrix);
+        transform->setName(node->getName());
+        transform->setStateSet(stateset.get());
+
+        // the decoding matrix must not be flattened into the quantized vertices.
+        transform->setDataVariance(osg::Object::DYNAMIC);
+
+        // take a copy of the parents before the node is added to the transform.
+        osg::Node::ParentList parents = node->getParents();
+        transform->addChild(node);
+        for(osg::Node::ParentList::iterator pitr = parents.begin(); pitr != parents.end(); ++pitr)
+        {
+            (*pitr)->replaceChild(node, transform.get());
+        }
+    }
+
+    return true;
+}
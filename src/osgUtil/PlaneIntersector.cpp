@@ -650,6 +650,12 @@ void PlaneIntersector::leave()
     // do nothing.
 }
 
+bool PlaneIntersector::intersects(const osg::BoundingBox& bb)
+{
+    if (reachedLimit()) return false;
+    return _plane.intersect(bb)==0 && _polytope.contains(bb);
+}
+
 
 void PlaneIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable)
 {
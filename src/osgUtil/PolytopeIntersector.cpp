@@ -542,6 +542,12 @@ void PolytopeIntersector::leave()
     // do nothing.
 }
 
+bool PolytopeIntersector::intersects(const osg::BoundingBox& bb)
+{
+    if (reachedLimit()) return false;
+    return _polytope.contains( bb );
+}
+
 
 
 void PolytopeIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable)
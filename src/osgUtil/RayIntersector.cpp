@@ -94,6 +94,14 @@ void RayIntersector::leave()
     // do nothing
 }
 
+bool RayIntersector::intersects(const BoundingBox& bb)
+{
+    if (reachedLimit()) return false;
+
+    Vec3d s(_start), e;
+    return intersectAndClip(s, _direction, e, bb);
+}
+
 void RayIntersector::reset()
 {
     Intersector::reset();
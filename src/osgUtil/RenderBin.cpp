@@ -272,78 +272,168 @@ void RenderBin::sortByState()
 }
 
 
-struct StateGraphFrontToBackSortFunctor
+/** Pairs an unsigned sort key with the item it was computed from. The keys are computed once up front
+  * so that the sort itself doesn't have to dereference the RenderLeaf or StateGraph pointers.*/
+template<class T>
+struct SortKeyItem
 {
-    bool operator() (const StateGraph* lhs,const StateGraph* rhs) const
+    unsigned int    key;
+    T*              item;
+
+    bool operator < (const SortKeyItem& rhs) const { return key<rhs.key; }
+};
+
+/** Map a float to an unsigned int with the same ordering, negative values having their bits flipped
+  * and positive values their sign bit set. NaN depths are removed before sorting.*/
+inline unsigned int depthSortKey(float depth)
+{
+    union { float f; unsigned int u; } value;
+    value.f = depth;
+    return (value.u & 0x80000000u) ? ~value.u : (value.u | 0x80000000u);
+}
+
+/** Stable sort of the items on their keys, using a least significant digit radix sort with 8 bit digits.
+  * Passes where every key shares the same digit are skipped, small lists fall back to std::stable_sort.*/
+template<class T>
+void radixSort(std::vector< SortKeyItem<T> >& items)
+{
+    const unsigned int numItems = items.size();
+    if (numItems<2) return;
+
+    if (numItems<128)
+    {
+        std::stable_sort(items.begin(), items.end());
+        return;
+    }
+
+    unsigned int counts[4][256];
+    memset(counts, 0, sizeof(counts));
+
+    for(unsigned int i=0; i<numItems; ++i)
+    {
+        unsigned int key = items[i].key;
+        ++counts[0][key & 0xff];
+        ++counts[1][(key>>8) & 0xff];
+        ++counts[2][(key>>16) & 0xff];
+        ++counts[3][(key>>24) & 0xff];
+    }
+
+    std::vector< SortKeyItem<T> > buffer(numItems);
+    SortKeyItem<T>* src = &items.front();
+    SortKeyItem<T>* dst = &buffer.front();
+
+    for(unsigned int pass=0; pass<4; ++pass)
     {
-        return (lhs->_minimumDistance<rhs->_minimumDistance);
+        unsigned int shift = pass*8;
+        unsigned int* count = counts[pass];
+
+        // all the keys have the same digit, the pass wouldn't change the order.
+        if (count[(src[0].key>>shift) & 0xff]==numItems) continue;
+
+        unsigned int offset = 0;
+        for(unsigned int d=0; d<256; ++d)
+        {
+            unsigned int c = count[d];
+            count[d] = offset;
+            offset += c;
+        }
+
+        for(unsigned int i=0; i<numItems; ++i)
+        {
+            dst[count[(src[i].key>>shift) & 0xff]++] = src[i];
+        }
+
+        std::swap(src, dst);
     }
+
+    if (src!=&items.front()) std::copy(src, src+numItems, items.begin());
+}
+
+struct FrontToBackSortKey
+{
+    unsigned int operator() (const RenderLeaf* leaf) const { return depthSortKey(leaf->_depth); }
 };
 
-void RenderBin::sortByStateThenFrontToBack()
+struct BackToFrontSortKey
 {
-    for(StateGraphList::iterator itr=_stateGraphList.begin();
-        itr!=_stateGraphList.end();
-        ++itr)
+    unsigned int operator() (const RenderLeaf* leaf) const { return ~depthSortKey(leaf->_depth); }
+};
+
+struct TraversalOrderSortKey
+{
+    unsigned int operator() (const RenderLeaf* leaf) const { return leaf->_traversalOrderNumber; }
+};
+
+inline RenderLeaf* getRenderLeaf(RenderLeaf* leaf) { return leaf; }
+inline RenderLeaf* getRenderLeaf(const osg::ref_ptr<RenderLeaf>& leaf) { return leaf.get(); }
+
+/** Sort the leaves, either a RenderBin::RenderLeafList or a StateGraph::LeafList, with a radix sort on the key computed for each by sortKey.*/
+template<class LeafList, class SortKey>
+void sortRenderLeaves(LeafList& leaves, SortKey sortKey)
+{
+    if (leaves.size()<2) return;
+
+    std::vector< SortKeyItem<RenderLeaf> > items(leaves.size());
+    for(unsigned int i=0; i<leaves.size(); ++i)
+    {
+        items[i].item = getRenderLeaf(leaves[i]);
+        items[i].key = sortKey(items[i].item);
+    }
+
+    radixSort(items);
+
+    for(unsigned int i=0; i<leaves.size(); ++i)
     {
-        (*itr)->sortFrontToBack();
-        (*itr)->getMinimumDistance();
+        leaves[i] = items[i].item;
     }
-    std::sort(_stateGraphList.begin(),_stateGraphList.end(),StateGraphFrontToBackSortFunctor());
 }
 
-struct FrontToBackSortFunctor
+void RenderBin::sortByStateThenFrontToBack()
 {
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
+    std::vector< SortKeyItem<StateGraph> > items(_stateGraphList.size());
+    for(unsigned int i=0; i<_stateGraphList.size(); ++i)
     {
-        return (lhs->_depth<rhs->_depth);
+        StateGraph* sg = _stateGraphList[i];
+        sortRenderLeaves(sg->_leaves, FrontToBackSortKey());
+
+        items[i].key = depthSortKey(sg->getMinimumDistance());
+        items[i].item = sg;
     }
-};
 
+    radixSort(items);
+
+    for(unsigned int i=0; i<_stateGraphList.size(); ++i)
+    {
+        _stateGraphList[i] = items[i].item;
+    }
+}
 
 void RenderBin::sortFrontToBack()
 {
     copyLeavesFromStateGraphListToRenderLeafList();
 
     // now sort the list into ascending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),FrontToBackSortFunctor());
+    sortRenderLeaves(_renderLeafList, FrontToBackSortKey());
 
 //    cout << "sort front to back"<<endl;
 }
 
-struct BackToFrontSortFunctor
-{
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
-    {
-        return (rhs->_depth<lhs->_depth);
-    }
-};
-
 void RenderBin::sortBackToFront()
 {
     copyLeavesFromStateGraphListToRenderLeafList();
 
-    // now sort the list into ascending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),BackToFrontSortFunctor());
+    // now sort the list into descending depth order.
+    sortRenderLeaves(_renderLeafList, BackToFrontSortKey());
 
 //    cout << "sort back to front"<<endl;
 }
 
-
-struct TraversalOrderFunctor
-{
-    bool operator() (const RenderLeaf* lhs,const RenderLeaf* rhs) const
-    {
-        return (lhs->_traversalOrderNumber<rhs->_traversalOrderNumber);
-    }
-};
-
 void RenderBin::sortTraversalOrder()
 {
     copyLeavesFromStateGraphListToRenderLeafList();
 
-    // now sort the list into ascending depth order.
-    std::sort(_renderLeafList.begin(),_renderLeafList.end(),TraversalOrderFunctor());
+    // now sort the list into ascending traversal order.
+    sortRenderLeaves(_renderLeafList, TraversalOrderSortKey());
 }
 
 void RenderBin::copyLeavesFromStateGraphListToRenderLeafList()
@@ -419,6 +509,74 @@ RenderBin* RenderBin::find_or_insert(int binNum,const std::string& binName)
     return rb;
 }
 
+static void offsetTraversalOrderNumbers(RenderBin::StateGraphList& stateGraphList, unsigned int offset)
+{
+    if (offset==0) return;
+
+    // RenderLeaves already copied to a bin's RenderLeafList are also held by its StateGraphs.
+    for(RenderBin::StateGraphList::iterator itr = stateGraphList.begin();
+        itr != stateGraphList.end();
+        ++itr)
+    {
+        for(StateGraph::LeafList::iterator litr = (*itr)->_leaves.begin();
+            litr != (*itr)->_leaves.end();
+            ++litr)
+        {
+            (*litr)->_traversalOrderNumber += offset;
+        }
+    }
+}
+
+void RenderBin::merge(RenderBin& rhs, unsigned int traversalOrderOffset)
+{
+    if (&rhs==this) return;
+
+    offsetTraversalOrderNumbers(rhs._stateGraphList, traversalOrderOffset);
+
+    _stateGraphList.insert(_stateGraphList.end(), rhs._stateGraphList.begin(), rhs._stateGraphList.end());
+    _renderLeafList.insert(_renderLeafList.end(), rhs._renderLeafList.begin(), rhs._renderLeafList.end());
+
+    for(RenderBinList::iterator itr = rhs._bins.begin();
+        itr != rhs._bins.end();
+        ++itr)
+    {
+        RenderBinList::iterator found_itr = _bins.find(itr->first);
+        if (found_itr!=_bins.end())
+        {
+            found_itr->second->merge(*(itr->second), traversalOrderOffset);
+            continue;
+        }
+
+        // adopt the bin, pointing it and its own child bins at this bin's stage.
+        RenderBin* rb = itr->second.get();
+        rb->_parent = this;
+        _bins[itr->first] = rb;
+
+        std::vector<RenderBin*> binStack(1, rb);
+        while(!binStack.empty())
+        {
+            RenderBin* bin = binStack.back();
+            binStack.pop_back();
+
+            bin->_stage = _stage;
+            offsetTraversalOrderNumbers(bin->_stateGraphList, traversalOrderOffset);
+
+            for(RenderBinList::iterator bitr = bin->_bins.begin();
+                bitr != bin->_bins.end();
+                ++bitr)
+            {
+                binStack.push_back(bitr->second.get());
+            }
+        }
+    }
+
+    rhs._stateGraphList.clear();
+    rhs._renderLeafList.clear();
+    rhs._bins.clear();
+
+    _sorted = false;
+}
+
 void RenderBin::draw(osg::RenderInfo& renderInfo,RenderLeaf*& previous)
 {
     renderInfo.pushRenderBin(this);
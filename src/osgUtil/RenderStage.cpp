@@ -210,6 +210,52 @@ void RenderStage::addPostRenderStage(RenderStage* rs, int order)
     }
 }
 
+void RenderStage::merge(RenderStage& rhs, unsigned int traversalOrderOffset)
+{
+    if (&rhs==this) return;
+
+    RenderBin::merge(rhs, traversalOrderOffset);
+
+    PositionalStateContainer* rhsPositionalState = rhs._renderStageLighting.get();
+    if (rhsPositionalState)
+    {
+        PositionalStateContainer* positionalState = getPositionalStateContainer();
+        positionalState->_attrList.insert(positionalState->_attrList.end(), rhsPositionalState->_attrList.begin(), rhsPositionalState->_attrList.end());
+
+        for(PositionalStateContainer::TexUnitAttrMatrixListMap::iterator itr = rhsPositionalState->_texAttrListMap.begin();
+            itr != rhsPositionalState->_texAttrListMap.end();
+            ++itr)
+        {
+            PositionalStateContainer::AttrMatrixList& attrList = positionalState->_texAttrListMap[itr->first];
+            attrList.insert(attrList.end(), itr->second.begin(), itr->second.end());
+        }
+
+        rhsPositionalState->reset();
+    }
+
+    // stages of equal order are appended after the existing ones, so the traversal order is retained.
+    for(RenderStageList::iterator pre_itr = rhs._preRenderList.begin();
+        pre_itr != rhs._preRenderList.end();
+        ++pre_itr)
+    {
+        RenderStage* rs = pre_itr->second.get();
+        if (rhsPositionalState && rs->getInheritedPositionalStateContainer()==rhsPositionalState) rs->setInheritedPositionalStateContainer(getPositionalStateContainer());
+        addPreRenderStage(rs, pre_itr->first);
+    }
+
+    for(RenderStageList::iterator post_itr = rhs._postRenderList.begin();
+        post_itr != rhs._postRenderList.end();
+        ++post_itr)
+    {
+        RenderStage* rs = post_itr->second.get();
+        if (rhsPositionalState && rs->getInheritedPositionalStateContainer()==rhsPositionalState) rs->setInheritedPositionalStateContainer(getPositionalStateContainer());
+        addPostRenderStage(rs, post_itr->first);
+    }
+
+    rhs._preRenderList.clear();
+    rhs._postRenderList.clear();
+}
+
 void RenderStage::drawPreRenderStages(osg::RenderInfo& renderInfo,RenderLeaf*& previous)
 {
     if (_preRenderList.empty()) return;
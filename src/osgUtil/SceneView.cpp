@@ -28,7 +28,11 @@
 
 #include <osg/GLU>
 
+#include <OpenThreads/Barrier>
+#include <OpenThreads/Thread>
+
 #include <iterator>
+#include <typeinfo>
 
 using namespace osg;
 using namespace osgUtil;
@@ -142,6 +146,8 @@ SceneView::SceneView(DisplaySettings* ds)
     _dynamicObjectCount = 0;
 
     _resetColorMaskToAllEnabled = true;
+
+    _numCullThreads = ds ? ds->getNumOfCullThreadsHint() : osg::DisplaySettings::instance()->getNumOfCullThreadsHint();
 }
 
 SceneView::SceneView(const SceneView& rhs, const osg::CopyOp& copyop):
@@ -179,6 +185,8 @@ SceneView::SceneView(const SceneView& rhs, const osg::CopyOp& copyop):
     _dynamicObjectCount = 0;
 
     _resetColorMaskToAllEnabled = rhs._resetColorMaskToAllEnabled;
+
+    _numCullThreads = rhs._numCullThreads;
 }
 
 SceneView::~SceneView()
@@ -769,6 +777,272 @@ void SceneView::cull()
 
 }
 
+/** Culls contiguous ranges of the children of a split group on worker threads, the main CullVisitor culling the first range
+  * on the calling thread. Each main CullVisitor gets its own set of worker CullVisitors, StateGraphs and RenderStages so that
+  * the RenderLeaves merged into its RenderStage remain valid until that CullVisitor culls again, as with the serial cull.*/
+class SceneView::ParallelCull : public osg::Referenced
+{
+public:
+
+    struct Worker
+    {
+        Worker(): begin(0), end(0) {}
+
+        osg::ref_ptr<CullVisitor>   cullVisitor;
+        osg::ref_ptr<StateGraph>    stateGraph;
+        osg::ref_ptr<RenderStage>   renderStage;
+        unsigned int                begin;
+        unsigned int                end;
+    };
+
+    typedef std::vector<Worker> Workers;
+
+    class CullThread : public osg::Referenced, public OpenThreads::Thread
+    {
+    public:
+
+        CullThread(ParallelCull* parallelCull, unsigned int index):
+            _parallelCull(parallelCull),
+            _index(index) {}
+
+        virtual void run()
+        {
+            for(;;)
+            {
+                _parallelCull->_startBarrier.block();
+                if (_parallelCull->_done) break;
+
+                _parallelCull->cullWorker(_index);
+
+                _parallelCull->_endBarrier.block();
+            }
+        }
+
+    protected:
+
+        ParallelCull*   _parallelCull;
+        unsigned int    _index;
+    };
+
+    ParallelCull(unsigned int numThreads):
+        _startBarrier(numThreads),
+        _endBarrier(numThreads),
+        _done(false),
+        _sceneView(0),
+        _splitGroup(0),
+        _workers(0)
+    {
+        for(unsigned int i=1; i<numThreads; ++i)
+        {
+            osg::ref_ptr<CullThread> thread = new CullThread(this, i-1);
+            thread->startThread();
+            _threads.push_back(thread);
+        }
+    }
+
+    unsigned int getNumThreads() const { return static_cast<unsigned int>(_threads.size())+1; }
+
+    /** Hand out the ranges of the split group's children, the main CullVisitor's range is set on it, and release the worker threads.*/
+    void start(SceneView* sceneView, CullVisitor* cullVisitor, osg::Group* splitGroup, osg::RefMatrix* projection, osg::RefMatrix* modelview, osg::Viewport* viewport)
+    {
+        // drop the workers of CullVisitors that only the map still references, such as one the SceneView has replaced.
+        for(WorkersMap::iterator itr = _workersMap.begin(); itr != _workersMap.end(); )
+        {
+            if (itr->first->referenceCount()==1 && itr->first!=cullVisitor) _workersMap.erase(itr++);
+            else ++itr;
+        }
+
+        Workers& workers = _workersMap[cullVisitor];
+        if (workers.size()!=_threads.size())
+        {
+            workers.resize(_threads.size());
+            for(Workers::iterator itr = workers.begin(); itr != workers.end(); ++itr)
+            {
+                itr->cullVisitor = cullVisitor->clone();
+                itr->stateGraph = new StateGraph;
+                itr->renderStage = new RenderStage;
+            }
+        }
+
+        unsigned int numChildren = splitGroup->getNumChildren();
+        unsigned int numRanges = osg::minimum(getNumThreads(), numChildren);
+
+        cullVisitor->setTraversalSubset(splitGroup, 0, numChildren/numRanges);
+        for(unsigned int i=0; i<workers.size(); ++i)
+        {
+            unsigned int range = i+1;
+            workers[i].begin = range<numRanges ? (numChildren*range)/numRanges : numChildren;
+            workers[i].end = range<numRanges ? (numChildren*(range+1))/numRanges : numChildren;
+
+            // copy the occluders while the main CullVisitor isn't using them, reset() leaves them in place.
+            if (workers[i].begin<workers[i].end) workers[i].cullVisitor->getOccluderList() = cullVisitor->getOccluderList();
+
+            workers[i].cullVisitor->setSoftwareOcclusionBuffer(cullVisitor->getSoftwareOcclusionBuffer());
+        }
+
+        _sceneView = sceneView;
+        _cullVisitor = cullVisitor;
+        _splitGroup = splitGroup;
+        _projection = projection;
+        _modelview = modelview;
+        _viewport = viewport;
+        _workers = &workers;
+
+        _startBarrier.block();
+    }
+
+    /** Wait for the worker threads and merge their results into renderStage in range order.*/
+    void finish(CullVisitor* cullVisitor, RenderStage* renderStage)
+    {
+        _endBarrier.block();
+
+        // resolve the main CullVisitor's own near plane candidates before folding in those of the workers.
+        cullVisitor->computeNearPlane();
+
+        CullVisitor::value_type znear = cullVisitor->getCalculatedNearPlane();
+        CullVisitor::value_type zfar = cullVisitor->getCalculatedFarPlane();
+        unsigned int traversalOrderOffset = cullVisitor->getTraversalOrderNumber();
+
+        Workers& workers = *_workers;
+        for(Workers::iterator itr = workers.begin(); itr != workers.end(); ++itr)
+        {
+            if (itr->begin>=itr->end) continue;
+
+            CullVisitor* cv = itr->cullVisitor.get();
+            renderStage->merge(*(itr->renderStage), traversalOrderOffset);
+            traversalOrderOffset += cv->getTraversalOrderNumber();
+
+            znear = osg::minimum(znear, cv->getCalculatedNearPlane());
+            zfar = osg::maximum(zfar, cv->getCalculatedFarPlane());
+        }
+
+        // the popProjectionMatrix() of the main CullVisitor clamps the shared projection matrix to the combined near and far planes.
+        cullVisitor->setCalculatedNearPlane(znear);
+        cullVisitor->setCalculatedFarPlane(zfar);
+
+        _cullVisitor = 0;
+        _projection = 0;
+        _modelview = 0;
+        _viewport = 0;
+    }
+
+    void cullWorker(unsigned int index)
+    {
+        Worker& worker = (*_workers)[index];
+        if (worker.begin>=worker.end) return;
+
+        SceneView* sv = _sceneView;
+        CullVisitor* cv = worker.cullVisitor.get();
+        RenderStage* renderStage = worker.renderStage.get();
+
+        cv->reset();
+
+        cv->setFrameStamp(sv->_frameStamp.get());
+        if (sv->_frameStamp.valid()) cv->setTraversalNumber(sv->_frameStamp->getFrameNumber());
+
+        cv->inheritCullSettings(*sv);
+
+        // SceneView::cull() sets these on the main CullVisitor each frame, and per eye in stereo.
+        cv->setTraversalMask(_cullVisitor->getTraversalMask());
+        cv->setNodeMaskOverride(_cullVisitor->getNodeMaskOverride());
+        cv->setTraversalMode(_cullVisitor->getTraversalMode());
+
+        cv->setDatabaseRequestHandler(_cullVisitor->getDatabaseRequestHandler());
+        cv->setImageRequestHandler(_cullVisitor->getImageRequestHandler());
+
+        cv->setStateGraph(worker.stateGraph.get());
+        cv->setRenderStage(renderStage);
+        cv->setRenderInfo(sv->_renderInfo);
+
+        renderStage->reset();
+        worker.stateGraph->clean();
+
+        renderStage->setInitialViewMatrix(_modelview.get());
+        renderStage->setViewport(_viewport.get());
+        renderStage->setCamera(sv->_camera.get());
+
+        cv->setTraversalSubset(_splitGroup, worker.begin, worker.end);
+
+        if (sv->_globalStateSet.valid()) cv->pushStateSet(sv->_globalStateSet.get());
+        if (sv->_secondaryStateSet.valid()) cv->pushStateSet(sv->_secondaryStateSet.get());
+        if (sv->_localStateSet.valid()) cv->pushStateSet(sv->_localStateSet.get());
+
+        cv->pushViewport(_viewport.get());
+        cv->pushProjectionMatrix(_projection.get());
+        cv->pushModelViewMatrix(_modelview.get(),osg::Transform::ABSOLUTE_RF);
+
+        cv->traverseSubset(*(sv->_camera));
+
+        cv->popModelViewMatrix();
+
+        // don't clamp the shared projection matrix here, finish() passes the near and far planes on to the main CullVisitor.
+        cv->computeNearPlane();
+        cv->osg::CullStack::popProjectionMatrix();
+
+        cv->popViewport();
+
+        if (sv->_localStateSet.valid()) cv->popStateSet();
+        if (sv->_secondaryStateSet.valid()) cv->popStateSet();
+        if (sv->_globalStateSet.valid()) cv->popStateSet();
+
+        worker.stateGraph->prune();
+    }
+
+protected:
+
+    virtual ~ParallelCull()
+    {
+        _done = true;
+        _startBarrier.block();
+
+        for(CullThreads::iterator itr = _threads.begin(); itr != _threads.end(); ++itr)
+        {
+            (*itr)->join();
+        }
+    }
+
+    typedef std::vector< osg::ref_ptr<CullThread> > CullThreads;
+    typedef std::map< osg::ref_ptr<CullVisitor>, Workers > WorkersMap;
+
+    OpenThreads::Barrier            _startBarrier;
+    OpenThreads::Barrier            _endBarrier;
+    volatile bool                   _done;
+
+    CullThreads                     _threads;
+    WorkersMap                      _workersMap;
+
+    // state of the cull in progress, read by the worker threads between the start and end barriers.
+    SceneView*                      _sceneView;
+    osg::ref_ptr<CullVisitor>       _cullVisitor;
+    osg::Group*                     _splitGroup;
+    osg::ref_ptr<osg::RefMatrix>    _projection;
+    osg::ref_ptr<osg::RefMatrix>    _modelview;
+    osg::ref_ptr<osg::Viewport>     _viewport;
+    Workers*                        _workers;
+};
+
+void SceneView::setNumCullThreads(unsigned int numThreads)
+{
+    if (_numCullThreads==numThreads) return;
+
+    _numCullThreads = numThreads;
+
+    // the worker threads are recreated on the next cull.
+    _parallelCull = 0;
+}
+
+osg::Group* SceneView::findCullSplitGroup() const
+{
+    osg::Group* group = _camera.get();
+    while(group && group->getNumChildren()==1)
+    {
+        osg::Group* child = group->getChild(0)->asGroup();
+        group = (child && typeid(*child)==typeid(osg::Group) && !child->getCullCallback()) ? child : 0;
+    }
+
+    return (group && group->getNumChildren()>1) ? group : 0;
+}
+
 bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& modelview,osgUtil::CullVisitor* cullVisitor, osgUtil::StateGraph* rendergraph, osgUtil::RenderStage* renderStage, osg::Viewport *viewport)
 {
 
@@ -818,6 +1092,10 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
         std::copy(_collectOccludersVisitor->getCollectedOccluderSet().begin(),_collectOccludersVisitor->getCollectedOccluderSet().end(), std::back_insert_iterator<CullStack::OccluderList>(cullVisitor->getOccluderList()));
     }
 
+    // rasterize the occluders of the software occlusion buffer as seen from this view.
+    SoftwareOcclusionBuffer* softwareOcclusionBuffer = cullVisitor->getSoftwareOcclusionBuffer();
+    if (softwareOcclusionBuffer) softwareOcclusionBuffer->build(modelview, projection);
+
 
 
     cullVisitor->reset();
@@ -889,8 +1167,20 @@ bool SceneView::cullStage(const osg::Matrixd& projection,const osg::Matrixd& mod
     // requirement that it must traverse the camera's children.
     {
        osg::Callback* callback = _camera->getCullCallback();
+       osg::Group* splitGroup = (_numCullThreads>1 && !callback) ? findCullSplitGroup() : 0;
        if (callback) callback->run(_camera.get(), cullVisitor);
-       else cullVisitor->traverse(*_camera);
+       else if (!splitGroup) cullVisitor->traverse(*_camera);
+       else
+       {
+           if (!_parallelCull) _parallelCull = new ParallelCull(_numCullThreads);
+
+           // compute any dirty bounding volumes up front so the cull threads only read them.
+           _camera->getBound();
+
+           _parallelCull->start(this, cullVisitor, splitGroup, proj.get(), mv.get(), viewport);
+           cullVisitor->traverseSubset(*_camera);
+           _parallelCull->finish(cullVisitor, renderStage);
+       }
     }
 
 
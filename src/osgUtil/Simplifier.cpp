@@ -12,15 +12,22 @@
 */
 
 #include <osg/TriangleIndexFunctor>
+#include <osg/Plane>
+#include <osg/BoundingBox>
 
 #include <osgUtil/Simplifier>
 
 #include <osgUtil/SmoothingVisitor>
 #include <osgUtil/MeshOptimizers>
 
+#include <OpenThreads/Thread>
+
 #include <set>
 #include <list>
+#include <queue>
+#include <functional>
 #include <algorithm>
+#include <float.h>
 
 #include <iterator>
 
@@ -1719,90 +1726,1337 @@ void EdgeCollapse::copyBackToGeometry()
 }
 
 
-Simplifier::Simplifier(double sampleRatio, double maximumError, double maximumLength):
-            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
-            _sampleRatio(sampleRatio),
-            _maximumError(maximumError),
-            _maximumLength(maximumLength),
-            _triStrip(true),
-            _smoothing(true)
+////////////////////////////////////////////////////////////////////////////////
+//
+// Quadric error metric edge collapse, used for down sampling.
+//
+// The mesh is held in flat arrays indexed by point and triangle, with the triangles around each point listed in a
+// shared array of references, and the candidate collapses kept in a binary heap whose out of date entries are
+// skipped as they reach the top.
 
+namespace
 {
-}
 
-void Simplifier::simplify(osg::Geometry& geometry)
+typedef std::vector<unsigned int> IndexList;
+
+/** Sum of the squared distances from a set of planes, stored as the upper half of a symmetric 4x4 matrix,
+  * along with the number of planes for computing the root mean square distance.*/
+struct Quadric
 {
-    // pass an empty list of indices to simply(Geometry,IndexList)
-    // so that this one method handle both cases of non protected indices
-    // and specified indices.
-    IndexList emptyList;
-    simplify(geometry,emptyList);
-}
+    Quadric(): a2(0.0), ab(0.0), ac(0.0), ad(0.0), b2(0.0), bc(0.0), bd(0.0), c2(0.0), cd(0.0), d2(0.0), weight(0.0) {}
 
-void Simplifier::simplify(osg::Geometry& geometry, const IndexList& protectedPoints)
+    Quadric(const osg::Plane& plane):
+        weight(1.0)
+    {
+        double a = plane[0], b = plane[1], c = plane[2], d = plane[3];
+        a2 = a*a; ab = a*b; ac = a*c; ad = a*d;
+        b2 = b*b; bc = b*c; bd = b*d;
+        c2 = c*c; cd = c*d;
+        d2 = d*d;
+    }
+
+    Quadric& operator += (const Quadric& rhs)
+    {
+        a2 += rhs.a2; ab += rhs.ab; ac += rhs.ac; ad += rhs.ad;
+        b2 += rhs.b2; bc += rhs.bc; bd += rhs.bd;
+        c2 += rhs.c2; cd += rhs.cd;
+        d2 += rhs.d2;
+        weight += rhs.weight;
+        return *this;
+    }
+
+    Quadric& operator -= (const Quadric& rhs)
+    {
+        a2 -= rhs.a2; ab -= rhs.ab; ac -= rhs.ac; ad -= rhs.ad;
+        b2 -= rhs.b2; bc -= rhs.bc; bd -= rhs.bd;
+        c2 -= rhs.c2; cd -= rhs.cd;
+        d2 -= rhs.d2;
+        weight -= rhs.weight;
+        return *this;
+    }
+
+    double evaluate(const osg::Vec3d& v) const
+    {
+        double x = v.x(), y = v.y(), z = v.z();
+        return a2*x*x + 2.0*ab*x*y + 2.0*ac*x*z + 2.0*ad*x +
+               b2*y*y + 2.0*bc*y*z + 2.0*bd*y +
+               c2*z*z + 2.0*cd*z +
+               d2;
+    }
+
+    /** Compute the point minimizing the error, return false if it isn't well defined, as for flat or straight regions.*/
+    bool optimize(osg::Vec3d& v) const
+    {
+        double det = a2*(b2*c2-bc*bc) - ab*(ab*c2-bc*ac) + ac*(ab*bc-b2*ac);
+
+        // the planes are normalized so the trace of the matrix is the weight, and a determinant small relative to it is singular.
+        if (fabs(det)<=1e-6*weight*weight*weight) return false;
+
+        double invDet = 1.0/det;
+        v.x() = -invDet*(ad*(b2*c2-bc*bc) - bd*(ab*c2-ac*bc) + cd*(ab*bc-ac*b2));
+        v.y() = -invDet*(a2*(bd*c2-cd*bc) - ab*(ad*c2-cd*ac) + ac*(ad*bc-bd*ac));
+        v.z() = -invDet*(a2*(b2*cd-bc*bd) - ab*(ab*cd-bc*ad) + ac*(ab*bd-b2*ad));
+        return true;
+    }
+
+    double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+    double weight;
+};
+
+/** Triangle mesh of welded points, each with its position, interleaved attributes and quadric.*/
+struct SimplifierMesh
 {
-    OSG_INFO<<"++++++++++++++simplifier************"<<std::endl;
+    SimplifierMesh(): numAttributes(0) {}
+
+    inline unsigned int getNumPoints() const { return static_cast<unsigned int>(positions.size()); }
+    inline unsigned int getNumTriangles() const { return static_cast<unsigned int>(triangles.size()/3); }
+
+    std::vector<osg::Vec3>      positions;
+    unsigned int                numAttributes;
+    std::vector<float>          attributes;
+    std::vector<Quadric>        quadrics;
+    std::vector<unsigned char>  locked;
+    IndexList                   triangles;
+};
+
+class QuadricEdgeCollapse
+{
+public:
 
-    bool downSample = requiresDownSampling();
+    QuadricEdgeCollapse(SimplifierMesh& mesh):
+        _mesh(mesh),
+        _numTriangles(mesh.getNumTriangles()),
+        _removed(mesh.getNumTriangles(), 0),
+        _locked(mesh.locked),
+        _alive(mesh.getNumPoints(), 1),
+        _version(mesh.getNumPoints(), 0),
+        _marks(mesh.getNumPoints(), 0),
+        _stamp(0),
+        _maximumError(0.0f)
+    {
+        buildAdjacency();
+        lockBorders();
+
+        for(unsigned int p=0; p<_mesh.getNumPoints(); ++p)
+        {
+            pushCollapses(p, true);
+        }
+    }
 
-    EdgeCollapse ec;
-    ec.setComputeErrorMetricUsingLength(!downSample);
-    ec.setGeometry(&geometry, protectedPoints);
-    ec.updateErrorMetricForAllEdges();
+    unsigned int getNumTriangles() const { return _numTriangles; }
 
-    unsigned int numOriginalPrimitives = ec._triangleSet.size();
+    /** Get the largest error of the collapses made so far.*/
+    float getMaximumError() const { return _maximumError; }
 
+    unsigned int getNumLockedPoints() const { return static_cast<unsigned int>(std::count(_locked.begin(), _locked.end(), 1)); }
 
-    if (downSample)
+    /** Collapse edges in order of increasing error until the simplifier asks to stop, none can be collapsed
+      * or the number of triangles falls to minimumTriangles. The collapse which stopped the simplification is
+      * kept, so that it may be called again to continue on to a further target.*/
+    void simplify(const Simplifier& simplifier, unsigned int numOriginalTriangles, unsigned int minimumTriangles)
     {
-        while (!ec._edgeSet.empty() &&
-               continueSimplification((*ec._edgeSet.begin())->getErrorMetric() , numOriginalPrimitives, ec._triangleSet.size()) &&
-               ec.collapseMinimumErrorEdge())
+        while(!_heap.empty())
         {
-           //OSG_INFO<<"   Collapsed edge ec._triangleSet.size()="<<ec._triangleSet.size()<<" error="<<(*ec._edgeSet.begin())->getErrorMetric()<<" vs "<<getMaximumError()<<std::endl;
+            Collapse top = _heap.top();
+
+            // skip collapses computed before either point last changed.
+            if (!_alive[top.p1] || !_alive[top.p2] || _version[top.p1]!=top.version1 || _version[top.p2]!=top.version2)
+            {
+                _heap.pop();
+                continue;
+            }
+
+            if (_numTriangles<=minimumTriangles || !simplifier.continueSimplification(top.error, numOriginalTriangles, _numTriangles)) break;
+
+            _heap.pop();
+
+            Candidate candidate;
+            if (!evaluate(top.p1, top.p2, candidate) || !isCollapseValid(candidate)) continue;
+
+            collapse(candidate);
+            _maximumError = osg::maximum(_maximumError, candidate.error);
+
+            // the lists of triangles around the points grow with each collapse, so are rebuilt once mostly out of date.
+            if (_triangleRefs.size()>_numTriangles*12+1024) buildAdjacency();
         }
+    }
 
-        OSG_INFO<<"******* AFTER EDGE COLLAPSE *********"<<ec._triangleSet.size()<<std::endl;
+    /** Copy the remaining triangles, leaving the mesh unchanged.*/
+    void getTriangles(IndexList& triangles) const
+    {
+        triangles.clear();
+        triangles.reserve(_numTriangles*3);
+        for(unsigned int t=0; t<_removed.size(); ++t)
+        {
+            if (!_removed[t]) triangles.insert(triangles.end(), _mesh.triangles.begin()+t*3, _mesh.triangles.begin()+t*3+3);
+        }
     }
-    else
+
+    /** Remove the collapsed triangles from the mesh.*/
+    void compactTriangles()
     {
+        IndexList& triangles = _mesh.triangles;
+        unsigned int numTriangles = _mesh.getNumTriangles();
+        unsigned int pos = 0;
+        for(unsigned int t=0; t<numTriangles; ++t)
+        {
+            if (_removed[t]) continue;
+            triangles[pos++] = triangles[t*3];
+            triangles[pos++] = triangles[t*3+1];
+            triangles[pos++] = triangles[t*3+2];
+        }
+        triangles.resize(pos);
+    }
 
-        // up sampling...
-        while (!ec._edgeSet.empty() &&
-               continueSimplification((*ec._edgeSet.rbegin())->getErrorMetric() , numOriginalPrimitives, ec._triangleSet.size()) &&
-//               ec._triangleSet.size() < targetNumTriangles  &&
-               ec.divideLongestEdge())
+protected:
+
+    QuadricEdgeCollapse& operator = (const QuadricEdgeCollapse&) { return *this; }
+
+    struct Collapse
+    {
+        float           error;
+        unsigned int    p1, p2;
+        unsigned int    version1, version2;
+
+        bool operator > (const Collapse& rhs) const { return error>rhs.error; }
+    };
+
+    typedef std::priority_queue< Collapse, std::vector<Collapse>, std::greater<Collapse> > CollapseHeap;
+
+    /** Collapse of the edge between the kept and removed points, moving the kept point to position with its
+      * attributes interpolated the ratio of the way towards those of the removed point.*/
+    struct Candidate
+    {
+        unsigned int    keep;
+        unsigned int    remove;
+        osg::Vec3d      position;
+        float           ratio;
+        float           error;
+    };
+
+    void buildAdjacency()
+    {
+        const IndexList& triangles = _mesh.triangles;
+        unsigned int numPoints = _mesh.getNumPoints();
+        unsigned int numTriangles = _mesh.getNumTriangles();
+
+        _refCount.assign(numPoints, 0);
+        for(unsigned int t=0; t<numTriangles; ++t)
         {
-           //OSG_INFO<<"   Edge divided ec._triangleSet.size()="<<ec._triangleSet.size()<<" error="<<(*ec._edgeSet.rbegin())->getErrorMetric()<<" vs "<<getMaximumError()<<std::endl;
+            if (_removed[t]) continue;
+            ++_refCount[triangles[t*3]];
+            ++_refCount[triangles[t*3+1]];
+            ++_refCount[triangles[t*3+2]];
+        }
+
+        _refStart.resize(numPoints);
+        unsigned int start = 0;
+        for(unsigned int p=0; p<numPoints; ++p)
+        {
+            _refStart[p] = start;
+            start += _refCount[p];
+            _refCount[p] = 0;
+        }
+
+        _triangleRefs.resize(start);
+        for(unsigned int t=0; t<numTriangles; ++t)
+        {
+            if (_removed[t]) continue;
+            for(unsigned int i=0; i<3; ++i)
+            {
+                unsigned int p = triangles[t*3+i];
+                _triangleRefs[_refStart[p] + _refCount[p]++] = t;
+            }
+        }
+    }
+
+    /** Lock the points on edges not shared by exactly two triangles, which are the open borders, seams and non manifold edges.*/
+    void lockBorders()
+    {
+        typedef std::pair<unsigned int, unsigned int> PointPair;
+        std::vector<PointPair> edges;
+        edges.reserve(_mesh.triangles.size());
+
+        const IndexList& triangles = _mesh.triangles;
+        unsigned int numTriangles = _mesh.getNumTriangles();
+        for(unsigned int t=0; t<numTriangles; ++t)
+        {
+            for(unsigned int i=0; i<3; ++i)
+            {
+                unsigned int p1 = triangles[t*3+i];
+                unsigned int p2 = triangles[t*3+(i+1)%3];
+                edges.push_back(p1<p2 ? PointPair(p1,p2) : PointPair(p2,p1));
+            }
+        }
+
+        std::sort(edges.begin(), edges.end());
+
+        for(std::vector<PointPair>::iterator itr = edges.begin(); itr != edges.end(); )
+        {
+            std::vector<PointPair>::iterator end = itr+1;
+            while(end!=edges.end() && *end==*itr) ++end;
+
+            if (end-itr!=2)
+            {
+                _locked[itr->first] = 1;
+                _locked[itr->second] = 1;
+            }
+
+            itr = end;
         }
-        OSG_INFO<<"******* AFTER EDGE DIVIDE *********"<<ec._triangleSet.size()<<std::endl;
     }
 
-    OSG_INFO<<"Number of triangle errors after edge collapse= "<<ec.testAllTriangles()<<std::endl;
-    OSG_INFO<<"Number of edge errors before edge collapse= "<<ec.testAllEdges()<<std::endl;
-    OSG_INFO<<"Number of point errors after edge collapse= "<<ec.testAllPoints()<<std::endl;
-    OSG_INFO<<"Number of triangles= "<<ec._triangleSet.size()<<std::endl;
-    OSG_INFO<<"Number of points= "<<ec._pointSet.size()<<std::endl;
-    OSG_INFO<<"Number of edges= "<<ec._edgeSet.size()<<std::endl;
-    OSG_INFO<<"Number of boundary edges= "<<ec.computeNumBoundaryEdges()<<std::endl;
+    inline const unsigned int* trianglePoints(unsigned int t) const { return &_mesh.triangles[t*3]; }
 
-    if (!ec._edgeSet.empty())
+    inline bool containsPoint(unsigned int t, unsigned int p) const
     {
-        OSG_INFO<<std::endl<<"Simplifier, in = "<<numOriginalPrimitives<<"\tout = "<<ec._triangleSet.size()<<"\terror="<<(*ec._edgeSet.begin())->getErrorMetric()<<"\tvs "<<getMaximumError()<<std::endl<<std::endl;
-        OSG_INFO<<           "        !ec._edgeSet.empty()  = "<<!ec._edgeSet.empty()<<std::endl;
-        OSG_INFO<<           "        continueSimplification(,,)  = "<<continueSimplification((*ec._edgeSet.begin())->getErrorMetric() , numOriginalPrimitives, ec._triangleSet.size())<<std::endl;
+        const unsigned int* points = trianglePoints(t);
+        return points[0]==p || points[1]==p || points[2]==p;
     }
 
-    ec.copyBackToGeometry();
+    bool evaluate(unsigned int p1, unsigned int p2, Candidate& candidate) const
+    {
+        if (_locked[p1] && _locked[p2]) return false;
+
+        Quadric quadric = _mesh.quadrics[p1];
+        quadric += _mesh.quadrics[p2];
 
-    if (_smoothing)
+        osg::Vec3d v1(_mesh.positions[p1]);
+        osg::Vec3d v2(_mesh.positions[p2]);
+
+        if (_locked[p1] || _locked[p2])
+        {
+            // a locked point stays where it is, taking the other with it.
+            candidate.keep = _locked[p1] ? p1 : p2;
+            candidate.remove = _locked[p1] ? p2 : p1;
+            candidate.position = _locked[p1] ? v1 : v2;
+            candidate.ratio = 0.0f;
+        }
+        else
+        {
+            candidate.keep = p1;
+            candidate.remove = p2;
+
+            // choose the lowest error of the end points, the mid point and the optimal point if it lies near the edge.
+            osg::Vec3d edge = v2-v1;
+            double edgeLength2 = edge.length2();
+
+            osg::Vec3d positions[4];
+            float ratios[4];
+            unsigned int numPositions = 0;
+            positions[numPositions] = v1; ratios[numPositions++] = 0.0f;
+            positions[numPositions] = v2; ratios[numPositions++] = 1.0f;
+            positions[numPositions] = (v1+v2)*0.5; ratios[numPositions++] = 0.5f;
+
+            osg::Vec3d optimal;
+            if (quadric.optimize(optimal) && (optimal-positions[2]).length2()<=edgeLength2 && edgeLength2>0.0)
+            {
+                positions[numPositions] = optimal;
+                ratios[numPositions++] = osg::clampBetween(static_cast<float>(((optimal-v1)*edge)/edgeLength2), 0.0f, 1.0f);
+            }
+
+            double minError = DBL_MAX;
+            for(unsigned int i=0; i<numPositions; ++i)
+            {
+                double error = quadric.evaluate(positions[i]);
+                if (error<minError)
+                {
+                    minError = error;
+                    candidate.position = positions[i];
+                    candidate.ratio = ratios[i];
+                }
+            }
+        }
+
+        double error = quadric.weight>0.0 ? quadric.evaluate(candidate.position)/quadric.weight : 0.0;
+        candidate.error = static_cast<float>(sqrt(osg::maximum(error, 0.0)));
+        return true;
+    }
+
+    /** Return true if the collapse keeps the mesh manifold and doesn't flip any of the triangles around it.*/
+    bool isCollapseValid(const Candidate& candidate)
     {
-        osgUtil::SmoothingVisitor::smooth(geometry);
+        unsigned int keep = candidate.keep;
+        unsigned int remove = candidate.remove;
+
+        // the points neighbouring both ends of the edge must be just the far corners of the two triangles sharing it.
+        _stamp += 2;
+        unsigned int numShared = 0;
+        for(unsigned int i=0; i<_refCount[keep]; ++i)
+        {
+            unsigned int t = _triangleRefs[_refStart[keep]+i];
+            if (_removed[t]) continue;
+            if (containsPoint(t, remove)) ++numShared;
+
+            const unsigned int* points = trianglePoints(t);
+            for(unsigned int j=0; j<3; ++j) _marks[points[j]] = _stamp;
+        }
+
+        if (numShared!=2) return false;
+
+        unsigned int numCommonNeighbours = 0;
+        for(unsigned int i=0; i<_refCount[remove]; ++i)
+        {
+            unsigned int t = _triangleRefs[_refStart[remove]+i];
+            if (_removed[t]) continue;
+
+            const unsigned int* points = trianglePoints(t);
+            for(unsigned int j=0; j<3; ++j)
+            {
+                unsigned int p = points[j];
+                if (p!=keep && p!=remove && _marks[p]==_stamp)
+                {
+                    _marks[p] = _stamp+1;
+                    ++numCommonNeighbours;
+                }
+            }
+        }
+
+        if (numCommonNeighbours!=2) return false;
+
+        return !flipsTriangles(keep, remove, candidate.position) && !flipsTriangles(remove, keep, candidate.position);
     }
 
-    if (_triStrip)
+    /** Return true if moving point p to position turns any of its triangles not shared with other by more than about 75 degrees,
+      * which rejects collapses folding the mesh over as well as those squashing triangles into slivers.*/
+    bool flipsTriangles(unsigned int p, unsigned int other, const osg::Vec3d& position) const
     {
-        osgUtil::optimizeMesh(&geometry);
+        for(unsigned int i=0; i<_refCount[p]; ++i)
+        {
+            unsigned int t = _triangleRefs[_refStart[p]+i];
+            if (_removed[t] || containsPoint(t, other)) continue;
+
+            const unsigned int* points = trianglePoints(t);
+            osg::Vec3d v[3];
+            for(unsigned int j=0; j<3; ++j) v[j] = _mesh.positions[points[j]];
+
+            osg::Vec3d normal = (v[1]-v[0]) ^ (v[2]-v[0]);
+
+            for(unsigned int j=0; j<3; ++j)
+            {
+                if (points[j]==p) v[j] = position;
+            }
+
+            osg::Vec3d newNormal = (v[1]-v[0]) ^ (v[2]-v[0]);
+            if (newNormal*normal<=0.25*newNormal.length()*normal.length()) return true;
+        }
+        return false;
+    }
+
+    void collapse(const Candidate& candidate)
+    {
+        unsigned int keep = candidate.keep;
+        unsigned int remove = candidate.remove;
+
+        // remove the triangles sharing the edge and move the rest of the removed point's triangles across to the kept point.
+        for(unsigned int i=0; i<_refCount[remove]; ++i)
+        {
+            unsigned int t = _triangleRefs[_refStart[remove]+i];
+            if (_removed[t]) continue;
+
+            unsigned int* points = &_mesh.triangles[t*3];
+            if (points[0]==keep || points[1]==keep || points[2]==keep)
+            {
+                _removed[t] = 1;
+                --_numTriangles;
+            }
+            else
+            {
+                for(unsigned int j=0; j<3; ++j)
+                {
+                    if (points[j]==remove) points[j] = keep;
+                }
+            }
+        }
+
+        _mesh.positions[keep] = candidate.position;
+        if (candidate.ratio!=0.0f)
+        {
+            float* keepAttributes = &_mesh.attributes[keep*_mesh.numAttributes];
+            const float* removeAttributes = &_mesh.attributes[remove*_mesh.numAttributes];
+            for(unsigned int i=0; i<_mesh.numAttributes; ++i)
+            {
+                keepAttributes[i] = keepAttributes[i]*(1.0f-candidate.ratio) + removeAttributes[i]*candidate.ratio;
+            }
+        }
+        _mesh.quadrics[keep] += _mesh.quadrics[remove];
+
+        _alive[remove] = 0;
+        ++_version[keep];
+
+        // append the merged list of triangles for the kept point.
+        unsigned int start = static_cast<unsigned int>(_triangleRefs.size());
+        for(unsigned int i=0; i<_refCount[keep]; ++i)
+        {
+            unsigned int t = _triangleRefs[_refStart[keep]+i];
+            if (!_removed[t]) _triangleRefs.push_back(t);
+        }
+        for(unsigned int i=0; i<_refCount[remove]; ++i)
+        {
+            unsigned int t = _triangleRefs[_refStart[remove]+i];
+            if (!_removed[t]) _triangleRefs.push_back(t);
+        }
+        _refStart[keep] = start;
+        _refCount[keep] = static_cast<unsigned int>(_triangleRefs.size())-start;
+        _refCount[remove] = 0;
+
+        pushCollapses(keep, false);
+    }
+
+    /** Add the collapses of the edges from point p to its neighbours, or just those with higher indices when
+      * adding the edges of all the points so that each edge is added once.*/
+    void pushCollapses(unsigned int p, bool higherNeighboursOnly)
+    {
+        _stamp += 2;
+        _marks[p] = _stamp;
+
+        for(unsigned int i=0; i<_refCount[p]; ++i)
+        {
+            unsigned int t = _triangleRefs[_refStart[p]+i];
+            if (_removed[t]) continue;
+
+            const unsigned int* points = trianglePoints(t);
+            for(unsigned int j=0; j<3; ++j)
+            {
+                unsigned int neighbour = points[j];
+                if (_marks[neighbour]==_stamp) continue;
+                _marks[neighbour] = _stamp;
+
+                if (higherNeighboursOnly && neighbour<p) continue;
+
+                Candidate candidate;
+                if (!evaluate(p, neighbour, candidate)) continue;
+
+                Collapse collapse;
+                collapse.error = candidate.error;
+                collapse.p1 = p;
+                collapse.p2 = neighbour;
+                collapse.version1 = _version[p];
+                collapse.version2 = _version[neighbour];
+                _heap.push(collapse);
+            }
+        }
+    }
+
+    SimplifierMesh&             _mesh;
+    unsigned int                _numTriangles;
+    std::vector<unsigned char>  _removed;
+    std::vector<unsigned char>  _locked;
+    std::vector<unsigned char>  _alive;
+    std::vector<unsigned int>   _version;
+
+    IndexList                   _refStart;
+    IndexList                   _refCount;
+    IndexList                   _triangleRefs;
+
+    // stamps marking the points visited by the current neighbourhood search.
+    std::vector<unsigned int>   _marks;
+    unsigned int                _stamp;
+
+    CollapseHeap                _heap;
+    float                       _maximumError;
+};
+
+}
+
+namespace
+{
+
+struct CollectTriangleIndicesOperator
+{
+    CollectTriangleIndicesOperator(): _triangles(0) {}
+
+    inline void operator()(unsigned int p1, unsigned int p2, unsigned int p3)
+    {
+        _triangles->push_back(p1);
+        _triangles->push_back(p2);
+        _triangles->push_back(p3);
+    }
+
+    IndexList* _triangles;
+};
+
+typedef osg::TriangleIndexFunctor<CollectTriangleIndicesOperator> CollectTriangleIndicesFunctor;
+
+class VertexArrayToPositionsVisitor : public osg::ArrayVisitor
+{
+    public:
+        VertexArrayToPositionsVisitor(std::vector<osg::Vec3>& positions):
+            _positions(positions) {}
+
+        virtual void apply(osg::Vec2Array& array)
+        {
+            _positions.resize(array.size());
+            for(unsigned int i=0;i<array.size();++i) _positions[i].set(array[i].x(),array[i].y(),0.0f);
+        }
+
+        virtual void apply(osg::Vec3Array& array)
+        {
+            _positions.assign(array.begin(),array.end());
+        }
+
+        virtual void apply(osg::Vec4Array& array)
+        {
+            _positions.resize(array.size());
+            for(unsigned int i=0;i<array.size();++i)
+            {
+                const osg::Vec4& value = array[i];
+                _positions[i].set(value.x()/value.w(),value.y()/value.w(),value.z()/value.w());
+            }
+        }
+
+        std::vector<osg::Vec3>& _positions;
+
+    protected:
+
+        VertexArrayToPositionsVisitor& operator = (const VertexArrayToPositionsVisitor&) { return *this; }
+};
+
+class PositionsToVertexArrayVisitor : public osg::ArrayVisitor
+{
+    public:
+        PositionsToVertexArrayVisitor(const std::vector<osg::Vec3>& positions, const IndexList& pointIndices):
+            _positions(positions),
+            _pointIndices(pointIndices) {}
+
+        virtual void apply(osg::Vec2Array& array)
+        {
+            array.resize(_pointIndices.size());
+            for(unsigned int i=0;i<_pointIndices.size();++i)
+            {
+                const osg::Vec3& position = _positions[_pointIndices[i]];
+                array[i].set(position.x(),position.y());
+            }
+        }
+
+        virtual void apply(osg::Vec3Array& array)
+        {
+            array.resize(_pointIndices.size());
+            for(unsigned int i=0;i<_pointIndices.size();++i) array[i] = _positions[_pointIndices[i]];
+        }
+
+        virtual void apply(osg::Vec4Array& array)
+        {
+            array.resize(_pointIndices.size());
+            for(unsigned int i=0;i<_pointIndices.size();++i)
+            {
+                const osg::Vec3& position = _positions[_pointIndices[i]];
+                array[i].set(position.x(),position.y(),position.z(),1.0f);
+            }
+        }
+
+        const std::vector<osg::Vec3>&   _positions;
+        const IndexList&                _pointIndices;
+
+    protected:
+
+        PositionsToVertexArrayVisitor& operator = (const PositionsToVertexArrayVisitor&) { return *this; }
+};
+
+/** Per vertex array whose values are interpolated along with the positions, held as floats while simplifying.
+  * The array is identified by its place in the geometry, so that copies of the geometry can be written to.*/
+struct AttributeArray
+{
+    enum Type
+    {
+        TEXCOORD,
+        NORMAL,
+        COLOR,
+        SECONDARY_COLOR,
+        FOG_COORD,
+        VERTEX_ATTRIB
+    };
+
+    AttributeArray(): type(TEXCOORD), unit(0), offset(0), numComponents(0) {}
+
+    osg::Array* getArray(osg::Geometry& geometry) const
+    {
+        switch(type)
+        {
+            case(TEXCOORD): return geometry.getTexCoordArray(unit);
+            case(NORMAL): return geometry.getNormalArray();
+            case(COLOR): return geometry.getColorArray();
+            case(SECONDARY_COLOR): return geometry.getSecondaryColorArray();
+            case(FOG_COORD): return geometry.getFogCoordArray();
+            case(VERTEX_ATTRIB): return geometry.getVertexAttribArray(unit);
+        }
+        return 0;
+    }
+
+    Type                type;
+    unsigned int        unit;
+    unsigned int        offset;
+    unsigned int        numComponents;
+    std::vector<float>  values;
+};
+
+typedef std::vector<AttributeArray> AttributeArrayList;
+
+class ArrayToAttributesVisitor : public osg::ArrayVisitor
+{
+    public:
+        ArrayToAttributesVisitor(AttributeArray& attributeArray, unsigned int numVertices):
+            _attributeArray(attributeArray),
+            _numVertices(numVertices) {}
+
+        template<class A>
+        void copyScalars(A& array)
+        {
+            if (array.size()!=_numVertices) return;
+
+            _attributeArray.numComponents = 1;
+            _attributeArray.values.resize(_numVertices);
+            for(unsigned int i=0;i<_numVertices;++i) _attributeArray.values[i] = (float)array[i];
+        }
+
+        template<class A>
+        void copyVectors(A& array)
+        {
+            if (array.size()!=_numVertices) return;
+
+            const unsigned int numComponents = A::ElementDataType::num_components;
+            _attributeArray.numComponents = numComponents;
+            _attributeArray.values.resize(_numVertices*numComponents);
+            for(unsigned int i=0;i<_numVertices;++i)
+            {
+                for(unsigned int c=0;c<numComponents;++c) _attributeArray.values[i*numComponents+c] = (float)array[i][c];
+            }
+        }
+
+        virtual void apply(osg::Array&) {}
+        virtual void apply(osg::ByteArray& array) { copyScalars(array); }
+        virtual void apply(osg::ShortArray& array) { copyScalars(array); }
+        virtual void apply(osg::IntArray& array) { copyScalars(array); }
+        virtual void apply(osg::UByteArray& array) { copyScalars(array); }
+        virtual void apply(osg::UShortArray& array) { copyScalars(array); }
+        virtual void apply(osg::UIntArray& array) { copyScalars(array); }
+        virtual void apply(osg::FloatArray& array) { copyScalars(array); }
+        virtual void apply(osg::Vec4ubArray& array) { copyVectors(array); }
+        virtual void apply(osg::Vec2Array& array) { copyVectors(array); }
+        virtual void apply(osg::Vec3Array& array) { copyVectors(array); }
+        virtual void apply(osg::Vec4Array& array) { copyVectors(array); }
+
+        AttributeArray& _attributeArray;
+        unsigned int    _numVertices;
+
+    protected:
+
+        ArrayToAttributesVisitor& operator = (const ArrayToAttributesVisitor&) { return *this; }
+};
+
+class AttributesToArrayVisitor : public osg::ArrayVisitor
+{
+    public:
+        AttributesToArrayVisitor(const SimplifierMesh& mesh, const AttributeArray& attributeArray, const IndexList& pointIndices):
+            _mesh(mesh),
+            _attributeArray(attributeArray),
+            _pointIndices(pointIndices) {}
+
+        inline float value(unsigned int i, unsigned int c) const
+        {
+            return _mesh.attributes[_pointIndices[i]*_mesh.numAttributes + _attributeArray.offset + c];
+        }
+
+        template<class A>
+        void copyScalars(A& array)
+        {
+            typedef typename A::ElementDataType T;
+
+            array.resize(_pointIndices.size());
+            for(unsigned int i=0;i<_pointIndices.size();++i) array[i] = T(value(i,0));
+        }
+
+        template<class A>
+        void copyVectors(A& array)
+        {
+            typedef typename A::ElementDataType::value_type T;
+            const unsigned int numComponents = A::ElementDataType::num_components;
+
+            array.resize(_pointIndices.size());
+            for(unsigned int i=0;i<_pointIndices.size();++i)
+            {
+                for(unsigned int c=0;c<numComponents;++c) array[i][c] = T(value(i,c));
+            }
+        }
+
+        virtual void apply(osg::Array&) {}
+        virtual void apply(osg::ByteArray& array) { copyScalars(array); }
+        virtual void apply(osg::ShortArray& array) { copyScalars(array); }
+        virtual void apply(osg::IntArray& array) { copyScalars(array); }
+        virtual void apply(osg::UByteArray& array) { copyScalars(array); }
+        virtual void apply(osg::UShortArray& array) { copyScalars(array); }
+        virtual void apply(osg::UIntArray& array) { copyScalars(array); }
+        virtual void apply(osg::FloatArray& array) { copyScalars(array); }
+        virtual void apply(osg::Vec4ubArray& array) { copyVectors(array); }
+        virtual void apply(osg::Vec2Array& array) { copyVectors(array); }
+        virtual void apply(osg::Vec3Array& array) { copyVectors(array); }
+        virtual void apply(osg::Vec4Array& array) { copyVectors(array); }
+
+        const SimplifierMesh&   _mesh;
+        const AttributeArray&   _attributeArray;
+        const IndexList&        _pointIndices;
+
+    protected:
+
+        AttributesToArrayVisitor& operator = (const AttributesToArrayVisitor&) { return *this; }
+};
+
+void addAttributeArray(AttributeArrayList& attributeArrays, osg::Geometry& geometry, AttributeArray::Type type, unsigned int unit, unsigned int numVertices)
+{
+    AttributeArray attributeArray;
+    attributeArray.type = type;
+    attributeArray.unit = unit;
+
+    osg::Array* array = attributeArray.getArray(geometry);
+    if (!array || array->getBinding()!=osg::Array::BIND_PER_VERTEX) return;
+
+    ArrayToAttributesVisitor copyArrayToAttributes(attributeArray, numVertices);
+    array->accept(copyArrayToAttributes);
+
+    if (attributeArray.numComponents>0) attributeArrays.push_back(attributeArray);
+}
+
+/** Orders vertices by position then attributes, so that vertices matching in all of them are adjacent.*/
+struct VertexLess
+{
+    VertexLess(const std::vector<osg::Vec3>& positions, const std::vector<float>& attributes, unsigned int numAttributes):
+        _positions(positions),
+        _attributes(attributes),
+        _numAttributes(numAttributes) {}
+
+    inline bool operator() (unsigned int lhs, unsigned int rhs) const
+    {
+        if (_positions[lhs]<_positions[rhs]) return true;
+        if (_positions[rhs]<_positions[lhs]) return false;
+
+        const float* lhsAttributes = _numAttributes>0 ? &_attributes[lhs*_numAttributes] : 0;
+        const float* rhsAttributes = _numAttributes>0 ? &_attributes[rhs*_numAttributes] : 0;
+        for(unsigned int i=0;i<_numAttributes;++i)
+        {
+            if (lhsAttributes[i]<rhsAttributes[i]) return true;
+            if (rhsAttributes[i]<lhsAttributes[i]) return false;
+        }
+        return false;
+    }
+
+    const std::vector<osg::Vec3>&   _positions;
+    const std::vector<float>&       _attributes;
+    unsigned int                    _numAttributes;
+};
+
+/** Build the mesh from the geometry's triangles, welding vertices which match in position and attributes.
+  * Return false if the geometry has no triangles or no vertex array that can be simplified.*/
+bool readGeometry(osg::Geometry& geometry, const Simplifier::IndexList& protectedPoints, SimplifierMesh& mesh, AttributeArrayList& attributeArrays)
+{
+    // check to see if vertex attributes indices exists, if so expand them to remove them
+    if (geometry.containsSharedArrays())
+    {
+        OSG_INFO<<"Simplifier::simplify(..): Duplicate shared arrays"<<std::endl;
+        geometry.duplicateSharedArrays();
+    }
+
+    if (!geometry.getVertexArray()) return false;
+
+    std::vector<osg::Vec3> positions;
+    VertexArrayToPositionsVisitor copyVertexArrayToPositions(positions);
+    geometry.getVertexArray()->accept(copyVertexArrayToPositions);
+
+    unsigned int numVertices = static_cast<unsigned int>(positions.size());
+    if (numVertices==0 || numVertices!=geometry.getVertexArray()->getNumElements()) return false;
+
+    IndexList triangles;
+    CollectTriangleIndicesFunctor collectTriangles;
+    collectTriangles._triangles = &triangles;
+    geometry.accept(collectTriangles);
+
+    if (triangles.empty()) return false;
+
+    // gather the per vertex attributes in the same order as the original edge collapse.
+    for(unsigned int ti=0;ti<geometry.getNumTexCoordArrays();++ti)
+    {
+        addAttributeArray(attributeArrays, geometry, AttributeArray::TEXCOORD, ti, numVertices);
+    }
+
+    addAttributeArray(attributeArrays, geometry, AttributeArray::NORMAL, 0, numVertices);
+    addAttributeArray(attributeArrays, geometry, AttributeArray::COLOR, 0, numVertices);
+    addAttributeArray(attributeArrays, geometry, AttributeArray::SECONDARY_COLOR, 0, numVertices);
+    addAttributeArray(attributeArrays, geometry, AttributeArray::FOG_COORD, 0, numVertices);
+
+    for(unsigned int vi=0;vi<geometry.getNumVertexAttribArrays();++vi)
+    {
+        addAttributeArray(attributeArrays, geometry, AttributeArray::VERTEX_ATTRIB, vi, numVertices);
+    }
+
+    unsigned int numAttributes = 0;
+    for(AttributeArrayList::iterator itr = attributeArrays.begin(); itr != attributeArrays.end(); ++itr)
+    {
+        itr->offset = numAttributes;
+        numAttributes += itr->numComponents;
+    }
+
+    std::vector<float> attributes(numVertices*numAttributes);
+    for(AttributeArrayList::iterator itr = attributeArrays.begin(); itr != attributeArrays.end(); ++itr)
+    {
+        for(unsigned int i=0;i<numVertices;++i)
+        {
+            for(unsigned int c=0;c<itr->numComponents;++c)
+            {
+                attributes[i*numAttributes + itr->offset + c] = itr->values[i*itr->numComponents + c];
+            }
+        }
+        itr->values.clear();
+    }
+
+    // weld the vertices into points.
+    IndexList sortedVertices(numVertices);
+    for(unsigned int i=0;i<numVertices;++i) sortedVertices[i] = i;
+
+    VertexLess vertexLess(positions, attributes, numAttributes);
+    std::sort(sortedVertices.begin(), sortedVertices.end(), vertexLess);
+
+    std::vector<unsigned char> protectedVertices(numVertices, 0);
+    for(Simplifier::IndexList::const_iterator itr = protectedPoints.begin(); itr != protectedPoints.end(); ++itr)
+    {
+        if (*itr<numVertices) protectedVertices[*itr] = 1;
+    }
+
+    IndexList vertexPoints(numVertices);
+    mesh.numAttributes = numAttributes;
+    for(unsigned int i=0;i<numVertices;++i)
+    {
+        unsigned int v = sortedVertices[i];
+        if (i==0 || vertexLess(sortedVertices[i-1], v))
+        {
+            mesh.positions.push_back(positions[v]);
+            mesh.attributes.insert(mesh.attributes.end(), attributes.begin()+v*numAttributes, attributes.begin()+(v+1)*numAttributes);
+            mesh.locked.push_back(0);
+        }
+
+        unsigned int p = mesh.getNumPoints()-1;
+        vertexPoints[v] = p;
+        if (protectedVertices[v]) mesh.locked[p] = 1;
+    }
+
+    // map the triangles onto the points, dropping those left degenerate, and accumulate the quadrics of their planes.
+    mesh.quadrics.resize(mesh.getNumPoints());
+    mesh.triangles.reserve(triangles.size());
+    for(unsigned int t=0;t<triangles.size();t+=3)
+    {
+        unsigned int p1 = vertexPoints[triangles[t]];
+        unsigned int p2 = vertexPoints[triangles[t+1]];
+        unsigned int p3 = vertexPoints[triangles[t+2]];
+        if (p1==p2 || p2==p3 || p1==p3) continue;
+
+        mesh.triangles.push_back(p1);
+        mesh.triangles.push_back(p2);
+        mesh.triangles.push_back(p3);
+
+        osg::Vec3d v1(mesh.positions[p1]);
+        osg::Vec3d normal = (osg::Vec3d(mesh.positions[p2])-v1) ^ (osg::Vec3d(mesh.positions[p3])-v1);
+        if (normal.normalize()==0.0) continue;
+
+        Quadric quadric(osg::Plane(normal, v1));
+        mesh.quadrics[p1] += quadric;
+        mesh.quadrics[p2] += quadric;
+        mesh.quadrics[p3] += quadric;
+    }
+
+    return !mesh.triangles.empty();
+}
+
+/** Write the points used by the triangles back to the geometry's arrays, replacing its primitives with a single list of the triangles.*/
+void writeGeometry(const SimplifierMesh& mesh, const IndexList& triangles, const AttributeArrayList& attributeArrays, osg::Geometry& geometry)
+{
+    std::vector<int> newIndices(mesh.getNumPoints(), -1);
+    IndexList pointIndices;
+
+    osg::ref_ptr<osg::DrawElementsUInt> primitives = new osg::DrawElementsUInt(GL_TRIANGLES, triangles.size());
+    for(unsigned int i=0;i<triangles.size();++i)
+    {
+        unsigned int p = triangles[i];
+        if (newIndices[p]<0)
+        {
+            newIndices[p] = static_cast<int>(pointIndices.size());
+            pointIndices.push_back(p);
+        }
+        (*primitives)[i] = newIndices[p];
+    }
+
+    PositionsToVertexArrayVisitor copyPositionsToVertexArray(mesh.positions, pointIndices);
+    geometry.getVertexArray()->accept(copyPositionsToVertexArray);
+    geometry.getVertexArray()->dirty();
+
+    for(AttributeArrayList::const_iterator itr = attributeArrays.begin(); itr != attributeArrays.end(); ++itr)
+    {
+        osg::Array* array = itr->getArray(geometry);
+        AttributesToArrayVisitor copyAttributesToArray(mesh, *itr, pointIndices);
+        array->accept(copyAttributesToArray);
+        array->dirty();
+    }
+
+    if (geometry.getNormalArray() && geometry.getNormalArray()->getBinding()==osg::Array::BIND_PER_VERTEX)
+    {
+        // now normalize the interpolated normals.
+        NormalizeArrayVisitor nav;
+        geometry.getNormalArray()->accept(nav);
+    }
+
+    geometry.getPrimitiveSetList().clear();
+    geometry.addPrimitiveSet(primitives.get());
+}
+
+void simplifyMesh(const Simplifier& simplifier, SimplifierMesh& mesh, unsigned int numOriginalTriangles)
+{
+    QuadricEdgeCollapse qec(mesh);
+    qec.simplify(simplifier, numOriginalTriangles, 0);
+    qec.compactTriangles();
+}
+
+void simplifyMeshPart(const Simplifier& simplifier, SimplifierMesh& mesh)
+{
+    // the borders of a part hold it back from the simplifier's target, so stop short of the fan of triangles around
+    // them rather than forcing the collapses of the part's interior, leaving the rest to the pass over the whole mesh.
+    QuadricEdgeCollapse qec(mesh);
+    qec.simplify(simplifier, mesh.getNumTriangles(), qec.getNumLockedPoints()*2);
+    qec.compactTriangles();
+}
+
+// number of triangles below which splitting the mesh between threads isn't worthwhile.
+const unsigned int MINIMUM_TRIANGLES_PER_PART = 4096;
+
+/** Part of a mesh simplified on its own, along with the indices of its points in the whole mesh.*/
+struct SimplifierMeshPart
+{
+    SimplifierMesh  mesh;
+    IndexList       points;
+};
+
+typedef std::vector<SimplifierMeshPart> SimplifierMeshPartList;
+
+struct CentroidLess
+{
+    CentroidLess(const std::vector<osg::Vec3>& centroids, unsigned int axis):
+        _centroids(centroids),
+        _axis(axis) {}
+
+    inline bool operator() (unsigned int lhs, unsigned int rhs) const { return _centroids[lhs][_axis]<_centroids[rhs][_axis]; }
+
+    const std::vector<osg::Vec3>&   _centroids;
+    unsigned int                    _axis;
+};
+
+/** Split the triangles in [begin,end) into numParts spatially coherent parts, halving them along the longest axis of their centroids.*/
+void partitionTriangles(const std::vector<osg::Vec3>& centroids, IndexList::iterator begin, IndexList::iterator end, unsigned int numParts, std::vector<IndexList::iterator>& partEnds)
+{
+    if (numParts<=1)
+    {
+        partEnds.push_back(end);
+        return;
+    }
+
+    osg::BoundingBox bb;
+    for(IndexList::iterator itr = begin; itr != end; ++itr) bb.expandBy(centroids[*itr]);
+
+    osg::Vec3 size = bb._max-bb._min;
+    unsigned int axis = (size.x()>=size.y() && size.x()>=size.z()) ? 0 : (size.y()>=size.z() ? 1 : 2);
+
+    unsigned int numLeftParts = numParts/2;
+    IndexList::iterator mid = begin + ((end-begin)*numLeftParts)/numParts;
+    std::nth_element(begin, mid, end, CentroidLess(centroids, axis));
+
+    partitionTriangles(centroids, begin, mid, numLeftParts, partEnds);
+    partitionTriangles(centroids, mid, end, numParts-numLeftParts, partEnds);
+}
+
+class SimplifyMeshPartThread : public osg::Referenced, public OpenThreads::Thread
+{
+public:
+
+    SimplifyMeshPartThread(const Simplifier& simplifier, SimplifierMeshPart& part):
+        _simplifier(simplifier),
+        _part(part) {}
+
+    virtual void run()
+    {
+        simplifyMeshPart(_simplifier, _part.mesh);
+    }
+
+protected:
+
+    const Simplifier&       _simplifier;
+    SimplifierMeshPart&     _part;
+};
+
+/** Simplify spatially coherent parts of the mesh in parallel, each with the points on its borders locked,
+  * then gather the results back into the mesh ready for simplifying across the borders.*/
+void simplifyMeshParts(const Simplifier& simplifier, SimplifierMesh& mesh, unsigned int numParts)
+{
+    unsigned int numTriangles = mesh.getNumTriangles();
+    std::vector<osg::Vec3> centroids(numTriangles);
+    IndexList order(numTriangles);
+    for(unsigned int t=0;t<numTriangles;++t)
+    {
+        const unsigned int* points = &mesh.triangles[t*3];
+        centroids[t] = (mesh.positions[points[0]]+mesh.positions[points[1]]+mesh.positions[points[2]])/3.0f;
+        order[t] = t;
+    }
+
+    std::vector<IndexList::iterator> partEnds;
+    partitionTriangles(centroids, order.begin(), order.end(), numParts, partEnds);
+
+    // build each part from its triangles, noting which points belong to just one part.
+    const int SHARED_POINT = -2;
+    std::vector<int> owners(mesh.getNumPoints(), -1);
+
+    SimplifierMeshPartList parts(numParts);
+    IndexList::iterator begin = order.begin();
+    for(unsigned int i=0;i<numParts;++i)
+    {
+        IndexList::iterator end = partEnds[i];
+        SimplifierMeshPart& part = parts[i];
+
+        for(IndexList::iterator itr = begin; itr != end; ++itr)
+        {
+            part.points.insert(part.points.end(), mesh.triangles.begin()+(*itr)*3, mesh.triangles.begin()+(*itr)*3+3);
+        }
+        std::sort(part.points.begin(), part.points.end());
+        part.points.erase(std::unique(part.points.begin(), part.points.end()), part.points.end());
+
+        SimplifierMesh& partMesh = part.mesh;
+        partMesh.numAttributes = mesh.numAttributes;
+        partMesh.positions.reserve(part.points.size());
+        partMesh.attributes.reserve(part.points.size()*mesh.numAttributes);
+        partMesh.quadrics.reserve(part.points.size());
+        partMesh.locked.reserve(part.points.size());
+        for(IndexList::iterator itr = part.points.begin(); itr != part.points.end(); ++itr)
+        {
+            unsigned int p = *itr;
+            partMesh.positions.push_back(mesh.positions[p]);
+            partMesh.attributes.insert(partMesh.attributes.end(), mesh.attributes.begin()+p*mesh.numAttributes, mesh.attributes.begin()+(p+1)*mesh.numAttributes);
+            partMesh.quadrics.push_back(mesh.quadrics[p]);
+            partMesh.locked.push_back(mesh.locked[p]);
+
+            owners[p] = (owners[p]==-1) ? static_cast<int>(i) : SHARED_POINT;
+        }
+
+        partMesh.triangles.reserve((end-begin)*3);
+        for(IndexList::iterator itr = begin; itr != end; ++itr)
+        {
+            for(unsigned int j=0;j<3;++j)
+            {
+                unsigned int p = mesh.triangles[(*itr)*3+j];
+                partMesh.triangles.push_back(static_cast<unsigned int>(std::lower_bound(part.points.begin(), part.points.end(), p)-part.points.begin()));
+            }
+        }
+
+        begin = end;
+    }
+
+    // the calling thread simplifies the first part alongside the others.
+    typedef std::vector< osg::ref_ptr<SimplifyMeshPartThread> > SimplifyThreads;
+    SimplifyThreads threads;
+    for(unsigned int i=1;i<numParts;++i)
+    {
+        osg::ref_ptr<SimplifyMeshPartThread> thread = new SimplifyMeshPartThread(simplifier, parts[i]);
+        thread->startThread();
+        threads.push_back(thread);
+    }
+
+    simplifyMeshPart(simplifier, parts[0].mesh);
+
+    for(SimplifyThreads::iterator itr = threads.begin(); itr != threads.end(); ++itr)
+    {
+        (*itr)->join();
+    }
+
+    // the points shared between parts are locked in place, but gather the planes of the points collapsed into them in each part.
+    for(unsigned int i=0;i<numParts;++i)
+    {
+        SimplifierMeshPart& part = parts[i];
+        for(unsigned int l=0;l<part.points.size();++l)
+        {
+            unsigned int p = part.points[l];
+            if (owners[p]==SHARED_POINT) part.mesh.quadrics[l] -= mesh.quadrics[p];
+        }
+    }
+
+    // copy back the points moved within each part along with the remaining triangles.
+    mesh.triangles.clear();
+    for(unsigned int i=0;i<numParts;++i)
+    {
+        const SimplifierMeshPart& part = parts[i];
+        const SimplifierMesh& partMesh = part.mesh;
+        for(unsigned int l=0;l<part.points.size();++l)
+        {
+            unsigned int p = part.points[l];
+            if (owners[p]==SHARED_POINT)
+            {
+                mesh.quadrics[p] += partMesh.quadrics[l];
+                continue;
+            }
+
+            mesh.positions[p] = partMesh.positions[l];
+            std::copy(partMesh.attributes.begin()+l*mesh.numAttributes, partMesh.attributes.begin()+(l+1)*mesh.numAttributes, mesh.attributes.begin()+p*mesh.numAttributes);
+            mesh.quadrics[p] = partMesh.quadrics[l];
+        }
+
+        for(IndexList::const_iterator itr = partMesh.triangles.begin(); itr != partMesh.triangles.end(); ++itr)
+        {
+            mesh.triangles.push_back(part.points[*itr]);
+        }
+    }
+}
+
+}
+
+
+Simplifier::Simplifier(double sampleRatio, double maximumError, double maximumLength):
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+            _sampleRatio(sampleRatio),
+            _maximumError(maximumError),
+            _maximumLength(maximumLength),
+            _triStrip(true),
+            _smoothing(true),
+            _numThreads(1)
+
+{
+}
+
+void Simplifier::simplify(osg::Geometry& geometry)
+{
+    // pass an empty list of indices to simply(Geometry,IndexList)
+    // so that this one method handle both cases of non protected indices
+    // and specified indices.
+    IndexList emptyList;
+    simplify(geometry,emptyList);
+}
+
+void Simplifier::simplify(osg::Geometry& geometry, const IndexList& protectedPoints)
+{
+    OSG_INFO<<"++++++++++++++simplifier************"<<std::endl;
+
+    if (requiresDownSampling())
+    {
+        SimplifierMesh mesh;
+        AttributeArrayList attributeArrays;
+        if (!readGeometry(geometry, protectedPoints, mesh, attributeArrays))
+        {
+            OSG_INFO<<"Simplifier::simplify(..) geometry has no triangles to simplify."<<std::endl;
+            return;
+        }
+
+        unsigned int numOriginalPrimitives = mesh.getNumTriangles();
+
+        // large meshes are first simplified in parts, one per thread, leaving the borders between them to the pass over the whole mesh.
+        unsigned int numParts = osg::minimum(_numThreads, numOriginalPrimitives/MINIMUM_TRIANGLES_PER_PART);
+        if (numParts>1)
+        {
+            simplifyMeshParts(*this, mesh, numParts);
+            OSG_INFO<<"Simplifier, in = "<<numOriginalPrimitives<<"\tafter "<<numParts<<" parts = "<<mesh.getNumTriangles()<<std::endl;
+        }
+
+        simplifyMesh(*this, mesh, numOriginalPrimitives);
+
+        OSG_INFO<<"Simplifier, in = "<<numOriginalPrimitives<<"\tout = "<<mesh.getNumTriangles()<<"\tpoints = "<<mesh.getNumPoints()<<std::endl;
+
+        writeGeometry(mesh, mesh.triangles, attributeArrays, geometry);
+    }
+    else
+    {
+        EdgeCollapse ec;
+        ec.setComputeErrorMetricUsingLength(true);
+        ec.setGeometry(&geometry, protectedPoints);
+        ec.updateErrorMetricForAllEdges();
+
+        unsigned int numOriginalPrimitives = ec._triangleSet.size();
+
+        // up sampling...
+        while (!ec._edgeSet.empty() &&
+               continueSimplification((*ec._edgeSet.rbegin())->getErrorMetric() , numOriginalPrimitives, ec._triangleSet.size()) &&
+               ec.divideLongestEdge())
+        {
+           //OSG_INFO<<"   Edge divided ec._triangleSet.size()="<<ec._triangleSet.size()<<" error="<<(*ec._edgeSet.rbegin())->getErrorMetric()<<" vs "<<getMaximumError()<<std::endl;
+        }
+        OSG_INFO<<"******* AFTER EDGE DIVIDE *********"<<ec._triangleSet.size()<<std::endl;
+
+        OSG_INFO<<"Number of triangle errors after edge divide= "<<ec.testAllTriangles()<<std::endl;
+        OSG_INFO<<"Number of edge errors after edge divide= "<<ec.testAllEdges()<<std::endl;
+        OSG_INFO<<"Number of point errors after edge divide= "<<ec.testAllPoints()<<std::endl;
+        OSG_INFO<<"Number of triangles= "<<ec._triangleSet.size()<<std::endl;
+        OSG_INFO<<"Number of points= "<<ec._pointSet.size()<<std::endl;
+        OSG_INFO<<"Number of edges= "<<ec._edgeSet.size()<<std::endl;
+        OSG_INFO<<"Number of boundary edges= "<<ec.computeNumBoundaryEdges()<<std::endl;
+
+        OSG_INFO<<std::endl<<"Simplifier, in = "<<numOriginalPrimitives<<"\tout = "<<ec._triangleSet.size()<<std::endl<<std::endl;
+
+        ec.copyBackToGeometry();
+    }
+
+    if (_smoothing)
+    {
+        osgUtil::SmoothingVisitor::smooth(geometry);
+    }
+
+    if (_triStrip)
+    {
+        osgUtil::optimizeMesh(&geometry);
+    }
+
+}
+
+void Simplifier::simplify(const osg::Geometry& geometry, const SampleRatioList& sampleRatios, GeometryList& levels, ErrorList& errors)
+{
+    if (sampleRatios.empty()) return;
+
+    // read from a copy so that any shared arrays can be expanded without changing the original.
+    osg::ref_ptr<osg::Geometry> source = new osg::Geometry(geometry, osg::CopyOp::DEEP_COPY_ARRAYS);
+
+    SimplifierMesh mesh;
+    AttributeArrayList attributeArrays;
+    if (!readGeometry(*source, IndexList(), mesh, attributeArrays))
+    {
+        OSG_INFO<<"Simplifier::simplify(..) geometry has no triangles to simplify."<<std::endl;
+        return;
+    }
+
+    unsigned int numOriginalPrimitives = mesh.getNumTriangles();
+
+    // the sample ratio is stepped through the list, so restore it afterwards.
+    double sampleRatio = _sampleRatio;
+    _sampleRatio = sampleRatios.front();
+
+    unsigned int numParts = osg::minimum(_numThreads, numOriginalPrimitives/MINIMUM_TRIANGLES_PER_PART);
+    if (numParts>1)
+    {
+        simplifyMeshParts(*this, mesh, numParts);
+    }
+
+    QuadricEdgeCollapse qec(mesh);
+    IndexList triangles;
+    for(SampleRatioList::const_iterator itr = sampleRatios.begin(); itr != sampleRatios.end(); ++itr)
+    {
+        _sampleRatio = *itr;
+        qec.simplify(*this, numOriginalPrimitives, 0);
+        qec.getTriangles(triangles);
+
+        OSG_INFO<<"Simplifier, in = "<<numOriginalPrimitives<<"\tratio = "<<*itr<<"\tout = "<<qec.getNumTriangles()<<"\terror = "<<qec.getMaximumError()<<std::endl;
+
+        osg::ref_ptr<osg::Geometry> level = new osg::Geometry(*source, osg::CopyOp::DEEP_COPY_ARRAYS|osg::CopyOp::DEEP_COPY_USERDATA);
+        writeGeometry(mesh, triangles, attributeArrays, *level);
+
+        if (_smoothing)
+        {
+            osgUtil::SmoothingVisitor::smooth(*level);
+        }
+
+        if (_triStrip)
+        {
+            osgUtil::optimizeMesh(level.get());
+        }
+
+        levels.push_back(level);
+        errors.push_back(qec.getMaximumError());
     }
 
+    _sampleRatio = sampleRatio;
 }
@@ -0,0 +1,614 @@
+/* -*-c++-*- OpenSceneGraph - Copyright (C) 1998-2006 Robert Osfield
+ *
+ * This library is open source and may be redistributed and/or modified under
+ * the terms of the OpenSceneGraph Public License (OSGPL) version 0.0 or
+ * (at your option) any later version.  The full license is in LICENSE file
+ * included with this distribution, and on the openscenegraph.org website.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * OpenSceneGraph Public License for more details.
+*/
+#include <osgUtil/SoftwareOcclusionBuffer>
+
+#include <osg/NodeVisitor>
+#include <osg/Transform>
+#include <osg/Drawable>
+#include <osg/TriangleFunctor>
+#include <osg/Notify>
+
+#include <OpenThreads/Barrier>
+#include <OpenThreads/Thread>
+
+#include <algorithm>
+#include <math.h>
+#include <float.h>
+
+using namespace osgUtil;
+
+namespace SoftwareOcclusion
+{
+
+struct CollectTriangles
+{
+    CollectTriangles(): vertices(0), matrix(0) {}
+
+    std::vector<osg::Vec3>*     vertices;
+    const osg::Matrix*          matrix;
+
+    inline void operator () (const osg::Vec3& v1, const osg::Vec3& v2, const osg::Vec3& v3)
+    {
+        vertices->push_back(v1 * (*matrix));
+        vertices->push_back(v2 * (*matrix));
+        vertices->push_back(v3 * (*matrix));
+    }
+};
+
+/** Gather the triangles of a subgraph into the coordinate frame of its root.*/
+class CollectTrianglesVisitor : public osg::NodeVisitor
+{
+public:
+
+    CollectTrianglesVisitor(std::vector<osg::Vec3>& vertices):
+        osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ACTIVE_CHILDREN),
+        _vertices(vertices)
+    {
+        _matrixStack.push_back(osg::Matrix::identity());
+    }
+
+    virtual void apply(osg::Transform& transform)
+    {
+        osg::Matrix matrix = _matrixStack.back();
+        transform.computeLocalToWorldMatrix(matrix, this);
+
+        _matrixStack.push_back(matrix);
+        traverse(transform);
+        _matrixStack.pop_back();
+    }
+
+    virtual void apply(osg::Drawable& drawable)
+    {
+        osg::TriangleFunctor<CollectTriangles> functor;
+        functor.vertices = &_vertices;
+        functor.matrix = &_matrixStack.back();
+        drawable.accept(functor);
+    }
+
+protected:
+
+    CollectTrianglesVisitor& operator = (const CollectTrianglesVisitor&) { return *this; }
+
+    std::vector<osg::Vec3>&     _vertices;
+    std::vector<osg::Matrix>    _matrixStack;
+};
+
+}
+
+class SoftwareOcclusionBuffer::ThreadPool : public osg::Referenced
+{
+public:
+
+    class RasterThread : public osg::Referenced, public OpenThreads::Thread
+    {
+    public:
+
+        RasterThread(ThreadPool* threadPool, unsigned int index):
+            _threadPool(threadPool),
+            _index(index) {}
+
+        virtual void run()
+        {
+            for(;;)
+            {
+                _threadPool->_startBarrier.block();
+                if (_threadPool->_done) break;
+
+                _threadPool->_buffer->rasterizeTiles(_index, _threadPool->getNumThreads());
+
+                _threadPool->_endBarrier.block();
+            }
+        }
+
+    protected:
+
+        ThreadPool*     _threadPool;
+        unsigned int    _index;
+    };
+
+    ThreadPool(unsigned int numThreads):
+        _startBarrier(numThreads),
+        _endBarrier(numThreads),
+        _done(false),
+        _buffer(0)
+    {
+        for(unsigned int i=1; i<numThreads; ++i)
+        {
+            osg::ref_ptr<RasterThread> thread = new RasterThread(this, i);
+            thread->startThread();
+            _threads.push_back(thread);
+        }
+    }
+
+    unsigned int getNumThreads() const { return static_cast<unsigned int>(_threads.size())+1; }
+
+    /** Rasterize the tiles of buffer across the worker threads and the calling thread, returning once all are done.*/
+    void rasterize(SoftwareOcclusionBuffer* buffer)
+    {
+        _buffer = buffer;
+
+        _startBarrier.block();
+
+        buffer->rasterizeTiles(0, getNumThreads());
+
+        _endBarrier.block();
+
+        _buffer = 0;
+    }
+
+protected:
+
+    virtual ~ThreadPool()
+    {
+        _done = true;
+        _startBarrier.block();
+
+        for(RasterThreads::iterator itr = _threads.begin(); itr != _threads.end(); ++itr)
+        {
+            (*itr)->join();
+        }
+    }
+
+    typedef std::vector< osg::ref_ptr<RasterThread> > RasterThreads;
+
+    OpenThreads::Barrier        _startBarrier;
+    OpenThreads::Barrier        _endBarrier;
+    volatile bool               _done;
+
+    RasterThreads               _threads;
+
+    // buffer being rasterized, read by the worker threads between the start and end barriers.
+    SoftwareOcclusionBuffer*    _buffer;
+};
+
+SoftwareOcclusionBuffer::SoftwareOcclusionBuffer():
+    _width(256),
+    _height(128),
+    _numThreads(1),
+    _valid(false)
+{
+    allocateLevels();
+}
+
+SoftwareOcclusionBuffer::~SoftwareOcclusionBuffer()
+{
+}
+
+void SoftwareOcclusionBuffer::setResolution(unsigned int width, unsigned int height)
+{
+    if (width==_width && height==_height) return;
+
+    _width = osg::maximum(width, 1u);
+    _height = osg::maximum(height, 1u);
+    _valid = false;
+
+    allocateLevels();
+}
+
+void SoftwareOcclusionBuffer::setNumThreads(unsigned int numThreads)
+{
+    numThreads = osg::maximum(numThreads, 1u);
+    if (numThreads==_numThreads) return;
+
+    _numThreads = numThreads;
+
+    // the threads are started by the next build().
+    _threadPool = 0;
+}
+
+void SoftwareOcclusionBuffer::allocateLevels()
+{
+    _levels.clear();
+
+    unsigned int width = _width;
+    unsigned int height = _height;
+    for(;;)
+    {
+        _levels.push_back(Level());
+
+        Level& level = _levels.back();
+        level.width = width;
+        level.height = height;
+        level.depth.resize(width*height, FLT_MAX);
+
+        if (width==1 && height==1) break;
+
+        width = (width+1)/2;
+        height = (height+1)/2;
+    }
+}
+
+void SoftwareOcclusionBuffer::addOccluder(osg::Node* node)
+{
+    if (!node) return;
+
+    for(Occluders::iterator itr = _occluders.begin(); itr != _occluders.end(); ++itr)
+    {
+        if (itr->node==node) return;
+    }
+
+    _occluders.push_back(Occluder());
+    _occluders.back().node = node;
+    _occluders.back().collected = false;
+}
+
+void SoftwareOcclusionBuffer::removeOccluder(osg::Node* node)
+{
+    for(Occluders::iterator itr = _occluders.begin(); itr != _occluders.end(); ++itr)
+    {
+        if (itr->node==node)
+        {
+            _occluders.erase(itr);
+            return;
+        }
+    }
+}
+
+void SoftwareOcclusionBuffer::dirtyOccluders()
+{
+    for(Occluders::iterator itr = _occluders.begin(); itr != _occluders.end(); ++itr)
+    {
+        itr->vertices.clear();
+        itr->collected = false;
+    }
+}
+
+void SoftwareOcclusionBuffer::collectOccluder(Occluder& occluder)
+{
+    occluder.vertices.clear();
+
+    // the occluder's own transform is part of its world matrices, so only the subgraph beneath it is transformed here.
+    SoftwareOcclusion::CollectTrianglesVisitor ctv(occluder.vertices);
+    osg::Drawable* drawable = occluder.node->asDrawable();
+    if (drawable) ctv.apply(*drawable);
+    else occluder.node->traverse(ctv);
+
+    occluder.collected = true;
+
+    OSG_INFO<<"SoftwareOcclusionBuffer: collected "<<occluder.vertices.size()/3<<" triangles from occluder "<<occluder.node->getName()<<std::endl;
+}
+
+void SoftwareOcclusionBuffer::build(const osg::Matrix& view, const osg::Matrix& projection)
+{
+    _view = view;
+    _projection = projection;
+    _triangles.clear();
+
+    for(Occluders::iterator itr = _occluders.begin(); itr != _occluders.end(); ++itr)
+    {
+        Occluder& occluder = *itr;
+        if (!occluder.collected) collectOccluder(occluder);
+        if (occluder.vertices.empty()) continue;
+
+        osg::MatrixList worldMatrices = occluder.node->getWorldMatrices();
+        for(osg::MatrixList::iterator mitr = worldMatrices.begin(); mitr != worldMatrices.end(); ++mitr)
+        {
+            osg::Matrix modelview = (*mitr) * view;
+            osg::Matrix mvp = modelview * projection;
+
+            ClipVertex clipVertices[3];
+            for(unsigned int i=0; i+2<occluder.vertices.size(); i+=3)
+            {
+                for(unsigned int j=0; j<3; ++j)
+                {
+                    const osg::Vec3& v = occluder.vertices[i+j];
+                    osg::Vec4d clip = osg::Vec4d(v.x(), v.y(), v.z(), 1.0) * mvp;
+
+                    ClipVertex& cv = clipVertices[j];
+                    cv.x = clip.x();
+                    cv.y = clip.y();
+                    cv.z = clip.z();
+                    cv.w = clip.w();
+                    cv.depth = -(v.x()*modelview(0,2) + v.y()*modelview(1,2) + v.z()*modelview(2,2) + modelview(3,2));
+                }
+
+                clipAndSetupTriangle(clipVertices);
+            }
+        }
+    }
+
+    unsigned int numThreads = osg::minimum(_numThreads, getNumTiles());
+    if (numThreads>1)
+    {
+        if (!_threadPool || _threadPool->getNumThreads()!=numThreads) _threadPool = new ThreadPool(numThreads);
+        _threadPool->rasterize(this);
+    }
+    else
+    {
+        rasterizeTiles(0, 1);
+    }
+
+    // the levels above those reduced within each tile span several tiles.
+    for(unsigned int level=TILE_LEVELS+1; level<_levels.size(); ++level)
+    {
+        reduceLevel(level, 0, _levels[level].height);
+    }
+
+    _valid = !_triangles.empty();
+}
+
+void SoftwareOcclusionBuffer::clipAndSetupTriangle(const ClipVertex* vertices)
+{
+    // distances inside the near plane, z >= -w.
+    double d[3];
+    unsigned int numInside = 0;
+    for(unsigned int i=0; i<3; ++i)
+    {
+        d[i] = vertices[i].z + vertices[i].w;
+        if (d[i]>=0.0) ++numInside;
+    }
+
+    if (numInside==0) return;
+
+    if (numInside==3)
+    {
+        setupTriangle(vertices[0], vertices[1], vertices[2]);
+        return;
+    }
+
+    // clip the triangle against the near plane, leaving a triangle or a quad.
+    ClipVertex polygon[4];
+    unsigned int numVertices = 0;
+    for(unsigned int i=0; i<3; ++i)
+    {
+        unsigned int next = (i+1)%3;
+        if (d[i]>=0.0) polygon[numVertices++] = vertices[i];
+        if ((d[i]>=0.0)!=(d[next]>=0.0))
+        {
+            double r = d[i]/(d[i]-d[next]);
+            const ClipVertex& a = vertices[i];
+            const ClipVertex& b = vertices[next];
+            ClipVertex& cv = polygon[numVertices++];
+            cv.x = a.x + (b.x-a.x)*r;
+            cv.y = a.y + (b.y-a.y)*r;
+            cv.z = a.z + (b.z-a.z)*r;
+            cv.w = a.w + (b.w-a.w)*r;
+            cv.depth = a.depth + (b.depth-a.depth)*r;
+        }
+    }
+
+    for(unsigned int i=2; i<numVertices; ++i)
+    {
+        setupTriangle(polygon[0], polygon[i-1], polygon[i]);
+    }
+}
+
+void SoftwareOcclusionBuffer::setupTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2)
+{
+    const ClipVertex* cv[3] = { &v0, &v1, &v2 };
+
+    double x[3], y[3], invW[3], depthOverW[3];
+    double minX = DBL_MAX, maxX = -DBL_MAX, minY = DBL_MAX, maxY = -DBL_MAX;
+    for(unsigned int i=0; i<3; ++i)
+    {
+        if (cv[i]->w<=0.0) return;
+
+        invW[i] = 1.0/cv[i]->w;
+        depthOverW[i] = cv[i]->depth*invW[i];
+        x[i] = (cv[i]->x*invW[i]*0.5+0.5)*double(_width);
+        y[i] = (cv[i]->y*invW[i]*0.5+0.5)*double(_height);
+
+        minX = osg::minimum(minX, x[i]);
+        maxX = osg::maximum(maxX, x[i]);
+        minY = osg::minimum(minY, y[i]);
+        maxY = osg::maximum(maxY, y[i]);
+    }
+
+    // range of the pixels whose centres lie within the triangle's extents.
+    minX = ceil(minX-0.5);
+    maxX = floor(maxX-0.5);
+    minY = ceil(minY-0.5);
+    maxY = floor(maxY-0.5);
+    if (maxX<0.0 || maxY<0.0 || minX>double(_width-1) || minY>double(_height-1) || minX>maxX || minY>maxY) return;
+
+    Triangle triangle;
+    triangle.minX = static_cast<int>(osg::maximum(minX, 0.0));
+    triangle.maxX = static_cast<int>(osg::minimum(maxX, double(_width-1)));
+    triangle.minY = static_cast<int>(osg::maximum(minY, 0.0));
+    triangle.maxY = static_cast<int>(osg::minimum(maxY, double(_height-1)));
+
+    // edge i runs from vertex i to vertex i+1, and is positive on the side of the vertex opposite it.
+    for(unsigned int i=0; i<3; ++i)
+    {
+        unsigned int j = (i+1)%3;
+        triangle.edgeA[i] = -(y[j]-y[i]);
+        triangle.edgeB[i] = x[j]-x[i];
+        triangle.edgeC[i] = (y[j]-y[i])*x[i] - (x[j]-x[i])*y[i];
+    }
+
+    double area = triangle.edgeA[0]*x[2] + triangle.edgeB[0]*y[2] + triangle.edgeC[0];
+    if (fabs(area)<1e-8) return;
+
+    // occluders are rendered double sided, so flip the edges of clockwise triangles.
+    if (area<0.0)
+    {
+        area = -area;
+        for(unsigned int i=0; i<3; ++i)
+        {
+            triangle.edgeA[i] = -triangle.edgeA[i];
+            triangle.edgeB[i] = -triangle.edgeB[i];
+            triangle.edgeC[i] = -triangle.edgeC[i];
+        }
+    }
+
+    // the barycentric weight of each vertex is the edge function of the opposite edge divided by the area.
+    double inv_area = 1.0/area;
+    double* coefficients[3] = { triangle.edgeA, triangle.edgeB, triangle.edgeC };
+    for(unsigned int c=0; c<3; ++c)
+    {
+        const double* e = coefficients[c];
+        triangle.invW[c] = (e[1]*invW[0] + e[2]*invW[1] + e[0]*invW[2])*inv_area;
+        triangle.depthOverW[c] = (e[1]*depthOverW[0] + e[2]*depthOverW[1] + e[0]*depthOverW[2])*inv_area;
+    }
+
+    _triangles.push_back(triangle);
+}
+
+void SoftwareOcclusionBuffer::rasterizeTiles(unsigned int index, unsigned int stride)
+{
+    unsigned int numTiles = getNumTiles();
+    unsigned int numTileLevels = osg::minimum(static_cast<unsigned int>(TILE_LEVELS), static_cast<unsigned int>(_levels.size())-1);
+
+    for(unsigned int tile=index; tile<numTiles; tile+=stride)
+    {
+        rasterizeTile(tile);
+
+        // tiles are a power of two rows high, so the first few levels reduce rows belonging only to this tile.
+        unsigned int beginRow = tile*TILE_HEIGHT;
+        unsigned int endRow = osg::minimum(beginRow+TILE_HEIGHT, _height);
+        for(unsigned int level=1; level<=numTileLevels; ++level)
+        {
+            unsigned int scale = 1u<<level;
+            reduceLevel(level, beginRow/scale, (endRow+scale-1)/scale);
+        }
+    }
+}
+
+void SoftwareOcclusionBuffer::rasterizeTile(unsigned int tile)
+{
+    int beginRow = static_cast<int>(tile*TILE_HEIGHT);
+    int endRow = static_cast<int>(osg::minimum(tile*TILE_HEIGHT+TILE_HEIGHT, _height));
+
+    float* depth = &(_levels[0].depth.front());
+    std::fill(depth+beginRow*_width, depth+endRow*_width, FLT_MAX);
+
+    for(Triangles::const_iterator itr = _triangles.begin(); itr != _triangles.end(); ++itr)
+    {
+        const Triangle& t = *itr;
+        if (t.maxY<beginRow || t.minY>=endRow) continue;
+
+        int rowBegin = osg::maximum(t.minY, beginRow);
+        int rowEnd = osg::minimum(t.maxY+1, endRow);
+
+        double px = double(t.minX)+0.5;
+        for(int row=rowBegin; row<rowEnd; ++row)
+        {
+            double py = double(row)+0.5;
+            double e0 = t.edgeA[0]*px + t.edgeB[0]*py + t.edgeC[0];
+            double e1 = t.edgeA[1]*px + t.edgeB[1]*py + t.edgeC[1];
+            double e2 = t.edgeA[2]*px + t.edgeB[2]*py + t.edgeC[2];
+            double iw = t.invW[0]*px + t.invW[1]*py + t.invW[2];
+            double dw = t.depthOverW[0]*px + t.depthOverW[1]*py + t.depthOverW[2];
+
+            float* rowDepth = depth + row*_width;
+            for(int column=t.minX; column<=t.maxX; ++column)
+            {
+                if (e0>=0.0 && e1>=0.0 && e2>=0.0)
+                {
+                    float d = static_cast<float>(dw/iw);
+                    if (d<rowDepth[column]) rowDepth[column] = d;
+                }
+
+                e0 += t.edgeA[0];
+                e1 += t.edgeA[1];
+                e2 += t.edgeA[2];
+                iw += t.invW[0];
+                dw += t.depthOverW[0];
+            }
+        }
+    }
+}
+
+void SoftwareOcclusionBuffer::reduceLevel(unsigned int level, unsigned int beginRow, unsigned int endRow)
+{
+    const Level& source = _levels[level-1];
+    Level& destination = _levels[level];
+
+    for(unsigned int row=beginRow; row<endRow; ++row)
+    {
+        const float* row0 = &source.depth[(row*2)*source.width];
+        const float* row1 = &source.depth[osg::minimum(row*2+1, source.height-1)*source.width];
+        float* result = &destination.depth[row*destination.width];
+
+        for(unsigned int column=0; column<destination.width; ++column)
+        {
+            unsigned int c0 = column*2;
+            unsigned int c1 = osg::minimum(c0+1, source.width-1);
+            result[column] = osg::maximum(osg::maximum(row0[c0], row0[c1]), osg::maximum(row1[c0], row1[c1]));
+        }
+    }
+}
+
+bool SoftwareOcclusionBuffer::isOccluded(const osg::Matrix& modelview, const osg::BoundingBox& bb) const
+{
+    if (!_valid || !bb.valid()) return false;
+
+    osg::Matrix mvp = modelview * _projection;
+
+    double minX = DBL_MAX, maxX = -DBL_MAX, minY = DBL_MAX, maxY = -DBL_MAX;
+    double minDepth = DBL_MAX;
+    for(unsigned int i=0; i<8; ++i)
+    {
+        osg::Vec3d corner = bb.corner(i);
+        osg::Vec4d clip = osg::Vec4d(corner, 1.0) * mvp;
+
+        // bounds reaching in front of the near plane can't be placed against the buffer.
+        if (clip.w()<=0.0 || clip.z()+clip.w()<0.0) return false;
+
+        double x = clip.x()/clip.w();
+        double y = clip.y()/clip.w();
+        minX = osg::minimum(minX, x);
+        maxX = osg::maximum(maxX, x);
+        minY = osg::minimum(minY, y);
+        maxY = osg::maximum(maxY, y);
+
+        double depth = -(corner.x()*modelview(0,2) + corner.y()*modelview(1,2) + corner.z()*modelview(2,2) + modelview(3,2));
+        minDepth = osg::minimum(minDepth, depth);
+    }
+
+    // bias the bounds towards the eye so that the rounding of an occluder's own surface doesn't hide it.
+    minDepth -= fabs(minDepth)*1e-4 + 1e-6;
+
+    // pixels overlapped by the projected bounds, clamped to the buffer.
+    minX = floor((minX*0.5+0.5)*double(_width));
+    maxX = floor((maxX*0.5+0.5)*double(_width));
+    minY = floor((minY*0.5+0.5)*double(_height));
+    maxY = floor((maxY*0.5+0.5)*double(_height));
+    if (maxX<0.0 || maxY<0.0 || minX>double(_width-1) || minY>double(_height-1)) return false;
+
+    unsigned int x0 = static_cast<unsigned int>(osg::maximum(minX, 0.0));
+    unsigned int x1 = static_cast<unsigned int>(osg::minimum(maxX, double(_width-1)));
+    unsigned int y0 = static_cast<unsigned int>(osg::maximum(minY, 0.0));
+    unsigned int y1 = static_cast<unsigned int>(osg::minimum(maxY, double(_height-1)));
+
+    // pick the level at which the bounds cover only a few texels, each holding the furthest occluder depth beneath it.
+    unsigned int extent = osg::maximum(x1-x0, y1-y0);
+    unsigned int level = 0;
+    while ((extent>>level)>2 && level+1<_levels.size()) ++level;
+
+    const Level& l = _levels[level];
+    x0 >>= level;
+    x1 >>= level;
+    y0 >>= level;
+    y1 >>= level;
+
+    for(unsigned int y=y0; y<=y1; ++y)
+    {
+        const float* row = &l.depth[y*l.width];
+        for(unsigned int x=x0; x<=x1; ++x)
+        {
+            if (double(row[x])>=minDepth) return false;
+        }
+    }
+
+    return true;
+}
+
+bool SoftwareOcclusionBuffer::isOccluded(const osg::Matrix& modelview, const osg::BoundingSphere& bs) const
+{
+    if (!bs.valid()) return false;
+
+    osg::BoundingBox bb;
+    bb.expandBy(bs);
+    return isOccluded(modelview, bb);
+}
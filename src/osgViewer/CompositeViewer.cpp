@@ -23,6 +23,8 @@
 
 #include <osg/io_utils>
 
+#include <sstream>
+
 using namespace osgViewer;
 
 CompositeViewer::CompositeViewer()
@@ -1477,6 +1479,16 @@ void CompositeViewer::updateTraversal()
 
     }
 
+    // recompute the bounds dirtied during the update in one bottom up pass, rather than on demand by the cull traversals.
+    for(Scenes::iterator sitr = scenes.begin();
+        sitr != scenes.end();
+        ++sitr)
+    {
+        if ((*sitr)->getSceneData()) (*sitr)->getSceneData()->getBound();
+    }
+
+    unsigned int numBoundsComputed = osg::Node::resetNumBoundsComputed();
+
     if (getViewerStats() && getViewerStats()->collectStats("update"))
     {
         double endUpdateTraversal = osg::Timer::instance()->delta_s(_startTick, osg::Timer::instance()->tick());
@@ -1485,6 +1497,24 @@ void CompositeViewer::updateTraversal()
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal begin time", beginUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal end time", endUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal time taken", endUpdateTraversal-beginUpdateTraversal);
+        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Number of bounds computed", numBoundsComputed);
+
+        // with several scenes each pager's stats are prefixed by its scene's index so they don't overwrite each other.
+        for(unsigned int i=0; i<scenes.size(); ++i)
+        {
+            osgDB::DatabasePager* databasePager = scenes[i]->getDatabasePager();
+            if (!databasePager) continue;
+
+            std::string prefix;
+            if (scenes.size()>1)
+            {
+                std::ostringstream str;
+                str<<"Scene "<<i<<" ";
+                prefix = str.str();
+            }
+
+            databasePager->reportStats(_frameStamp->getFrameNumber(), *getViewerStats(), prefix);
+        }
     }
 
 }
@@ -1215,6 +1215,11 @@ void Viewer::updateTraversal()
 
     updateSlaves();
 
+    // recompute the bounds dirtied during the update in one bottom up pass, rather than on demand by the cull traversals.
+    if (_scene.valid() && _scene->getSceneData()) _scene->getSceneData()->getBound();
+
+    unsigned int numBoundsComputed = osg::Node::resetNumBoundsComputed();
+
     if (getViewerStats() && getViewerStats()->collectStats("update"))
     {
         double endUpdateTraversal = osg::Timer::instance()->delta_s(_startTick, osg::Timer::instance()->tick());
@@ -1223,6 +1228,12 @@ void Viewer::updateTraversal()
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal begin time", beginUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal end time", endUpdateTraversal);
         getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Update traversal time taken", endUpdateTraversal-beginUpdateTraversal);
+        getViewerStats()->setAttribute(_frameStamp->getFrameNumber(), "Number of bounds computed", numBoundsComputed);
+
+        if (_scene.valid() && _scene->getDatabasePager())
+        {
+            _scene->getDatabasePager()->reportStats(_frameStamp->getFrameNumber(), *getViewerStats());
+        }
     }
 }
 
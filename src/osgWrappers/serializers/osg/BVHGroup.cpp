@@ -0,0 +1,13 @@
+#include <osg/BVHGroup>
+#include <osgDB/ObjectWrapper>
+#include <osgDB/InputStream>
+#include <osgDB/OutputStream>
+
+// the tree itself isn't serialized, being rebuilt from the children written out by the osg::Group wrapper.
+REGISTER_OBJECT_WRAPPER( BVHGroup,
+                         new osg::BVHGroup,
+                         osg::BVHGroup,
+                         "osg::Object osg::Node osg::Group osg::BVHGroup" )
+{
+    ADD_FLOAT_SERIALIZER( Margin, 0.1f );  // _margin
+}